@@ -38,6 +38,7 @@ static bool quiet = FALSE;
 static bool player_quit = FALSE;
 
 static bool play_next (AGMP_HANDLE handle);
+static void queue_next (AGMP_HANDLE handle);
 static bool play_prev (AGMP_HANDLE handle);
 static void agmp_message_callback(AGMP_HANDLE handle, AGMP_MESSAGE_TYPE type, void* userdata);
 
@@ -140,6 +141,11 @@ static void agmp_message_callback(AGMP_HANDLE handle, AGMP_MESSAGE_TYPE type, vo
     case AGMP_MESSAGE_MEDIA_INFO_CHANGED:
       gst_print ("message AGMP_MESSAGE_MEDIA_INFO_CHANGED.....\n");
     break;
+    case AGMP_MESSAGE_NEXT_ITEM_STARTED:
+      gst_print ("message AGMP_MESSAGE_NEXT_ITEM_STARTED.....\n");
+      file_list.cur_index++;
+      queue_next (handle);
+    break;
   }
 }
 
@@ -293,6 +299,15 @@ static void run_command (void* user_data)
 }
 
 
+/* hand the following playlist item to the player for a gapless transition */
+static void queue_next (AGMP_HANDLE handle)
+{
+  if (file_list.cur_index + 1 < file_list.filenum)
+    agmp_queue_uri(handle, file_list.uris[file_list.cur_index + 1]);
+  else
+    agmp_queue_uri(handle, NULL);
+}
+
 /* returns FALSE if we have reached the end of the playlist */
 static bool play_next (AGMP_HANDLE handle)
 {
@@ -304,6 +319,7 @@ static bool play_next (AGMP_HANDLE handle)
   agmp_stop (handle);
   agmp_set_uri(handle, file_list.uris[file_list.cur_index]);
   //agmp_set_license_url(handle, license_url);
+  queue_next (handle);
   agmp_prepare(handle);
   agmp_play (handle);
   return TRUE;
@@ -320,6 +336,7 @@ static bool play_prev (AGMP_HANDLE handle)
   agmp_stop (handle);
   agmp_set_uri(handle, file_list.uris[file_list.cur_index]);
   //agmp_set_license_url(handle, license_url);
+  queue_next (handle);
   agmp_prepare(handle);
   agmp_play (handle);
   return TRUE;
@@ -334,6 +351,11 @@ int main (int argc, char **argv)
 {
   char license_url[1024] = {0};
   int x=0, y=0, w=0, h=0;
+  BufferingConfig buffering = { -1, -1, FALSE, 0, 0, 0 };
+  bool set_buffering = FALSE;
+  long long buffer_ms = -1;
+  char http_cache_dir[512] = {0};
+  unsigned long long http_cache_mb = 0;
 
   if (argc < 2)
   {
@@ -363,6 +385,25 @@ int main (int argc, char **argv)
       {
         gst_print ("got window-size=%d,%d,%d,%d\n", x, y, w, h);
       }
+      else if(sscanf(argv[i], "--buffering=%lld,%lld,%d,%d", &buffering.buffer_size, &buffer_ms,
+          &buffering.low_percent, &buffering.high_percent) >= 1)
+      {
+        if (buffer_ms >= 0)
+          buffering.buffer_duration = buffer_ms * 1000000LL;
+        set_buffering = TRUE;
+        gst_print ("got buffering=%lld bytes,%lld ms,%d%%,%d%%\n", buffering.buffer_size, buffer_ms,
+          buffering.low_percent, buffering.high_percent);
+      }
+      else if(sscanf(argv[i], "--http-cache=%511[^,],%llu", http_cache_dir, &http_cache_mb) >= 2)
+      {
+        gst_print ("got http-cache=%s,%llu MB\n", http_cache_dir, http_cache_mb);
+      }
+      else if(strcmp(argv[i], "--download") == 0)
+      {
+        buffering.download = TRUE;
+        set_buffering = TRUE;
+        gst_print ("got download\n");
+      }
       else {
         gst_print ("unknown param: %s\n", argv[i]);
         return 0;
@@ -386,6 +427,8 @@ int main (int argc, char **argv)
     return EXIT_FAILURE;
   }
   agmp_set_log_level(LOG_TRACE);
+  if (http_cache_mb > 0)
+    agmp_set_http_cache(http_cache_dir, http_cache_mb * 1024 * 1024);
 
   player_quit = FALSE;
   pthread_t cmdThreadId;
@@ -399,6 +442,9 @@ int main (int argc, char **argv)
   agmp_set_uri(handle, file_list.uris[file_list.cur_index]);
   agmp_set_license_url(handle, license_url);
   agmp_set_window_size(handle, x, y, w, h);
+  if (set_buffering)
+    agmp_set_buffering_config(handle, &buffering);
+  queue_next (handle);
   agmp_prepare(handle);
 
   /* play */
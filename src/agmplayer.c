@@ -22,8 +22,31 @@
 #include <gst/tag/tag.h>
 #include <gst/math-compat.h>
 #include "agmplayer.h"
-
-#define PROGRESS_CALLBACK_CNT 10
+#include "agmplayer_log.h"
+#include "agmplayer_thumbnail.h"
+#include "agmplayer_probe_cache.h"
+#include "agmplayer_mmapsrc.h"
+#include "agmplayer_memsrc.h"
+#include "agmplayer_av_sync.h"
+
+#define PROGRESS_DEFAULT_INTERVAL 1000 // ms
+
+/* buffering policy */
+#define BUFFERING_DEFAULT_LOW_PERCENT 10
+#define BUFFERING_DEFAULT_HIGH_PERCENT 100
+#define BUFFERING_RATE_MARGIN 1.2 // resume early when download outpaces playback by this much
+#define GST_PLAY_FLAG_DOWNLOAD (1 << 7)
+
+/* live edge catch-up */
+#define LIVE_CHECK_INTERVAL 500 // ms
+#define LIVE_RATE_MAX_DELTA 0.05 // rate stays in 0.95-1.05, scaletempo keeps the pitch
+#define LIVE_RATE_STEP 0.01
+#define LIVE_ERROR_RANGE 2000 // ms off target that drives the rate to its limit
+#define LIVE_DEADBAND 250 // ms off target tolerated before nudging
+#define AV_SYNC_INTERVAL 200 // ms
+
+/* scrubbing shows the nearest keyframe, the release seek is accurate */
+#define SCRUB_SEEK_FLAGS (GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_NEAREST)
 
 typedef struct
 {
@@ -33,6 +56,35 @@ typedef struct
   int h;
 } WindowSize;
 
+/* main loop thread serving one handle, or all handles in shared mode */
+typedef struct
+{
+  gint refcount;
+  GMainContext *context;
+  GMainLoop *loop;
+  GThread *thread;
+} PlayDispatcher;
+
+/* what an element is to the player, decided once per factory */
+typedef enum
+{
+  PLAY_ROLE_NONE = 0,
+  PLAY_ROLE_URIDECODEBIN,
+  PLAY_ROLE_DECODEBIN,
+  PLAY_ROLE_PARSEBIN,
+  PLAY_ROLE_PLAYSINK,
+  PLAY_ROLE_DEMUX,
+  PLAY_ROLE_MULTIQUEUE,
+  PLAY_ROLE_QUEUE,
+  PLAY_ROLE_VDEC,
+  PLAY_ROLE_ADEC,
+  PLAY_ROLE_VSINK,
+  PLAY_ROLE_ASINK,
+  PLAY_ROLE_DECRYPTOR,
+  PLAY_ROLE_TYPEFIND,
+  PLAY_ROLE_PARSER,
+} PlayElementRole;
+
 /* PrivAAMPState is for aamp*/
 typedef enum
 {
@@ -56,6 +108,9 @@ typedef enum
 typedef struct
 {
   const gchar *uri;
+  gchar *next_uri;              /* queued by agmp_queue_uri for gapless playback */
+  gboolean next_pending;        /* next_uri handed to playbin, waiting stream start */
+  GMutex uri_lock;
   gchar *license_url;
   AGMP_SSTATUS status;
 
@@ -77,6 +132,7 @@ typedef struct
   GstElement *aq;
   GstElement *vbin;
   GstElement *vq;
+  GMutex elements_lock;         /* slots above are filled from streaming threads */
 
   /* playbin3 variables */
   gboolean is_playbin3;
@@ -86,11 +142,62 @@ typedef struct
   gchar *cur_text_sid;
   GMutex selection_lock;
 
-  GMainLoop *loop;
-  guint bus_watch;
-  GThread *play_thread;
-  unsigned int timer_id;
-  int timer_cnt;
+  /* seamless audio switch on playbin3, tracked on the audio sink pad */
+  GMutex switch_lock;
+  gchar *switch_sid;            /* stream-id being switched to, NULL when idle */
+  gboolean switch_arrived;      /* new stream reached the sink */
+  gint64 switch_start;          /* monotonic us of the request */
+  GstClockTime switch_boundary; /* running time where the old stream ends */
+  GstSegment switch_segment;
+  GstPad *switch_pad;
+  gulong switch_probe_id;
+  gint64 switch_latency;        /* us of the last switch, -1 for none */
+
+  /* scrubbing: one seek in flight, only the latest target is kept */
+  GMutex seek_lock;
+  gboolean scrubbing;
+  gboolean seek_in_flight;
+  gboolean scrub_seek;          /* seek in flight is a scrub seek */
+  gint64 scrub_target;          /* ns, next seek after the one in flight, -1 for none */
+  gint64 scrub_last;            /* ns, last requested position, -1 for none */
+  gint64 rate_switch_start;     /* us, flushing rate change waiting for ASYNC_DONE, -1 for none */
+  gint64 rate_switch_latency;   /* us of the last rate change, -1 for none */
+  gboolean reverse_trick;       /* key unit trick mode was forced by reverse playback */
+
+  /* probe cache: what the last prepare of this uri found, see agmplayer_probe_cache.h */
+  GMutex probe_lock;
+  AgmpProbeEntry probe;         /* cached entry of the uri being prepared */
+  gboolean probe_hit;
+  gboolean probe_valid;         /* hit is validated, network hits wait for the ETag */
+  GstElement *probe_typefind;   /* container typefind waiting for the hit to be validated */
+  gboolean probe_recorded;      /* this prepare already stored its result */
+  gchar *probe_container;       /* typefind result of this prepare */
+  GPtrArray *probe_chain;       /* factory names autoplugged by this prepare */
+  gint64 prepare_start;         /* us, -1 when no prepare is pending */
+
+  /* seek-bar thumbnails, decoded outside of playbin */
+  GMutex thumb_lock;
+  AgmpThumbnailer *thumbnailer;
+
+  PlayDispatcher *dispatcher;
+  GSource *bus_watch;
+  GSource *timer;
+  int progress_interval;        /* ms between AGMP_MESSAGE_PROGRESS_UPDATE, 0 for none */
+  GMutex progress_lock;         /* timers, cached duration, position anchor, live latency and a/v sync */
+  GSource *live_timer;          /* live edge catch-up, runs while playing with a target set */
+  gint64 live_target;           /* ms behind the live edge to converge on, 0 for off */
+  gint64 live_latency;          /* ms behind the live edge last measured, -1 if unknown */
+  gboolean live_tempo;          /* scaletempo installed as audio-filter */
+  GSource *av_timer;            /* a/v sync sampling, runs while playing */
+  AgmpAvSync av_sync;           /* under progress_lock */
+  AgmpAvSyncTap *av_vtap;       /* what the sinks were given, used from the dispatcher only */
+  AgmpAvSyncTap *av_atap;
+  gint64 av_bound;              /* us, AGMP_MESSAGE_AV_SYNC_ALERT above it, 0 for off */
+  gint64 duration;              /* cached, -1 until queried or after DURATION_CHANGED */
+  GstClock *anchor_clock;       /* position = anchor_pos + clock advance since anchor_time */
+  GstClockTime anchor_time;
+  gint64 anchor_pos;
+  gdouble anchor_rate;
   message_callback notify_app;
   WindowSize win_size;
   int percent;
@@ -101,6 +208,8 @@ typedef struct
 
   gboolean buffering;
   gboolean is_live;
+  gboolean has_buffering_config; /* buffering policy is on once a config is set */
+  BufferingConfig buffering_config;
 
   GstState desired_state;       /* as per user interaction, PAUSED or PLAYING */
 
@@ -110,6 +219,7 @@ typedef struct
   gboolean gapless;
   gboolean wait_on_eos;
 
+  GRecMutex rate_lock;          /* rate changes of the app and of the live controller */
   GstPlayTrickMode trick_mode;
   gdouble rate;
   double volume;
@@ -124,6 +234,17 @@ typedef struct
   gboolean audio_muted;
   char videoRectangle[32];
   void* userdata;
+
+  /* fast channel switch */
+  gboolean dual_pipeline;
+  const char *asink_name;
+  const char *vsink_name;
+  GstElement *standby;          /* second playbin prerolling the predicted next uri */
+  GstElement *standby_asink;
+  GstElement *standby_vsink;
+  gchar *standby_uri;
+  GSource *standby_watch;
+  gint standby_prerolled;       /* atomic, set from standby bus watch */
 } GstPlay;
 
 typedef enum
@@ -136,12 +257,17 @@ typedef enum
 
 static gboolean quiet = FALSE;
 static gboolean play_bus_msg (GstBus * bus, GstMessage * msg, gpointer data);
-//static void play_about_to_finish (GstElement * playbin, gpointer user_data);
+static GstBusSyncReply play_bus_sync_msg (GstBus * bus, GstMessage * msg, gpointer data);
+static void play_set_bus_sync (GstPlay * player, GstElement * pipeline, gboolean enable);
+static void play_about_to_finish (GstElement * playbin, gpointer user_data);
 static int play_reset (GstPlay * player);
-static gboolean play_do_seek (GstPlay * play, gint64 pos, gdouble rate,
+static gboolean play_set_rate_and_trick_mode_locked (GstPlay * play, gdouble rate,
     GstPlayTrickMode mode);
+static gboolean play_do_seek (GstPlay * play, gint64 pos, gdouble rate,
+    GstPlayTrickMode mode, GstSeekFlags flags);
 static void relative_seek (GstPlay * play, gdouble percent);
-static void default_element_added(GstBin *bin, GstElement *element, gpointer user_data);
+static void default_element_added(GstBin *bin, GstBin *sub_bin, GstElement *element, gpointer user_data);
+static void default_element_removed(GstBin *bin, GstBin *sub_bin, GstElement *element, gpointer user_data);
 
 void aamp_switch_trick_mode (GstPlay * play);
 int get_audio_track_num(GstPlay * play);
@@ -153,48 +279,38 @@ static void set_aamp_state(GstPlay *player, PrivAAMPState state);
 static GstAllocator* handle_need_allocator(GstElement *wlcdmi, gboolean is_4k, guint decoder_format, gpointer user_data);
 static void element_setup (GstElement *playbin, GstElement *element, gpointer user_data);
 static int porting_timeout (void* handle);
-
-
-#define log_trace(...) log_log(LOG_TRACE, __func__, __LINE__, __VA_ARGS__)
-#define log_debug(...) log_log(LOG_DEBUG, __func__, __LINE__, __VA_ARGS__)
-#define log_info(...)  log_log(LOG_INFO,  __func__, __LINE__, __VA_ARGS__)
-#define log_warn(...)  log_log(LOG_WARN,  __func__, __LINE__, __VA_ARGS__)
-#define log_error(...) log_log(LOG_ERROR, __func__, __LINE__, __VA_ARGS__)
-#define log_fatal(...) log_log(LOG_FATAL, __func__, __LINE__, __VA_ARGS__)
-#define gst_print(...) log_log(LOG_INFO, __func__, __LINE__, __VA_ARGS__)
-
-static struct {
-  void *udata;
-  int level;
-  int quiet;
-} L = {0};
-
-static const char *level_names[] = {
-  "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
-};
-
-static void log_log(int level, const char *file, int line, const char *fmt, ...) {
-  if (level < L.level) {
-    return;
-  }
-  /* Get current time */
-   struct timespec tm;
-   long second, usec;
-
-   clock_gettime( CLOCK_MONOTONIC_RAW, &tm );
-   second = tm.tv_sec;
-   usec = tm.tv_nsec/1000LL;
-
-  /* Log to stderr */
-  if (!L.quiet) {
-    va_list args;
-    printf("[%ld.%06ld]: %-5s %s:%d [AGMPlayer]: ", second, usec, level_names[level], file, line);
-    va_start(args, fmt);
-    vprintf(fmt, args);
-    va_end(args);
-    printf("\n");
-  }
-}
+static GstElement *play_make_playbin (GstPlay *player, GstElement **asink, GstElement **vsink);
+static void play_update_progress_timer (GstPlay *player);
+static void play_update_live_timer (GstPlay *player);
+static void play_update_av_timer (GstPlay *player);
+#if GST_CHECK_VERSION(1,18,0)
+static gboolean play_instant_rate_change (GstPlay * play, gdouble rate);
+#endif
+static void play_live_audio_filter (GstPlay *player);
+static void play_apply_buffering_config (GstPlay *player, GstElement *playbin);
+static void play_buffering_policy (GstPlay *player, GstMessage *msg, gint percent);
+static void play_anchor_position (GstPlay *player, gboolean playing);
+static void play_invalidate_duration (GstPlay *player);
+static void play_drop_standby (GstPlay *player);
+static void play_switch_cancel (GstPlay *player);
+static int play_scrub_seek (GstPlay *player, gint64 pos);
+static void play_seek_reset (GstPlay *player);
+static void play_rate_switch_done (GstPlay *player, gint64 start);
+static void play_probe_element (GstPlay *play, GstElement *element, PlayElementRole role);
+static void play_probe_begin (GstPlay *player, const gchar *uri);
+static void play_probe_done (GstPlay *player);
+static void play_probe_http_headers (GstPlay *player, const GstStructure *s);
+static void play_probe_failed (GstPlay *player);
+
+
+#define AGMP_LOG_MODULE "AGMPlayer"
+#define log_trace(...) agmp_log_write(LOG_TRACE, AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
+#define log_debug(...) agmp_log_write(LOG_DEBUG, AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
+#define log_info(...)  agmp_log_write(LOG_INFO,  AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
+#define log_warn(...)  agmp_log_write(LOG_WARN,  AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
+#define log_error(...) agmp_log_write(LOG_ERROR, AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
+#define log_fatal(...) agmp_log_write(LOG_FATAL, AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
+#define gst_print(...) agmp_log_write(LOG_INFO,  AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
 
 static GstAllocator* handle_need_allocator(GstElement *wlcdmi, gboolean is_4k, guint decoder_format, gpointer user_data)
 {
@@ -231,7 +347,118 @@ static void element_setup (GstElement *playbin, GstElement *element, gpointer us
     }
 }
 
-static void default_element_added(GstBin *bin, GstElement *element, gpointer user_data)
+static GMutex role_cache_lock;
+static GHashTable *role_cache = NULL; /* GstElementFactory -> PlayElementRole */
+
+/* 'v' or 'a' from the klass, else from the caps of the pad templates */
+static gchar play_factory_media (GstElementFactory *factory, const gchar *klass, GstPadDirection dir)
+{
+  const GList *l;
+  gchar media = 0;
+
+  if (strstr (klass, "Video"))
+    return 'v';
+  if (strstr (klass, "Audio"))
+    return 'a';
+
+  for (l = gst_element_factory_get_static_pad_templates (factory); l && !media; l = l->next) {
+    GstStaticPadTemplate *templ = l->data;
+    GstCaps *caps;
+    guint i;
+
+    if (templ->direction != dir)
+      continue;
+
+    caps = gst_static_pad_template_get_caps (templ);
+    for (i = 0; i < gst_caps_get_size (caps) && !media; i++) {
+      const gchar *name = gst_structure_get_name (gst_caps_get_structure (caps, i));
+
+      if (g_str_has_prefix (name, "video/"))
+        media = 'v';
+      else if (g_str_has_prefix (name, "audio/"))
+        media = 'a';
+    }
+    gst_caps_unref (caps);
+  }
+
+  return media;
+}
+
+static PlayElementRole play_classify_factory (GstElementFactory *factory)
+{
+  const gchar *name = GST_OBJECT_NAME (factory);
+  const gchar *klass;
+
+  if (!strcmp (name, "uridecodebin") || !strcmp (name, "uridecodebin3"))
+    return PLAY_ROLE_URIDECODEBIN;
+  if (!strcmp (name, "decodebin") || !strcmp (name, "decodebin3"))
+    return PLAY_ROLE_DECODEBIN;
+  if (!strcmp (name, "parsebin"))
+    return PLAY_ROLE_PARSEBIN;
+  if (!strcmp (name, "playsink"))
+    return PLAY_ROLE_PLAYSINK;
+  if (!strcmp (name, "multiqueue"))
+    return PLAY_ROLE_MULTIQUEUE;
+  if (!strcmp (name, "queue"))
+    return PLAY_ROLE_QUEUE;
+  if (!strcmp (name, "wlcdmi"))
+    return PLAY_ROLE_DECRYPTOR;
+  if (!strcmp (name, "typefind"))
+    return PLAY_ROLE_TYPEFIND;
+
+  klass = gst_element_factory_get_metadata (factory, GST_ELEMENT_METADATA_KLASS);
+  if (!klass)
+    return PLAY_ROLE_NONE;
+
+  if (strstr (klass, "Decryptor"))
+    return PLAY_ROLE_DECRYPTOR;
+  if (strstr (klass, "Demuxer"))
+    return PLAY_ROLE_DEMUX;
+  if (strstr (klass, "Parser"))
+    return PLAY_ROLE_PARSER;
+  if (strstr (klass, "Decoder")) {
+    switch (play_factory_media (factory, klass, GST_PAD_SRC)) {
+      case 'v': return PLAY_ROLE_VDEC;
+      case 'a': return PLAY_ROLE_ADEC;
+      default: return PLAY_ROLE_NONE;
+    }
+  }
+  if (strstr (klass, "Sink")) {
+    switch (play_factory_media (factory, klass, GST_PAD_SINK)) {
+      case 'v': return PLAY_ROLE_VSINK;
+      case 'a': return PLAY_ROLE_ASINK;
+      default: return PLAY_ROLE_NONE;
+    }
+  }
+
+  return PLAY_ROLE_NONE;
+}
+
+static PlayElementRole play_element_role (GstElement *element)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  gpointer cached;
+  PlayElementRole role;
+
+  if (!factory)
+    return PLAY_ROLE_NONE;
+
+  g_mutex_lock (&role_cache_lock);
+  if (!role_cache)
+    role_cache = g_hash_table_new (g_direct_hash, g_direct_equal);
+  if (g_hash_table_lookup_extended (role_cache, factory, NULL, &cached)) {
+    role = GPOINTER_TO_INT (cached);
+  } else {
+    role = play_classify_factory (factory);
+    g_hash_table_insert (role_cache, factory, GINT_TO_POINTER (role));
+  }
+  g_mutex_unlock (&role_cache_lock);
+
+  return role;
+}
+
+/* deep-element-added of playbin, called for every element of the tree */
+static void default_element_added(GstBin *bin, GstBin *sub_bin, GstElement *element, gpointer user_data)
 {
   GstPlay *play;
   if (NULL == user_data)
@@ -242,96 +469,315 @@ static void default_element_added(GstBin *bin, GstElement *element, gpointer use
 
   play = (GstPlay *)user_data;
 
-  GST_DEBUG("New element added to %s : %s", GST_ELEMENT_NAME(bin), GST_ELEMENT_NAME(element));
-  g_print("New element added to %s : %s\n", GST_ELEMENT_NAME(bin), GST_ELEMENT_NAME(element));
+  GST_DEBUG("New element added to %s : %s", GST_ELEMENT_NAME(sub_bin), GST_ELEMENT_NAME(element));
 
-  if (g_strrstr(GST_ELEMENT_NAME(element), "uridecodebin"))
-  {
-      if (play->uridb != element)
-      {
-          g_signal_connect(element, "element-added", G_CALLBACK(default_element_added), play);
-      }
+  g_mutex_lock (&play->elements_lock);
+  switch (play_element_role (element)) {
+    case PLAY_ROLE_URIDECODEBIN:
       play->uridb = element;
-  }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "decodebin"))
-  {
-      if (play->db != element)
-      {
-          g_signal_connect(element, "element-added", G_CALLBACK(default_element_added), play);
-      }
+      break;
+    case PLAY_ROLE_DECODEBIN:
       play->db = element;
-  }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "parsebin"))
-  {
-      if (play->pb != element)
+      play_probe_element (play, element, PLAY_ROLE_DECODEBIN);
+      break;
+    case PLAY_ROLE_PARSEBIN:
+      play->pb = element;
+      play_probe_element (play, element, PLAY_ROLE_PARSEBIN);
+      break;
+    case PLAY_ROLE_PLAYSINK:
+      play->playsink = element;
+      break;
+    case PLAY_ROLE_DEMUX:
+      play->dmx = element;
+      play_probe_element (play, element, PLAY_ROLE_DEMUX);
+      break;
+    case PLAY_ROLE_TYPEFIND:
+      play_probe_element (play, element, PLAY_ROLE_TYPEFIND);
+      break;
+    case PLAY_ROLE_PARSER:
+      play_probe_element (play, element, PLAY_ROLE_PARSER);
+      break;
+    case PLAY_ROLE_MULTIQUEUE:
+      play->mq = element;
+      break;
+    case PLAY_ROLE_QUEUE:
+      /* playsink puts one queue in each of its vbin and abin */
+      if ((GstElement *) sub_bin == play->vbin)
+        play->vq = element;
+      else if ((GstElement *) sub_bin == play->abin)
+        play->aq = element;
+      break;
+    case PLAY_ROLE_VDEC:
+      play->vdec = element;
+      play_probe_element (play, element, PLAY_ROLE_VDEC);
+      break;
+    case PLAY_ROLE_ADEC:
+      play->adec = element;
+      play_probe_element (play, element, PLAY_ROLE_ADEC);
+      break;
+    case PLAY_ROLE_VSINK:
+      GST_INFO ("find vsink:%s", GST_ELEMENT_NAME(element));
+      play->vsink = element;
+      break;
+    case PLAY_ROLE_ASINK:
+      play->asink = element;
+      break;
+    case PLAY_ROLE_DECRYPTOR:
+      play->wlcdmi = element;
+      if (play->license_url)
       {
-          g_signal_connect(element, "element-added", G_CALLBACK(default_element_added), play);
+        g_object_set (play->wlcdmi, "license-url", play->license_url, NULL);
       }
-      play->pb = element;
+      break;
+    case PLAY_ROLE_NONE:
+    default:
+      /* playsink's vbin/abin are plain bins without a factory */
+      if (GST_IS_BIN (element) && (GstElement *) sub_bin == play->playsink) {
+        if (g_str_has_prefix (GST_ELEMENT_NAME (element), "vbin"))
+          play->vbin = element;
+        else if (g_str_has_prefix (GST_ELEMENT_NAME (element), "abin"))
+          play->abin = element;
+      }
+      break;
   }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "vbin"))
-  {
-      if (play->vbin != element)
-      {
-          g_signal_connect(element, "element-added", G_CALLBACK(default_element_added), play);
+  g_mutex_unlock (&play->elements_lock);
+}
+
+/* slots hold no reference, forget elements leaving the tree */
+static void default_element_removed(GstBin *bin, GstBin *sub_bin, GstElement *element, gpointer user_data)
+{
+  GstPlay *play = user_data;
+  GstElement **slots[] = {
+    &play->uridb, &play->db, &play->pb, &play->playsink, &play->dmx, &play->mq,
+    &play->vq, &play->aq, &play->vbin, &play->abin, &play->vdec, &play->adec, &play->wlcdmi,
+    &play->vsink, &play->asink
+  };
+  guint i;
+
+  g_mutex_lock (&play->elements_lock);
+  for (i = 0; i < G_N_ELEMENTS (slots); i++) {
+    if (*slots[i] == element)
+      *slots[i] = NULL;
+  }
+  g_mutex_unlock (&play->elements_lock);
+}
+
+static void play_probe_have_type (GstElement *typefind, guint probability, GstCaps *caps, gpointer user_data)
+{
+  GstPlay *play = user_data;
+
+  g_mutex_lock (&play->probe_lock);
+  if (!play->probe_container)
+    play->probe_container = gst_caps_to_string (caps);
+  g_mutex_unlock (&play->probe_lock);
+}
+
+/* autoplug-sort of decodebin/parsebin: factories of the cached chain go first */
+static GValueArray *play_probe_autoplug_sort (GstElement *bin, GstPad *pad, GstCaps *caps,
+    GValueArray *factories, gpointer user_data)
+{
+  GstPlay *play = user_data;
+  GValueArray *sorted = NULL;
+  guint pass, i;
+
+  g_mutex_lock (&play->probe_lock);
+  if (play->probe_hit && play->probe_valid && play->probe.factories) {
+    G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+    sorted = g_value_array_new (factories->n_values);
+    for (pass = 0; pass < 2; pass++) {
+      for (i = 0; i < factories->n_values; i++) {
+        GValue *v = g_value_array_get_nth (factories, i);
+        GstElementFactory *f = g_value_get_object (v);
+        gboolean cached = g_strv_contains ((const gchar * const *) play->probe.factories,
+            GST_OBJECT_NAME (f));
+
+        /* the others keep their rank order behind */
+        if (cached == (pass == 0))
+          g_value_array_append (sorted, v);
       }
-      play->vbin = element;
+    }
+    G_GNUC_END_IGNORE_DEPRECATIONS
   }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "abin"))
-  {
-      if (play->abin != element)
-      {
-          g_signal_connect(element, "element-added", G_CALLBACK(default_element_added), play);
+  g_mutex_unlock (&play->probe_lock);
+
+  return sorted;
+}
+
+/* called from deep-element-added for the elements the probe cache cares about */
+static void play_probe_element (GstPlay *play, GstElement *element, PlayElementRole role)
+{
+  const gchar *name = GST_OBJECT_NAME (gst_element_get_factory (element));
+  GstCaps *caps = NULL;
+
+  g_mutex_lock (&play->probe_lock);
+  if (play->prepare_start < 0) {
+    g_mutex_unlock (&play->probe_lock);
+    return;
+  }
+
+  switch (role) {
+    case PLAY_ROLE_TYPEFIND:
+      /* typefinds ahead of the first demuxer all look at the container */
+      if (play->probe_chain->len == 0) {
+        if (play->probe_hit && play->probe_valid)
+          caps = gst_caps_from_string (play->probe.container);
+        else if (play->probe_hit && !play->probe_typefind)
+          play->probe_typefind = gst_object_ref (element);
+        g_signal_connect (element, "have-type", G_CALLBACK (play_probe_have_type), play);
       }
-      play->abin = element;
+      break;
+    case PLAY_ROLE_DECODEBIN:
+    case PLAY_ROLE_PARSEBIN:
+      /* decodebin3 autoplugs through its parsebin */
+      if (play->probe_hit && g_signal_lookup ("autoplug-sort", G_OBJECT_TYPE (element)))
+        g_signal_connect (element, "autoplug-sort", G_CALLBACK (play_probe_autoplug_sort), play);
+      break;
+    default:
+      if (!g_ptr_array_find_with_equal_func (play->probe_chain, name, g_str_equal, NULL))
+        g_ptr_array_add (play->probe_chain, g_strdup (name));
+      break;
   }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "demux"))
-  {
-      play->dmx = element;
+  g_mutex_unlock (&play->probe_lock);
+
+  if (caps) {
+    /* skips probing the stream */
+    g_object_set (element, "force-caps", caps, NULL);
+    gst_caps_unref (caps);
   }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "multiqueue"))
-  {
-      play->mq = element;
+}
+
+static void play_probe_begin (GstPlay *player, const gchar *uri)
+{
+  g_mutex_lock (&player->probe_lock);
+  agmp_probe_entry_clear (&player->probe);
+  g_clear_pointer (&player->probe_container, g_free);
+  g_ptr_array_set_size (player->probe_chain, 0);
+  g_clear_object (&player->probe_typefind);
+  player->probe_recorded = FALSE;
+  player->probe_hit = uri && agmp_probe_cache_lookup (uri, &player->probe);
+  player->probe_valid = player->probe_hit && !player->probe.etag;
+  player->prepare_start = g_get_monotonic_time ();
+  if (player->probe_hit)
+    gst_print ("probe cache hit: %s\n", player->probe.container);
+  g_mutex_unlock (&player->probe_lock);
+}
+
+/* first ASYNC_DONE after prepare: store what was found */
+static void play_probe_done (GstPlay *player)
+{
+  AgmpProbeEntry entry = { 0, };
+  gboolean hit;
+  gint64 elapsed;
+  gchar *uri;
+
+  g_mutex_lock (&player->probe_lock);
+  if (player->prepare_start < 0 || player->probe_recorded) {
+    g_mutex_unlock (&player->probe_lock);
+    return;
   }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "vqueue"))
-  {
-      play->vq = element;
+  player->probe_recorded = TRUE;
+  g_clear_object (&player->probe_typefind);
+  elapsed = g_get_monotonic_time () - player->prepare_start;
+  player->prepare_start = -1;
+  hit = player->probe_hit;
+  if (player->probe_container) {
+    entry.container = g_strdup (player->probe_container);
+    entry.factories = g_new0 (gchar *, player->probe_chain->len + 1);
+    for (guint i = 0; i < player->probe_chain->len; i++)
+      entry.factories[i] = g_strdup (g_ptr_array_index (player->probe_chain, i));
   }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "aqueue"))
-  {
-      play->aq = element;
+  g_mutex_unlock (&player->probe_lock);
+
+  gst_print ("prepared in %" G_GINT64_FORMAT " ms, probe cache %s\n",
+      elapsed / 1000, hit ? "hit" : "miss");
+
+  g_mutex_lock (&player->uri_lock);
+  uri = g_strdup (player->uri);
+  g_mutex_unlock (&player->uri_lock);
+  if (uri && entry.container) {
+    g_object_get (player->playbin, "n-video", &entry.n_video,
+        "n-audio", &entry.n_audio, "n-text", &entry.n_text, NULL);
+    agmp_probe_cache_store (uri, &entry);
   }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "sink"))
-  {
-      if (g_strrstr(GST_ELEMENT_NAME(element), "westeros") || g_strrstr(GST_ELEMENT_NAME(element), "amlvideosink"))
-      {
-          g_print("\n\n\ndefault_element_added: find vsink:%s\n\n\n", GST_ELEMENT_NAME(element));
-          play->vsink = element;
-      }
-      else if (g_strrstr(GST_ELEMENT_NAME(element), "amlhalasink"))
-      {
-          play->asink = element;
-      }
+  agmp_probe_entry_clear (&entry);
+  g_free (uri);
+}
+
+/* souphttpsrc reports the response headers, the ETag validates the entry.
+ * runs from the sync handler, so before souphttpsrc pushes any data */
+static void play_probe_http_headers (GstPlay *player, const GstStructure *s)
+{
+  const GValue *value;
+  const GstStructure *headers;
+  const gchar *msg_uri, *etag;
+  GstElement *typefind = NULL;
+  GstCaps *caps = NULL;
+  gchar *uri;
+
+  value = gst_structure_get_value (s, "response-headers");
+  if (!value || !GST_VALUE_HOLDS_STRUCTURE (value))
+    return;
+  headers = gst_value_get_structure (value);
+  etag = gst_structure_get_string (headers, "ETag");
+  if (!etag)
+    etag = gst_structure_get_string (headers, "Etag");
+
+  g_mutex_lock (&player->uri_lock);
+  uri = g_strdup (player->uri);
+  g_mutex_unlock (&player->uri_lock);
+  /* fragments of adaptive streams have headers of their own */
+  msg_uri = gst_structure_get_string (s, "uri");
+  if (!uri || g_strcmp0 (msg_uri, uri) != 0) {
+    g_free (uri);
+    return;
   }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "dec"))
-  {
-      if (g_strrstr(GST_ELEMENT_NAME(element), "v4l2"))
-      {
-          play->vdec = element;
-      }
-      else if (g_strrstr(GST_ELEMENT_NAME(element), "avdec_"))
-      {
-          play->adec = element;
-      }
+
+  g_mutex_lock (&player->probe_lock);
+  if (player->probe_hit && !player->probe_valid) {
+    if (etag && g_strcmp0 (etag, player->probe.etag) == 0) {
+      player->probe_valid = TRUE;
+      typefind = player->probe_typefind;
+      player->probe_typefind = NULL;
+      if (typefind)
+        caps = gst_caps_from_string (player->probe.container);
+    } else {
+      gst_print ("probe cache entry is stale, ETag %s\n", etag ? etag : "missing");
+      player->probe_hit = FALSE;
+      g_clear_object (&player->probe_typefind);
+    }
   }
-  else if (g_strrstr(GST_ELEMENT_NAME(element), "wlcdmi"))
-  {
-      play->wlcdmi = element;
-      if (play->license_url)
-      {
-        g_object_set (play->wlcdmi, "license-url", play->license_url, NULL);
-      }
+  g_mutex_unlock (&player->probe_lock);
+
+  /* typefind may already be typefinding in pull mode, then this is just ignored */
+  if (caps) {
+    g_object_set (typefind, "force-caps", caps, NULL);
+    gst_caps_unref (caps);
   }
+  if (typefind)
+    gst_object_unref (typefind);
+
+  if (etag)
+    agmp_probe_cache_set_etag (uri, etag);
+  g_free (uri);
+}
+
+/* whatever made this prepare fail, don't replay it next time */
+static void play_probe_failed (GstPlay *player)
+{
+  gchar *uri;
+
+  g_mutex_lock (&player->probe_lock);
+  player->prepare_start = -1;
+  player->probe_recorded = TRUE;
+  g_clear_object (&player->probe_typefind);
+  g_mutex_unlock (&player->probe_lock);
+
+  g_mutex_lock (&player->uri_lock);
+  uri = g_strdup (player->uri);
+  g_mutex_unlock (&player->uri_lock);
+  if (uri)
+    agmp_probe_cache_invalidate (uri);
+  g_free (uri);
 }
 
 static void callback_to_app(GstPlay *player, AGMP_MESSAGE_TYPE type, void * userdata)
@@ -355,6 +801,69 @@ static void callback_to_app(GstPlay *player, AGMP_MESSAGE_TYPE type, void * user
     } \
   } while(0);
 
+int agmp_get_element_stats(AGMP_HANDLE handle, AGMP_ELEMENT_ROLE role, ElementStats* stats)
+{
+  CHECK_POINTER_VALID(handle);
+  CHECK_POINTER_VALID(stats);
+  GstPlay* player = (GstPlay*)handle;
+  GstElement *element = NULL;
+  GstElementFactory *factory;
+  GObjectClass *klass;
+  GParamSpec *pspec;
+
+  g_mutex_lock (&player->elements_lock);
+  switch (role) {
+    case AGMP_ELEMENT_VIDEO_DECODER: element = player->vdec; break;
+    case AGMP_ELEMENT_AUDIO_DECODER: element = player->adec; break;
+    case AGMP_ELEMENT_VIDEO_SINK: element = player->vsink; break;
+    case AGMP_ELEMENT_AUDIO_SINK: element = player->asink; break;
+    case AGMP_ELEMENT_DEMUXER: element = player->dmx; break;
+    case AGMP_ELEMENT_VIDEO_QUEUE: element = player->vq; break;
+    case AGMP_ELEMENT_AUDIO_QUEUE: element = player->aq; break;
+    default: break;
+  }
+  if (element)
+    gst_object_ref (element);
+  g_mutex_unlock (&player->elements_lock);
+
+  if (!element)
+    return AAMP_FAILED_IN_THIS_STATE;
+
+  memset (stats, 0, sizeof (*stats));
+  g_strlcpy (stats->name, GST_ELEMENT_NAME (element), INFO_STRING_MAXLEN);
+  factory = gst_element_get_factory (element);
+  if (factory)
+    g_strlcpy (stats->factory, GST_OBJECT_NAME (factory), INFO_STRING_MAXLEN);
+  stats->state = GST_STATE (element);
+
+  klass = G_OBJECT_GET_CLASS (element);
+  pspec = g_object_class_find_property (klass, "stats");
+  if (pspec && pspec->value_type == GST_TYPE_STRUCTURE) { /* basesink */
+    GstStructure *st = NULL;
+    guint64 val;
+
+    g_object_get (element, "stats", &st, NULL);
+    if (st) {
+      if (gst_structure_get_uint64 (st, "rendered", &val))
+        stats->rendered = val;
+      if (gst_structure_get_uint64 (st, "dropped", &val))
+        stats->dropped = val;
+      gst_structure_get_double (st, "average-rate", &stats->average_rate);
+      gst_structure_free (st);
+    }
+  }
+  if (g_object_class_find_property (klass, "current-level-buffers")) {
+    guint64 time = 0;
+
+    g_object_get (element, "current-level-buffers", &stats->level_buffers,
+        "current-level-bytes", &stats->level_bytes, "current-level-time", &time, NULL);
+    stats->level_time = time;
+  }
+
+  gst_object_unref (element);
+  return AAMP_SUCCESS;
+}
+
 static void video_underflow(gpointer handle)
 {
   if (NULL == handle)
@@ -403,7 +912,28 @@ int agmp_set_uri(AGMP_HANDLE handle, const char* uri)
 {
   CHECK_POINTER_VALID(handle);
   GstPlay* player = (GstPlay*)handle;
+  g_mutex_lock (&player->uri_lock);
+  g_free ((gchar *) player->uri);
   player->uri = g_strdup (uri);
+  /* a new item drops whatever was queued after the old one */
+  g_free (player->next_uri);
+  player->next_uri = NULL;
+  player->next_pending = FALSE;
+  player->gapless = FALSE;
+  g_mutex_unlock (&player->uri_lock);
+  return AAMP_SUCCESS;
+}
+
+int agmp_queue_uri(AGMP_HANDLE handle, const char* uri)
+{
+  CHECK_POINTER_VALID(handle);
+  GstPlay* player = (GstPlay*)handle;
+  g_mutex_lock (&player->uri_lock);
+  g_free (player->next_uri);
+  player->next_uri = g_strdup (uri);
+  player->gapless = (player->next_uri != NULL);
+  g_mutex_unlock (&player->uri_lock);
+  gst_print ("queue next uri: %s\n", uri ? uri : "(none)");
   return AAMP_SUCCESS;
 }
 
@@ -415,6 +945,10 @@ int agmp_set_license_url(AGMP_HANDLE handle, char* license_url)
   return AAMP_SUCCESS;
 }
 
+static GMutex dispatcher_lock;
+static PlayDispatcher *shared_dispatcher = NULL;
+static gboolean use_shared_dispatcher = FALSE;
+
 static gpointer play_run_thread(gpointer data)
 {
   if (NULL == data)
@@ -422,149 +956,371 @@ static gpointer play_run_thread(gpointer data)
     gst_print ("play thread failed\n");
     return NULL;
   }
-  GstPlay *player = data;
+  PlayDispatcher *dispatcher = data;
 
-  CHECK_POINTER_VALID(player);
   gst_print ("play thread enter\n");
+  g_main_context_push_thread_default (dispatcher->context);
   //block here
-  g_main_loop_run (player->loop);
+  g_main_loop_run (dispatcher->loop);
+  g_main_context_pop_thread_default (dispatcher->context);
   gst_print ("play thread quit\n");
 
   return NULL;
 }
 
-int agmp_set_log_level (LOG_LEVEL level)
+static PlayDispatcher *play_dispatcher_new (void)
 {
-  L.level = level;
+  PlayDispatcher *dispatcher;
+
+  dispatcher = g_new0 (PlayDispatcher, 1);
+  dispatcher->refcount = 1;
+  dispatcher->context = g_main_context_new ();
+  dispatcher->loop = g_main_loop_new (dispatcher->context, FALSE);
+  dispatcher->thread = g_thread_new ("video play run thread", play_run_thread, dispatcher);
+  if (!dispatcher->thread) {
+    gst_print ("fail to create play thread");
+    g_main_loop_unref (dispatcher->loop);
+    g_main_context_unref (dispatcher->context);
+    g_free (dispatcher);
+    return NULL;
+  }
+  return dispatcher;
 }
 
-AGMP_HANDLE agmp_init (void)
+/* one dispatcher per handle, or the process wide one in shared mode */
+static PlayDispatcher *play_dispatcher_get (void)
 {
-  int argc = 0;
-  char **argv = NULL;
-  gst_init(&argc, &argv);
+  PlayDispatcher *dispatcher;
 
-  GstPlay *player;
+  g_mutex_lock (&dispatcher_lock);
+  if (!use_shared_dispatcher) {
+    dispatcher = play_dispatcher_new ();
+  } else {
+    if (!shared_dispatcher)
+      shared_dispatcher = play_dispatcher_new ();
+    else
+      shared_dispatcher->refcount++;
+    dispatcher = shared_dispatcher;
+  }
+  g_mutex_unlock (&dispatcher_lock);
+  return dispatcher;
+}
 
-  player = g_new0 (GstPlay, 1);
-  if (NULL == player)
-  {
-    gst_print ("new player failed.\n");
-	  return NULL;
+static void play_dispatcher_unref (PlayDispatcher *dispatcher)
+{
+  gboolean last;
+
+  g_mutex_lock (&dispatcher_lock);
+  last = (--dispatcher->refcount == 0);
+  if (last && dispatcher == shared_dispatcher)
+    shared_dispatcher = NULL;
+  g_mutex_unlock (&dispatcher_lock);
+
+  if (!last)
+    return;
+
+  g_main_loop_quit (dispatcher->loop);
+  if (g_thread_self () != dispatcher->thread) {
+    gst_print ("\njoin thread\n");
+    g_thread_join (dispatcher->thread);
+  } else {
+    /* released from one of its own callbacks, let the thread finish alone */
+    g_thread_unref (dispatcher->thread);
   }
+  g_main_loop_unref (dispatcher->loop);
+  g_main_context_unref (dispatcher->context);
+  g_free (dispatcher);
+}
 
-  player->uri = NULL;
-  player->license_url = NULL;
-  player->status = AGMP_STATUS_NULL;
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  gboolean done;
+} PlayDispatcherSync;
 
-  player->playbin = NULL;
-  player->is_playbin3 = FALSE;
-  player->asink = NULL;
-  player->vsink = NULL;
+static gboolean play_dispatcher_sync_cb (gpointer data)
+{
+  PlayDispatcherSync *sync = data;
 
-  g_mutex_init (&player->selection_lock);
-  player->deep_notify_id = 0;
-  player->loop = NULL;
-  player->bus_watch = 0;
-  player->notify_app = NULL;
-  player->userdata = NULL;
+  g_mutex_lock (&sync->lock);
+  sync->done = TRUE;
+  g_cond_signal (&sync->cond);
+  g_mutex_unlock (&sync->lock);
+  return FALSE;
+}
 
-  player->missing = NULL;
-  player->buffering = FALSE;
-  player->is_live = FALSE;
-  player->gapless = FALSE;
-  player->wait_on_eos = FALSE;
-  player->rate = 1.0;
-  player->trick_mode = GST_PLAY_TRICK_MODE_NONE;
-  player->win_size.x = 0;
-  player->win_size.y = 0;
-  player->win_size.w = 0;
-  player->win_size.h = 0;
-  player->percent = 0;
-  player->async_done = FALSE;
-  player->aamp_state = eSTATE_IDLE;
-  g_mutex_init(&player->lock);
-  player->allocator = NULL;
+/* wait until a callback the dispatcher may be running right now has returned */
+static void play_dispatcher_sync (PlayDispatcher *dispatcher)
+{
+  PlayDispatcherSync sync;
+  GSource *source;
 
-  gboolean use_playbin3 = FALSE;
-  gchar *flags_string = NULL;
-  char* audio_sink = "amlhalasink";
-  char* video_sink = "westerossink";
+  if (g_thread_self () == dispatcher->thread)
+    return;
 
-  const gchar *sink_name = g_getenv ("GST_CFG_VIDEO_SINK");
-  if ( sink_name )
-  {
-     if (strstr(sink_name, "westerossink"))
-        video_sink = "westerossink";
-     else if(strstr(sink_name, "amlvideosink"))
-        video_sink = "amlvideosink";
-     else if(strstr(sink_name, "clutterautovideosink"))
-        video_sink = "clutterautovideosink";
-     else
-        video_sink = "westerossink";
-  }
+  g_mutex_init (&sync.lock);
+  g_cond_init (&sync.cond);
+  sync.done = FALSE;
 
-  GstElement *playbin = NULL;
-  if (use_playbin3) {
+  source = g_idle_source_new ();
+  g_source_set_priority (source, G_PRIORITY_HIGH);
+  g_source_set_callback (source, play_dispatcher_sync_cb, &sync, NULL);
+  g_source_attach (source, dispatcher->context);
+  g_source_unref (source);
+
+  g_mutex_lock (&sync.lock);
+  while (!sync.done)
+    g_cond_wait (&sync.cond, &sync.lock);
+  g_mutex_unlock (&sync.lock);
+
+  g_mutex_clear (&sync.lock);
+  g_cond_clear (&sync.cond);
+}
+
+/* sources are kept by pointer, ids of a private context can't be removed with g_source_remove */
+/* ahead of the timers and of other players sharing the dispatcher,
+ * so EOS, ERROR and ASYNC_DONE don't wait behind them */
+static GSource *play_add_bus_watch (GstPlay *player, GstElement *pipeline, GstBusFunc func)
+{
+  GSource *source;
+
+  source = gst_bus_create_watch (GST_ELEMENT_BUS (pipeline));
+  g_source_set_priority (source, G_PRIORITY_HIGH);
+  g_source_set_callback (source, (GSourceFunc) func, player, NULL);
+  g_source_attach (source, player->dispatcher->context);
+  return source;
+}
+
+static GSource *play_add_timeout (GstPlay *player, guint interval, GSourceFunc func)
+{
+  GSource *source;
+
+  source = g_timeout_source_new (interval);
+  g_source_set_callback (source, func, player, NULL);
+  g_source_attach (source, player->dispatcher->context);
+  return source;
+}
+
+static void play_remove_source (GSource **source)
+{
+  if (*source) {
+    g_source_destroy (*source);
+    g_source_unref (*source);
+    *source = NULL;
+  }
+}
+
+/* the sync handler only lives as long as the pipeline is the active one, so messages
+ * of a pipeline being dropped can't reach it */
+static void play_set_bus_sync (GstPlay *player, GstElement *pipeline, gboolean enable)
+{
+  GstBus *bus;
+
+  bus = gst_element_get_bus (pipeline);
+  if (enable)
+    gst_bus_set_sync_handler (bus, play_bus_sync_msg, player, NULL);
+  else
+    gst_bus_set_sync_handler (bus, NULL, NULL, NULL);
+  gst_object_unref (bus);
+}
+
+int agmp_set_shared_loop (int enable)
+{
+  g_mutex_lock (&dispatcher_lock);
+  use_shared_dispatcher = enable ? TRUE : FALSE;
+  g_mutex_unlock (&dispatcher_lock);
+  return AAMP_SUCCESS;
+}
+
+int agmp_set_log_level (LOG_LEVEL level)
+{
+  agmp_log_set_level (level);
+  return AAMP_SUCCESS;
+}
+
+/* make a playbin with the configured sinks. deep-element-added is connected by
+ * the caller, only the active playbin may fill the element slots */
+static GstElement *play_make_playbin (GstPlay *player, GstElement **asink, GstElement **vsink)
+{
+  GstElement *playbin = NULL;
+  GstElement *sink = NULL;
+
+  if (player->is_playbin3) {
     playbin = gst_element_factory_make ("playbin3", "playbin");
   } else {
     playbin = gst_element_factory_make ("playbin", "playbin");
   }
-  if (playbin == NULL) {
-    gst_print ("make playbin failed.\n");
+  if (playbin == NULL)
     return NULL;
-  }
 
-  player->playbin = playbin;
-  g_signal_connect(playbin, "element-added", G_CALLBACK(default_element_added), player);
   g_signal_connect (playbin, "element-setup", G_CALLBACK (element_setup), player);
+  g_signal_connect (playbin, "about-to-finish", G_CALLBACK (play_about_to_finish), player);
 
-  if (use_playbin3) {
-    player->is_playbin3 = TRUE;
-  } else {
-    const gchar *env = g_getenv ("USE_PLAYBIN3");
-    if (env && g_str_has_prefix (env, "1"))
-      player->is_playbin3 = TRUE;
-  }
+  *asink = NULL;
+  *vsink = NULL;
 
-  GstElement *sink = NULL;
   //asink
-  if (audio_sink != NULL) {
-    if (strchr (audio_sink, ' ') != NULL)
-      sink = gst_parse_bin_from_description (audio_sink, TRUE, NULL);
+  if (player->asink_name != NULL) {
+    if (strchr (player->asink_name, ' ') != NULL)
+      sink = gst_parse_bin_from_description (player->asink_name, TRUE, NULL);
     else
-      sink = gst_element_factory_make (audio_sink, NULL);
+      sink = gst_element_factory_make (player->asink_name, NULL);
 
     if (sink != NULL) {
-      g_object_set (player->playbin, "audio-sink", sink, NULL);
+      g_object_set (playbin, "audio-sink", sink, NULL);
       g_object_set (sink, "wait-video", TRUE, NULL);
       g_object_set (sink, "a-wait-timeout", 600, NULL);
       g_signal_connect_swapped (sink, "underrun-callback", G_CALLBACK (audio_underflow), player);
       //g_signal_connect_swapped (sink, "first-audio-frame-callback", G_CALLBACK(audio_first_frame), player);
     }
     else
-      g_warning ("Couldn't create specified audio sink '%s'", audio_sink);
-    player->asink = sink;
+      g_warning ("Couldn't create specified audio sink '%s'", player->asink_name);
+    *asink = sink;
   }
 
   //vsink
-  if (video_sink != NULL) {
-    if (strchr (video_sink, ' ') != NULL)
-      sink = gst_parse_bin_from_description (video_sink, TRUE, NULL);
+  if (player->vsink_name != NULL) {
+    if (strchr (player->vsink_name, ' ') != NULL)
+      sink = gst_parse_bin_from_description (player->vsink_name, TRUE, NULL);
     else
-      sink = gst_element_factory_make (video_sink, NULL);
+      sink = gst_element_factory_make (player->vsink_name, NULL);
 
     if (sink != NULL) {
-      g_object_set (player->playbin, "video-sink", sink, NULL);
-      player->vsink = sink;
-      //g_object_set (player->vsink, "stop-keep-frame", TRUE, NULL);
-      g_signal_connect_swapped (player->vsink, "buffer-underflow-callback", G_CALLBACK (video_underflow), player);
-      g_signal_connect_swapped (player->vsink, "first-video-frame-callback", G_CALLBACK (video_first_frame), player);
+      g_object_set (playbin, "video-sink", sink, NULL);
+      *vsink = sink;
+      //g_object_set (sink, "stop-keep-frame", TRUE, NULL);
+      g_signal_connect_swapped (sink, "buffer-underflow-callback", G_CALLBACK (video_underflow), player);
+      g_signal_connect_swapped (sink, "first-video-frame-callback", G_CALLBACK (video_first_frame), player);
     }
     else
-      g_warning ("Couldn't create specified video sink '%s'", video_sink);
+      g_warning ("Couldn't create specified video sink '%s'", player->vsink_name);
+  }
+
+  return playbin;
+}
+
+AGMP_HANDLE agmp_init (void)
+{
+  int argc = 0;
+  char **argv = NULL;
+
+  g_mutex_lock (&dispatcher_lock);
+  if (!gst_is_initialized ()) {
+    const gchar *env = g_getenv ("AGMP_SHARED_LOOP");
+    if (env && g_str_has_prefix (env, "1"))
+      use_shared_dispatcher = TRUE;
+    gst_init(&argc, &argv);
+  }
+  g_mutex_unlock (&dispatcher_lock);
+  agmp_mmap_src_register ();
+  agmp_mem_src_register ();
+
+  GstPlay *player;
+
+  player = g_new0 (GstPlay, 1);
+  if (NULL == player)
+  {
+    gst_print ("new player failed.\n");
+	  return NULL;
+  }
+
+  player->uri = NULL;
+  player->next_uri = NULL;
+  player->next_pending = FALSE;
+  g_mutex_init (&player->uri_lock);
+  g_mutex_init (&player->thumb_lock);
+  g_mutex_init (&player->probe_lock);
+  player->probe_chain = g_ptr_array_new_with_free_func (g_free);
+  player->prepare_start = -1;
+  player->license_url = NULL;
+  player->status = AGMP_STATUS_NULL;
+
+  player->playbin = NULL;
+  player->is_playbin3 = FALSE;
+  player->asink = NULL;
+  player->vsink = NULL;
+
+  g_mutex_init (&player->selection_lock);
+  g_mutex_init (&player->switch_lock);
+  player->switch_latency = -1;
+  g_mutex_init (&player->seek_lock);
+  player->scrubbing = FALSE;
+  player->seek_in_flight = FALSE;
+  player->scrub_target = -1;
+  player->scrub_last = -1;
+  player->rate_switch_start = -1;
+  player->rate_switch_latency = -1;
+  g_mutex_init (&player->elements_lock);
+  player->deep_notify_id = 0;
+  player->dispatcher = NULL;
+  player->bus_watch = NULL;
+  player->notify_app = NULL;
+  player->userdata = NULL;
+
+  player->missing = NULL;
+  player->buffering = FALSE;
+  player->is_live = FALSE;
+  player->gapless = FALSE;
+  player->wait_on_eos = FALSE;
+  g_rec_mutex_init (&player->rate_lock);
+  player->rate = 1.0;
+  player->trick_mode = GST_PLAY_TRICK_MODE_NONE;
+  player->win_size.x = 0;
+  player->win_size.y = 0;
+  player->win_size.w = 0;
+  player->win_size.h = 0;
+  player->percent = 0;
+  player->async_done = FALSE;
+  player->aamp_state = eSTATE_IDLE;
+  g_mutex_init(&player->lock);
+  player->allocator = NULL;
+  g_mutex_init (&player->progress_lock);
+  player->duration = -1;
+  player->anchor_clock = NULL;
+  player->dual_pipeline = FALSE;
+  player->standby = NULL;
+  player->standby_uri = NULL;
+  player->standby_watch = NULL;
+
+  gboolean use_playbin3 = FALSE;
+  gchar *flags_string = NULL;
+  char* audio_sink = "amlhalasink";
+  char* video_sink = "westerossink";
+
+  const gchar *sink_name = g_getenv ("GST_CFG_VIDEO_SINK");
+  if ( sink_name )
+  {
+     if (strstr(sink_name, "westerossink"))
+        video_sink = "westerossink";
+     else if(strstr(sink_name, "amlvideosink"))
+        video_sink = "amlvideosink";
+     else if(strstr(sink_name, "clutterautovideosink"))
+        video_sink = "clutterautovideosink";
+     else
+        video_sink = "westerossink";
+  }
+
+  if (use_playbin3) {
+    player->is_playbin3 = TRUE;
+  } else {
+    const gchar *env = g_getenv ("USE_PLAYBIN3");
+    if (env && g_str_has_prefix (env, "1"))
+      player->is_playbin3 = TRUE;
+  }
+  player->asink_name = audio_sink;
+  player->vsink_name = video_sink;
+
+  GstElement *playbin = play_make_playbin (player, &player->asink, &player->vsink);
+  if (playbin == NULL) {
+    gst_print ("make playbin failed.\n");
+    return NULL;
   }
 
+  player->playbin = playbin;
+  g_signal_connect(playbin, "deep-element-added", G_CALLBACK(default_element_added), player);
+  g_signal_connect(playbin, "deep-element-removed", G_CALLBACK(default_element_removed), player);
+
   if (flags_string != NULL) {
     GParamSpec *pspec;
     GValue val = { 0, };
@@ -584,20 +1340,27 @@ AGMP_HANDLE agmp_init (void)
         gst_element_add_property_deep_notify_watch (player->playbin, NULL, TRUE);
   }*/
 
-  player->loop = g_main_loop_new (NULL, FALSE);
-  player->bus_watch = gst_bus_add_watch (GST_ELEMENT_BUS (player->playbin), play_bus_msg, player);
-
-    //create play thread
-  player->play_thread = g_thread_new ("video play run thread", play_run_thread, player);
-  if (!player->play_thread) {
-      gst_print ("fail to create play thread");
+  player->dispatcher = play_dispatcher_get ();
+  if (!player->dispatcher) {
       return NULL;
   }
-
-  player->timer_id = g_timeout_add (100, porting_timeout, player);
-  player->timer_cnt = PROGRESS_CALLBACK_CNT;
-
-  L.level = LOG_DEBUG;
+  player->bus_watch = play_add_bus_watch (player, player->playbin, play_bus_msg);
+  play_set_bus_sync (player, player->playbin, TRUE);
+
+  /* progress timer only runs while playing with a callback registered */
+  player->timer = NULL;
+  player->progress_interval = PROGRESS_DEFAULT_INTERVAL;
+  player->live_timer = NULL;
+  player->live_target = 0;
+  player->live_latency = -1;
+  player->live_tempo = FALSE;
+  player->av_timer = NULL;
+  player->av_bound = 0;
+  player->av_vtap = NULL;
+  player->av_atap = NULL;
+  agmp_av_sync_reset (&player->av_sync);
+
+  agmp_log_set_level (LOG_DEBUG);
   return (AGMP_HANDLE)player;
 }
 
@@ -605,6 +1368,7 @@ int agmp_prepare (AGMP_HANDLE handle)
 {
   CHECK_POINTER_VALID(handle);
   GstPlay* player = (GstPlay*)handle;
+  gchar *uri;
 
   gst_print ("prepare stream enter.\n");
   set_aamp_state(player, eSTATE_PREPARING);
@@ -621,7 +1385,14 @@ int agmp_prepare (AGMP_HANDLE handle)
   }
 
   play_reset (player);
-  g_object_set (player->playbin, "uri", player->uri, NULL);
+  play_apply_buffering_config (player, player->playbin);
+  g_mutex_lock (&player->uri_lock);
+  uri = g_strdup (player->uri);
+  g_mutex_unlock (&player->uri_lock);
+  play_probe_begin (player, uri);
+  g_object_set (player->playbin, "uri", uri, NULL);
+  g_free (uri);
+  play_live_audio_filter (player);
   gboolean ret = TRUE;
   player->async_done = FALSE;
   switch (gst_element_set_state (player->playbin, GST_STATE_PAUSED)) {
@@ -670,6 +1441,10 @@ int agmp_play (AGMP_HANDLE handle)
   }
 
   player->desired_state = GST_STATE_PLAYING;
+  if (player->buffering) {
+    gst_print ("I am buffering, play when buffering done\n");
+    return AAMP_SUCCESS;
+  }
   gst_element_set_state (player->playbin, GST_STATE_PLAYING);
   return AAMP_SUCCESS;
 }
@@ -693,6 +1468,8 @@ int agmp_pause (AGMP_HANDLE handle)
 
   if (player->buffering) {
     gst_print ("I am buffering, no need pause\n");
+    /* stay paused when buffering completes */
+    player->desired_state = GST_STATE_PAUSED;
 	  return AAMP_SUCCESS;
   }
 
@@ -720,6 +1497,7 @@ int agmp_stop (AGMP_HANDLE handle)
   }
   set_aamp_state(player, eSTATE_STOPPING);
   gst_element_set_state (player->playbin, GST_STATE_READY);
+  play_seek_reset (player);
   if (player->allocator) {
     gst_object_unref(player->allocator);
     player->allocator = NULL;
@@ -729,20 +1507,10 @@ int agmp_stop (AGMP_HANDLE handle)
   usleep(1000000);
   set_aamp_state(player, eSTATE_STOPPED);
   player->status = AGMP_STATUS_STOPED;
-}
-
-void quit_thread(GstPlay* player)
-{
-  if (player->play_thread) {
-    gst_print ("\njoin thread\n");
-    g_thread_join (player->play_thread);
-    player->play_thread = NULL;
-  }
-}
-
-void quit_loop(GstPlay* player)
-{
-	g_main_loop_quit (player->loop);
+  play_anchor_position (player, FALSE);
+  play_update_progress_timer (player);
+  play_update_live_timer (player);
+  play_update_av_timer (player);
 }
 
 int agmp_exit (AGMP_HANDLE handle)
@@ -751,14 +1519,13 @@ int agmp_exit (AGMP_HANDLE handle)
   GstPlay* player = (GstPlay*)handle;
   set_aamp_state(player, eSTATE_RELEASED);
   gst_print ("exit enter.\n");
-  quit_loop(player);
   agmp_deinit(handle);
-  quit_thread(player);
-  g_source_remove (player->timer_id);
+  play_dispatcher_unref (player->dispatcher);
   g_free (player);
   player = NULL;
   //gst_deinit();
   gst_print ("exit over.\n");
+  agmp_log_flush ();
   return AAMP_SUCCESS;
 }
 
@@ -776,12 +1543,12 @@ void agmp_deinit (AGMP_HANDLE handle)
 
   play_reset (player);
 
+  play_drop_standby (player);
+  play_set_bus_sync (player, player->playbin, FALSE);
   gst_element_set_state (player->playbin, GST_STATE_NULL);
   gst_object_unref (player->playbin);
 
-  g_source_remove (player->bus_watch);
-
-  g_main_loop_unref (player->loop);
+  play_remove_source (&player->bus_watch);
 
   //g_strfreev (player->uri);
 
@@ -794,7 +1561,32 @@ void agmp_deinit (AGMP_HANDLE handle)
   if (player->cur_text_sid != NULL)
     g_free (player->cur_text_sid);
   if (player->uri != NULL)
-    g_free (player->uri);
+    g_free ((gchar *) player->uri);
+  if (player->next_uri != NULL)
+    g_free (player->next_uri);
+  agmp_thumbnailer_free (player->thumbnailer);
+  g_mutex_clear (&player->thumb_lock);
+  agmp_probe_entry_clear (&player->probe);
+  g_clear_object (&player->probe_typefind);
+  g_free (player->probe_container);
+  g_ptr_array_unref (player->probe_chain);
+  g_mutex_clear (&player->probe_lock);
+  g_mutex_lock (&player->progress_lock);
+  play_remove_source (&player->timer);
+  play_remove_source (&player->live_timer);
+  play_remove_source (&player->av_timer);
+  g_mutex_unlock (&player->progress_lock);
+  /* a shared dispatcher keeps running, make sure none of our callbacks still is */
+  play_dispatcher_sync (player->dispatcher);
+  play_anchor_position (player, FALSE);
+  agmp_av_sync_tap_free (player->av_vtap);
+  agmp_av_sync_tap_free (player->av_atap);
+  g_mutex_clear (&player->progress_lock);
+  g_mutex_clear (&player->uri_lock);
+  g_mutex_clear (&player->elements_lock);
+  g_mutex_clear (&player->switch_lock);
+  g_mutex_clear (&player->seek_lock);
+  g_rec_mutex_clear (&player->rate_lock);
   g_mutex_clear (&player->selection_lock);
 
 }
@@ -839,7 +1631,22 @@ long long agmp_get_position(AGMP_HANDLE handle)
   long long  pos = -1;
   if (player->buffering)
     return pos;
-  gst_element_query_position (player->playbin, GST_FORMAT_TIME, &pos);
+
+  /* while playing, position follows the pipeline clock from the last anchor */
+  g_mutex_lock (&player->progress_lock);
+  if (player->anchor_clock) {
+    GstClockTime now = gst_clock_get_time (player->anchor_clock);
+    pos = player->anchor_pos +
+        (gint64) (GST_CLOCK_DIFF (player->anchor_time, now) * player->anchor_rate);
+    if (pos < 0)
+      pos = 0;
+    if (player->duration > 0 && pos > player->duration)
+      pos = player->duration;
+  }
+  g_mutex_unlock (&player->progress_lock);
+
+  if (pos < 0)
+    gst_element_query_position (player->playbin, GST_FORMAT_TIME, &pos);
   return pos;
 }
 
@@ -854,7 +1661,18 @@ long long agmp_get_duration(AGMP_HANDLE handle)
   long long  dur = -1;
   if (player->buffering)
     return dur;
-  gst_element_query_duration (player->playbin, GST_FORMAT_TIME, &dur);
+
+  g_mutex_lock (&player->progress_lock);
+  dur = player->duration;
+  g_mutex_unlock (&player->progress_lock);
+  if (dur > 0)
+    return dur;
+
+  if (gst_element_query_duration (player->playbin, GST_FORMAT_TIME, &dur) && dur > 0) {
+    g_mutex_lock (&player->progress_lock);
+    player->duration = dur;
+    g_mutex_unlock (&player->progress_lock);
+  }
   return dur;
 }
 
@@ -869,8 +1687,19 @@ int agmp_set_speed(AGMP_HANDLE handle, AGMP_PLAY_SPEED rate)
     return AAMP_FAILED_IN_THIS_STATE;
   }
 
-  double rate_level[] = {0.125, 0.25, 0.5, 1, 2, 4, 8};
-  if (rate > sizeof(rate_level)/sizeof(rate_level[0])) {
+  static const double rate_level[] = {
+    [AGMP_PLAY_SPEED_1_4] = 0.25,
+    [AGMP_PLAY_SPEED_1_2] = 0.5,
+    [AGMP_PLAY_SPEED_1] = 1,
+    [AGMP_PLAY_SPEED_2] = 2,
+    [AGMP_PLAY_SPEED_4] = 4,
+    [AGMP_PLAY_SPEED_8] = 8,
+    [AGMP_PLAY_SPEED_REV_1] = -1,
+    [AGMP_PLAY_SPEED_REV_2] = -2,
+    [AGMP_PLAY_SPEED_REV_4] = -4,
+    [AGMP_PLAY_SPEED_REV_8] = -8,
+  };
+  if (rate < 0 || rate >= sizeof(rate_level)/sizeof(rate_level[0])) {
     gst_print ("rate out of range, %d.\n", rate);
 	  return AAMP_INVALID_PARAM;
   }
@@ -879,9 +1708,9 @@ int agmp_set_speed(AGMP_HANDLE handle, AGMP_PLAY_SPEED rate)
 
   if (new_rate != player->rate)
   {
-    player->rate = new_rate;
-    gst_print("set rate to %lf\n", player->rate);
-    play_set_playback_rate (player, player->rate);
+    gst_print("set rate to %lf\n", new_rate);
+    /* player->rate follows once the pipeline took the new rate */
+    play_set_playback_rate (player, new_rate);
   }
   else
   {
@@ -907,9 +1736,433 @@ static int play_reset (GstPlay * player)
 
   player->buffering = FALSE;
   player->is_live = FALSE;
+  g_mutex_lock (&player->progress_lock);
+  player->live_latency = -1;
+  agmp_av_sync_reset (&player->av_sync);
+  g_mutex_unlock (&player->progress_lock);
+  play_switch_cancel (player);
+  play_seek_reset (player);
+  play_invalidate_duration (player);
+  play_anchor_position (player, FALSE);
+  return AAMP_SUCCESS;
+}
+
+/* no ASYNC_DONE will come for a seek in flight any more */
+static void play_seek_reset (GstPlay *player)
+{
+  g_mutex_lock (&player->seek_lock);
+  player->seek_in_flight = FALSE;
+  player->scrub_seek = FALSE;
+  player->scrub_target = -1;
+  g_mutex_unlock (&player->seek_lock);
+}
+
+static void play_invalidate_duration (GstPlay *player)
+{
+  g_mutex_lock (&player->progress_lock);
+  player->duration = -1;
+  g_mutex_unlock (&player->progress_lock);
+}
+
+/* take a fresh position/clock pair, or drop the anchor when not playing */
+static void play_anchor_position (GstPlay *player, gboolean playing)
+{
+  GstClock *clock = NULL;
+  GstClockTime now = GST_CLOCK_TIME_NONE;
+  gint64 pos = -1;
+
+  if (playing && gst_element_query_position (player->playbin, GST_FORMAT_TIME, &pos)) {
+    clock = gst_element_get_clock (player->playbin);
+    if (clock)
+      now = gst_clock_get_time (clock);
+  }
+
+  g_mutex_lock (&player->progress_lock);
+  if (player->anchor_clock)
+    gst_object_unref (player->anchor_clock);
+  player->anchor_clock = clock;
+  player->anchor_time = now;
+  player->anchor_pos = pos;
+  player->anchor_rate = player->rate;
+  g_mutex_unlock (&player->progress_lock);
+}
+
+/* run the progress timer only while playing and somebody listens */
+static void play_update_progress_timer (GstPlay *player)
+{
+  gboolean want;
+
+  g_mutex_lock (&player->progress_lock);
+  want = player->notify_app != NULL && player->progress_interval > 0
+      && player->status == AGMP_STATUS_PLAYING;
+  if (want && !player->timer) {
+    player->timer = play_add_timeout (player, player->progress_interval, (GSourceFunc) porting_timeout);
+  } else if (!want && player->timer) {
+    play_remove_source (&player->timer);
+  }
+  g_mutex_unlock (&player->progress_lock);
+}
+
+int agmp_set_progress_interval(AGMP_HANDLE handle, int interval_ms)
+{
+  CHECK_POINTER_VALID(handle);
+  GstPlay* player = (GstPlay*)handle;
+
+  if (interval_ms < 0)
+    return AAMP_INVALID_PARAM;
+
+  g_mutex_lock (&player->progress_lock);
+  player->progress_interval = interval_ms;
+  /* restart with the new period */
+  play_remove_source (&player->timer);
+  g_mutex_unlock (&player->progress_lock);
+
+  play_update_progress_timer (player);
+  return AAMP_SUCCESS;
+}
+
+
+/* ms behind the live edge: end of the seekable window when the source has one,
+ * else how much data is buffered ahead of the playback position */
+static gint64 play_measure_live_latency (GstPlay *player)
+{
+  GstQuery *query;
+  GstFormat format;
+  gboolean seekable = FALSE;
+  gint64 pos = -1, start = -1, stop = -1;
+  gint64 latency = -1;
+
+  if (!gst_element_query_position (player->playbin, GST_FORMAT_TIME, &pos) || pos < 0)
+    return -1;
+
+  query = gst_query_new_seeking (GST_FORMAT_TIME);
+  if (gst_element_query (player->playbin, query)) {
+    gst_query_parse_seeking (query, &format, &seekable, &start, &stop);
+    if (seekable && format == GST_FORMAT_TIME && stop > pos)
+      latency = (stop - pos) / GST_MSECOND;
+  }
+  gst_query_unref (query);
+  if (latency >= 0)
+    return latency;
+
+  query = gst_query_new_buffering (GST_FORMAT_TIME);
+  if (gst_element_query (player->playbin, query)) {
+    gst_query_parse_buffering_range (query, &format, &start, &stop, NULL);
+    if (format == GST_FORMAT_TIME && stop > pos)
+      latency = (stop - pos) / GST_MSECOND;
+  }
+  gst_query_unref (query);
+  return latency;
+}
+
+/* proportional rate around 1.0, quantized so small jitter doesn't cause a rate change every tick */
+static gdouble play_live_rate (GstPlay *player, gint64 latency, gint64 target)
+{
+  gint64 error = latency - target;
+  gint64 deadband = LIVE_DEADBAND;
+  gdouble delta;
+  gint steps;
+
+  /* once catching up, keep going until close to target */
+  if (player->rate != 1.0)
+    deadband /= 4;
+  if (ABS (error) <= deadband)
+    return 1.0;
+
+  delta = CLAMP ((gdouble) error / LIVE_ERROR_RANGE * LIVE_RATE_MAX_DELTA,
+      -LIVE_RATE_MAX_DELTA, LIVE_RATE_MAX_DELTA);
+  steps = (gint) (delta / LIVE_RATE_STEP + (delta >= 0 ? 0.5 : -0.5));
+  if (steps == 0)
+    steps = error > 0 ? 1 : -1;
+  return 1.0 + steps * LIVE_RATE_STEP;
+}
+
+static gboolean play_live_timeout (gpointer user_data)
+{
+  GstPlay *player = user_data;
+  gint64 latency, target;
+  gdouble rate;
+
+  if (player->buffering || player->status != AGMP_STATUS_PLAYING)
+    return G_SOURCE_CONTINUE;
+  /* NO_PREROLL sources, or adaptive live streams that preroll but have no duration */
+  if (!player->is_live && agmp_get_duration (player) > 0)
+    return G_SOURCE_CONTINUE;
+
+  latency = play_measure_live_latency (player);
+  g_mutex_lock (&player->progress_lock);
+  player->live_latency = latency;
+  target = player->live_target;
+  g_mutex_unlock (&player->progress_lock);
+
+  /* the app is changing the speed right now, look again next tick */
+  if (!g_rec_mutex_trylock (&player->rate_lock))
+    return G_SOURCE_CONTINUE;
+
+  /* leave trick play and user speeds alone */
+  if (latency < 0 || target <= 0 || player->trick_mode != GST_PLAY_TRICK_MODE_NONE
+      || ABS (player->rate - 1.0) > LIVE_RATE_MAX_DELTA + LIVE_RATE_STEP / 2)
+    goto done;
+
+  rate = play_live_rate (player, latency, target);
+  if (ABS (rate - player->rate) < LIVE_RATE_STEP / 2)
+    goto done;
+
+#if GST_CHECK_VERSION(1,18,0)
+  if (player->async_done && play_instant_rate_change (player, rate))
+    log_debug ("live latency %" G_GINT64_FORMAT "ms, target %" G_GINT64_FORMAT "ms, rate %.2f",
+        latency, target, rate);
+#else
+  /* a flushing seek would drop what we try to catch up on */
+  log_debug ("live latency %" G_GINT64_FORMAT "ms, no instant rate change to catch up", latency);
+#endif
+
+done:
+  g_rec_mutex_unlock (&player->rate_lock);
+  return G_SOURCE_CONTINUE;
+}
+
+/* run the live controller only while playing with a target set */
+static void play_update_live_timer (GstPlay *player)
+{
+  gboolean want;
+
+  g_mutex_lock (&player->progress_lock);
+  want = player->live_target > 0 && player->status == AGMP_STATUS_PLAYING;
+  if (want && !player->live_timer) {
+    player->live_timer = play_add_timeout (player, LIVE_CHECK_INTERVAL, play_live_timeout);
+  } else if (!want && player->live_timer) {
+    play_remove_source (&player->live_timer);
+  }
+  g_mutex_unlock (&player->progress_lock);
+}
+
+/* sources that play live content, adaptive manifests may be live too */
+static gboolean play_uri_is_live (const gchar *uri)
+{
+  static const gchar *schemes[] = { "rtsp", "rtsps", "rtsph", "rtp", "udp", "srt", "rtmp", "rtmps",
+    "dvb", "tcp", NULL };
+  gchar *scheme, *lower;
+  gboolean live;
+
+  if (!uri)
+    return FALSE;
+  scheme = gst_uri_get_protocol (uri);
+  live = scheme && g_strv_contains (schemes, scheme);
+  g_free (scheme);
+  if (live)
+    return TRUE;
+
+  lower = g_ascii_strdown (uri, -1);
+  live = strstr (lower, ".m3u8") || strstr (lower, ".mpd");
+  g_free (lower);
+  return live;
+}
+
+/* the audio sink can take compressed audio, a filter in front would force decoding */
+static gboolean play_asink_takes_compressed (GstPlay *player)
+{
+  GstElement *asink;
+  GstPad *pad;
+  GstCaps *caps;
+  gboolean compressed = FALSE;
+  guint i;
+
+  g_mutex_lock (&player->elements_lock);
+  asink = player->asink ? gst_object_ref (player->asink) : NULL;
+  g_mutex_unlock (&player->elements_lock);
+  if (!asink)
+    return FALSE;
+
+  pad = gst_element_get_static_pad (asink, "sink");
+  if (pad) {
+    caps = gst_pad_query_caps (pad, NULL);
+    for (i = 0; i < gst_caps_get_size (caps) && !compressed; i++) {
+      const gchar *name = gst_structure_get_name (gst_caps_get_structure (caps, i));
+
+      compressed = g_str_has_prefix (name, "audio/") && strcmp (name, "audio/x-raw") != 0;
+    }
+    gst_caps_unref (caps);
+    gst_object_unref (pad);
+  }
+  gst_object_unref (asink);
+  return compressed;
+}
+
+/* keep the pitch while the controller nudges the rate of live content. the audio-filter
+ * is taken when the audio chain is built, so this is decided for each prepare */
+static void play_live_audio_filter (GstPlay *player)
+{
+  GstElement *tempo;
+  gboolean want;
+  gchar *uri;
+
+  g_mutex_lock (&player->uri_lock);
+  uri = g_strdup (player->uri);
+  g_mutex_unlock (&player->uri_lock);
+  want = player->live_target > 0 && play_uri_is_live (uri);
+  g_free (uri);
+  if (want && play_asink_takes_compressed (player)) {
+    log_debug ("audio sink takes compressed audio, no scaletempo for live catch-up");
+    want = FALSE;
+  }
+
+  if (want == player->live_tempo)
+    return;
+
+  if (!want) {
+    g_object_set (player->playbin, "audio-filter", NULL, NULL);
+    player->live_tempo = FALSE;
+    return;
+  }
+
+  tempo = gst_element_factory_make ("scaletempo", NULL);
+  if (!tempo) {
+    log_warn ("no scaletempo, live catch-up changes audio pitch");
+    return;
+  }
+  g_object_set (player->playbin, "audio-filter", tempo, NULL);
+  player->live_tempo = TRUE;
+}
+
+int agmp_set_live_latency_target(AGMP_HANDLE handle, int target_ms)
+{
+  CHECK_POINTER_VALID(handle);
+  GstPlay* player = (GstPlay*)handle;
+
+  if (target_ms < 0)
+    return AAMP_INVALID_PARAM;
+
+  g_mutex_lock (&player->progress_lock);
+  player->live_target = target_ms;
+  g_mutex_unlock (&player->progress_lock);
+
+#if GST_CHECK_VERSION(1,18,0)
+  /* turning it off gives back normal speed if the controller left it nudged */
+  g_rec_mutex_lock (&player->rate_lock);
+  if (target_ms == 0 && player->rate != 1.0 && player->trick_mode == GST_PLAY_TRICK_MODE_NONE
+      && ABS (player->rate - 1.0) <= LIVE_RATE_MAX_DELTA + LIVE_RATE_STEP / 2 && player->async_done)
+    play_instant_rate_change (player, 1.0);
+  g_rec_mutex_unlock (&player->rate_lock);
+#endif
+
+  /* streams prepared from now on get their audio passthrough back */
+  if (target_ms == 0)
+    play_live_audio_filter (player);
+  play_update_live_timer (player);
+  return AAMP_SUCCESS;
+}
+
+long long agmp_get_live_latency(AGMP_HANDLE handle)
+{
+  if (NULL == handle)
+  {
+    return -1;
+  }
+  GstPlay* player = (GstPlay*)handle;
+  long long latency;
+
+  g_mutex_lock (&player->progress_lock);
+  latency = player->live_latency;
+  g_mutex_unlock (&player->progress_lock);
+  return latency;
+}
+
+static gboolean play_av_sync_timeout (gpointer user_data)
+{
+  GstPlay *player = user_data;
+  GstElement *vsink, *asink;
+  AgmpAvSync sync;
+  gboolean sampled, alert = FALSE;
+
+  if (player->buffering || player->status != AGMP_STATUS_PLAYING || !player->async_done)
+    return G_SOURCE_CONTINUE;
+
+  g_mutex_lock (&player->elements_lock);
+  vsink = player->vsink ? gst_object_ref (player->vsink) : NULL;
+  asink = player->asink ? gst_object_ref (player->asink) : NULL;
+  g_mutex_unlock (&player->elements_lock);
+
+  /* sinks come and go with the streams, follow them */
+  if (!agmp_av_sync_tap_is_for (player->av_vtap, vsink)) {
+    agmp_av_sync_tap_free (player->av_vtap);
+    player->av_vtap = agmp_av_sync_tap_new (vsink);
+  }
+  if (!agmp_av_sync_tap_is_for (player->av_atap, asink)) {
+    agmp_av_sync_tap_free (player->av_atap);
+    player->av_atap = agmp_av_sync_tap_new (asink);
+  }
+
+  /* sample on a copy, the taps take their own locks */
+  g_mutex_lock (&player->progress_lock);
+  sync = player->av_sync;
+  g_mutex_unlock (&player->progress_lock);
+  sampled = agmp_av_sync_sample (&sync, player->playbin, player->av_vtap, player->av_atap);
+  if (sampled) {
+    g_mutex_lock (&player->progress_lock);
+    alert = agmp_av_sync_check_bound (&sync, player->av_bound);
+    player->av_sync = sync;
+    g_mutex_unlock (&player->progress_lock);
+  }
+
+  if (vsink)
+    gst_object_unref (vsink);
+  if (asink)
+    gst_object_unref (asink);
+
+  if (alert) {
+    log_warn ("a/v offset %" G_GINT64_FORMAT "us, jitter %" G_GINT64_FORMAT "us, drift %.1fppm",
+        sync.offset, sync.jitter, sync.drift);
+    callback_to_app(player, AGMP_MESSAGE_AV_SYNC_ALERT, player->userdata);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+/* sample a/v sync only while playing, paused sinks have nothing to compare */
+static void play_update_av_timer (GstPlay *player)
+{
+  gboolean want;
+
+  g_mutex_lock (&player->progress_lock);
+  want = player->status == AGMP_STATUS_PLAYING;
+  if (want && !player->av_timer) {
+    player->av_timer = play_add_timeout (player, AV_SYNC_INTERVAL, play_av_sync_timeout);
+  } else if (!want && player->av_timer) {
+    play_remove_source (&player->av_timer);
+  }
+  g_mutex_unlock (&player->progress_lock);
+}
+
+int agmp_get_av_sync_stats(AGMP_HANDLE handle, AvSyncStats* stats)
+{
+  CHECK_POINTER_VALID(handle);
+  CHECK_POINTER_VALID(stats);
+  GstPlay* player = (GstPlay*)handle;
+
+  g_mutex_lock (&player->progress_lock);
+  stats->offset = player->av_sync.offset;
+  stats->jitter = player->av_sync.jitter;
+  stats->drift = player->av_sync.drift;
+  stats->max_offset = player->av_sync.max_offset;
+  stats->samples = player->av_sync.samples;
+  g_mutex_unlock (&player->progress_lock);
   return AAMP_SUCCESS;
 }
 
+int agmp_set_av_sync_bound(AGMP_HANDLE handle, int bound_ms)
+{
+  CHECK_POINTER_VALID(handle);
+  GstPlay* player = (GstPlay*)handle;
+
+  if (bound_ms < 0)
+    return AAMP_INVALID_PARAM;
+
+  g_mutex_lock (&player->progress_lock);
+  player->av_bound = (gint64) bound_ms * 1000;
+  player->av_sync.alerted = FALSE;
+  g_mutex_unlock (&player->progress_lock);
+  return AAMP_SUCCESS;
+}
 
 /* returns TRUE if something was installed and we should restart playback */
 static gboolean
@@ -920,31 +2173,305 @@ play_install_missing_plugins (GstPlay * play)
   return FALSE;
 }
 
-int agmp_replay (AGMP_HANDLE handle)
-{
-  CHECK_POINTER_VALID(handle);
-  GstPlay* player = (GstPlay*)handle;
+int agmp_replay (AGMP_HANDLE handle)
+{
+  CHECK_POINTER_VALID(handle);
+  GstPlay* player = (GstPlay*)handle;
+
+  gchar *uri;
+
+  gst_element_set_state (player->playbin, GST_STATE_READY);
+  play_reset (player);
+
+  g_mutex_lock (&player->uri_lock);
+  uri = g_strdup (player->uri);
+  g_mutex_unlock (&player->uri_lock);
+  g_object_set (player->playbin, "uri", uri, NULL);
+  g_free (uri);
+  switch (gst_element_set_state (player->playbin, GST_STATE_PAUSED)) {
+    case GST_STATE_CHANGE_FAILURE:
+      /* ignore, we should get an error message posted on the bus */
+      break;
+    case GST_STATE_CHANGE_NO_PREROLL:
+      gst_print ("Pipeline is live.\n");
+      player->is_live = TRUE;
+      break;
+    case GST_STATE_CHANGE_ASYNC:
+      gst_print ("Prerolling...\r");
+      break;
+    default:
+      break;
+  }
+
+  return agmp_play(player);
+}
+
+static gboolean play_standby_bus_msg (GstBus * bus, GstMessage * msg, gpointer user_data)
+{
+  GstPlay *player = user_data;
+
+  if (player == NULL) {
+    return TRUE;
+  }
+
+  switch (GST_MESSAGE_TYPE (msg)) {
+    case GST_MESSAGE_ASYNC_DONE:
+      gst_print ("standby prerolled: %s\n", player->standby_uri);
+      g_atomic_int_set (&player->standby_prerolled, TRUE);
+      break;
+    case GST_MESSAGE_ERROR:{
+      GError *err;
+
+      gst_message_parse_error (msg, &err, NULL);
+      gst_printerr ("standby ERROR %s for %s\n", err->message, player->standby_uri);
+      g_clear_error (&err);
+      /* a broken standby just falls back to a cold switch, this watch goes with it */
+      g_source_unref (player->standby_watch);
+      player->standby_watch = NULL;
+      play_drop_standby (player);
+      return FALSE;
+    }
+    default:
+      break;
+  }
+
+  return TRUE;
+}
+
+static gpointer play_drop_pipeline_thread (gpointer data)
+{
+  GstElement *playbin = data;
+
+  gst_element_set_state (playbin, GST_STATE_NULL);
+  gst_object_unref (playbin);
+  return NULL;
+}
+
+/* tear down a pipeline which is no longer shown without blocking the caller */
+static void play_drop_pipeline_async (GstElement *playbin)
+{
+  GThread *thread;
+
+  thread = g_thread_new ("agmp drop pipeline", play_drop_pipeline_thread, playbin);
+  if (thread)
+    g_thread_unref (thread);
+}
+
+static void play_drop_standby (GstPlay *player)
+{
+  if (!player->standby)
+    return;
+
+  play_remove_source (&player->standby_watch);
+  gst_element_set_state (player->standby, GST_STATE_NULL);
+  gst_object_unref (player->standby);
+  player->standby = NULL;
+  player->standby_asink = NULL;
+  player->standby_vsink = NULL;
+  g_free (player->standby_uri);
+  player->standby_uri = NULL;
+  g_atomic_int_set (&player->standby_prerolled, FALSE);
+}
+
+/* find the element slots again after the active playbin was replaced */
+static void play_rescan_elements (GstPlay *player)
+{
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+  gboolean done = FALSE;
+
+  g_mutex_lock (&player->elements_lock);
+  player->uridb = NULL;
+  player->db = NULL;
+  player->pb = NULL;
+  player->dmx = NULL;
+  player->mq = NULL;
+  player->vdec = NULL;
+  player->adec = NULL;
+  player->wlcdmi = NULL;
+  player->playsink = NULL;
+  player->abin = NULL;
+  player->aq = NULL;
+  player->vbin = NULL;
+  player->vq = NULL;
+  g_mutex_unlock (&player->elements_lock);
+
+  g_signal_connect (player->playbin, "deep-element-added", G_CALLBACK (default_element_added), player);
+  g_signal_connect (player->playbin, "deep-element-removed", G_CALLBACK (default_element_removed), player);
+
+  it = gst_bin_iterate_recurse (GST_BIN (player->playbin));
+  while (!done) {
+    switch (gst_iterator_next (it, &item)) {
+      case GST_ITERATOR_OK:{
+        GstElement *element = g_value_get_object (&item);
+        GstObject *parent = gst_object_get_parent (GST_OBJECT (element));
+
+        if (parent) {
+          default_element_added (GST_BIN (player->playbin), GST_BIN (parent), element, player);
+          gst_object_unref (parent);
+        }
+        g_value_reset (&item);
+        break;
+      }
+      case GST_ITERATOR_RESYNC:
+        gst_iterator_resync (it);
+        break;
+      default:
+        done = TRUE;
+        break;
+    }
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  /* sinks may be bins default_element_added can't classify, keep the ones we made */
+  player->asink = player->standby_asink;
+  player->vsink = player->standby_vsink;
+}
+
+int agmp_set_dual_pipeline(AGMP_HANDLE handle, int enable)
+{
+  CHECK_POINTER_VALID(handle);
+  GstPlay* player = (GstPlay*)handle;
+
+  player->dual_pipeline = enable ? TRUE : FALSE;
+  if (!player->dual_pipeline)
+    play_drop_standby (player);
+  gst_print ("dual pipeline %s\n", player->dual_pipeline ? "enabled" : "disabled");
+  return AAMP_SUCCESS;
+}
+
+int agmp_preload_uri(AGMP_HANDLE handle, const char* uri)
+{
+  CHECK_POINTER_VALID(handle);
+  CHECK_POINTER_VALID(uri);
+  GstPlay* player = (GstPlay*)handle;
+
+  if (!player->dual_pipeline)
+  {
+    gst_print ("preload needs dual pipeline mode.\n");
+    return AAMP_FAILED_IN_THIS_STATE;
+  }
+
+  if (player->standby_uri && !strcmp (player->standby_uri, uri))
+    return AAMP_SUCCESS;
+
+  if (!player->standby)
+  {
+    player->standby = play_make_playbin (player, &player->standby_asink, &player->standby_vsink);
+    if (!player->standby)
+    {
+      gst_print ("make standby playbin failed.\n");
+      return AAMP_FAILED;
+    }
+    /* standby prerolls muted and hidden */
+    g_object_set (player->standby, "mute", TRUE, NULL);
+    if (player->standby_vsink)
+      g_object_set (player->standby_vsink, "mute", TRUE, NULL);
+    player->standby_watch = play_add_bus_watch (player, player->standby, play_standby_bus_msg);
+  }
+  else
+  {
+    gst_element_set_state (player->standby, GST_STATE_READY);
+  }
+
+  g_free (player->standby_uri);
+  player->standby_uri = g_strdup (uri);
+  g_atomic_int_set (&player->standby_prerolled, FALSE);
+  play_apply_buffering_config (player, player->standby);
+  g_object_set (player->standby, "uri", player->standby_uri, NULL);
+  if (gst_element_set_state (player->standby, GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE)
+  {
+    gst_print ("standby preroll failed: %s\n", uri);
+    play_drop_standby (player);
+    return AAMP_FAILED;
+  }
+
+  gst_print ("preloading %s\n", uri);
+  return AAMP_SUCCESS;
+}
+
+int agmp_switch_to_preloaded(AGMP_HANDLE handle)
+{
+  CHECK_POINTER_VALID(handle);
+  GstPlay* player = (GstPlay*)handle;
+  GstElement *old;
+  gboolean prerolled;
+
+  if (!player->standby)
+  {
+    gst_print ("nothing preloaded.\n");
+    return AAMP_FAILED_IN_THIS_STATE;
+  }
+
+  gst_print ("switch to preloaded %s\n", player->standby_uri);
+
+  /* stop listening to the old pipeline and hide it */
+  old = player->playbin;
+  play_set_bus_sync (player, old, FALSE);
+  play_remove_source (&player->bus_watch);
+  g_signal_handlers_disconnect_by_data (old, player);
+  if (player->asink)
+    g_signal_handlers_disconnect_by_data (player->asink, player);
+  if (player->vsink)
+  {
+    g_signal_handlers_disconnect_by_data (player->vsink, player);
+    g_object_set (player->vsink, "mute", TRUE, NULL);
+  }
+  g_object_set (old, "mute", TRUE, NULL);
+
+  /* standby becomes the active pipeline */
+  play_remove_source (&player->standby_watch);
+  prerolled = g_atomic_int_get (&player->standby_prerolled);
+  player->playbin = player->standby;
+  player->standby = NULL;
+  g_mutex_lock (&player->uri_lock);
+  g_free ((gchar *) player->uri);
+  player->uri = player->standby_uri;
+  player->standby_uri = NULL;
+  g_free (player->next_uri);
+  player->next_uri = NULL;
+  player->next_pending = FALSE;
+  player->gapless = FALSE;
+  g_mutex_unlock (&player->uri_lock);
+  play_rescan_elements (player);
+  player->standby_asink = NULL;
+  player->standby_vsink = NULL;
+  g_atomic_int_set (&player->standby_prerolled, FALSE);
+
+  g_mutex_lock (&player->selection_lock);
+  if (player->collection)
+    gst_object_unref (player->collection);
+  player->collection = NULL;
+  g_free (player->cur_audio_sid);
+  g_free (player->cur_video_sid);
+  g_free (player->cur_text_sid);
+  player->cur_audio_sid = NULL;
+  player->cur_video_sid = NULL;
+  player->cur_text_sid = NULL;
+  g_mutex_unlock (&player->selection_lock);
 
-  gst_element_set_state (player->playbin, GST_STATE_READY);
   play_reset (player);
+  player->bus_watch = play_add_bus_watch (player, player->playbin, play_bus_msg);
+  play_set_bus_sync (player, player->playbin, TRUE);
 
-  g_object_set (player->playbin, "uri", player->uri, NULL);
-  switch (gst_element_set_state (player->playbin, GST_STATE_PAUSED)) {
-    case GST_STATE_CHANGE_FAILURE:
-      /* ignore, we should get an error message posted on the bus */
-      break;
-    case GST_STATE_CHANGE_NO_PREROLL:
-      gst_print ("Pipeline is live.\n");
-      player->is_live = TRUE;
-      break;
-    case GST_STATE_CHANGE_ASYNC:
-      gst_print ("Prerolling...\r");
-      break;
-    default:
-      break;
-  }
+  /* only sink visibility and audio mute change, no preroll on the way */
+  if (player->win_size.w > 0 && player->win_size.h > 0 && player->vsink)
+    g_object_set (player->vsink, "rectangle", player->videoRectangle, NULL);
+  if (player->vsink)
+    g_object_set (player->vsink, "mute", player->video_muted, NULL);
+  if (player->asink && player->volume > 0)
+    g_object_set (player->asink, "stream-volume", player->volume, NULL);
+  g_object_set (player->playbin, "mute", FALSE, NULL);
 
-  return agmp_play(player);
+  player->async_done = prerolled;
+  player->desired_state = GST_STATE_PLAYING;
+  gst_element_set_state (player->playbin, GST_STATE_PLAYING);
+  if (prerolled)
+    callback_to_app(player, AGMP_MESSAGE_ASYNC_DONE, player->userdata);
+
+  play_drop_pipeline_async (old);
+  return AAMP_SUCCESS;
 }
 
 int aamp_set_audio_track(AGMP_HANDLE handle, int trackid)
@@ -1014,6 +2541,137 @@ int get_audio_track_num(GstPlay * player)
   return nb_audio;
 }
 
+static int play_scrub_seek (GstPlay *player, gint64 pos)
+{
+  gint64 dur = agmp_get_duration (player);
+
+  if (pos < 0)
+    pos = 0;
+  if (dur > 0 && pos > dur)
+    pos = dur;
+
+  g_mutex_lock (&player->seek_lock);
+  player->scrub_last = pos;
+  if (player->seek_in_flight) {
+    /* replaces any older target, the pipeline only sees the latest */
+    player->scrub_target = pos;
+    g_mutex_unlock (&player->seek_lock);
+    return AAMP_SUCCESS;
+  }
+  player->seek_in_flight = TRUE;
+  player->scrub_seek = TRUE;
+  g_mutex_unlock (&player->seek_lock);
+
+  if (!play_do_seek (player, pos, player->rate, player->trick_mode, SCRUB_SEEK_FLAGS)) {
+    g_mutex_lock (&player->seek_lock);
+    player->seek_in_flight = FALSE;
+    g_mutex_unlock (&player->seek_lock);
+    gst_print ("Could not seek\n");
+    return AAMP_FAILED;
+  }
+  return AAMP_SUCCESS;
+}
+
+/* ASYNC_DONE: the seek in flight has displayed its frame, send the next one */
+static void play_seek_done (GstPlay *player)
+{
+  gint64 next = -1;
+  gboolean scrub_frame;
+  GstSeekFlags flags;
+
+  g_mutex_lock (&player->seek_lock);
+  if (!player->seek_in_flight) {
+    g_mutex_unlock (&player->seek_lock);
+    return;
+  }
+  scrub_frame = player->scrub_seek;
+  if (player->scrub_target >= 0) {
+    next = player->scrub_target;
+    player->scrub_target = -1;
+    player->scrub_seek = player->scrubbing;
+  } else {
+    player->seek_in_flight = FALSE;
+  }
+  flags = player->scrub_seek ? SCRUB_SEEK_FLAGS : GST_SEEK_FLAG_ACCURATE;
+  g_mutex_unlock (&player->seek_lock);
+
+  if (scrub_frame)
+    callback_to_app(player, AGMP_MESSAGE_SCRUB_FRAME, player->userdata);
+
+  if (next >= 0 && !play_do_seek (player, next, player->rate, player->trick_mode, flags)) {
+    g_mutex_lock (&player->seek_lock);
+    player->seek_in_flight = FALSE;
+    g_mutex_unlock (&player->seek_lock);
+  }
+}
+
+int agmp_set_scrubbing(AGMP_HANDLE handle, int enable)
+{
+  CHECK_POINTER_VALID(handle);
+  GstPlay* player = (GstPlay*)handle;
+  gint64 final = -1;
+
+  g_mutex_lock (&player->seek_lock);
+  if (enable && !player->scrubbing) {
+    player->scrubbing = TRUE;
+    player->scrub_target = -1;
+    player->scrub_last = -1;
+  } else if (!enable && player->scrubbing) {
+    player->scrubbing = FALSE;
+    /* land exactly where the user let go */
+    if (player->scrub_last >= 0) {
+      if (player->seek_in_flight) {
+        player->scrub_target = player->scrub_last;
+      } else {
+        final = player->scrub_last;
+        player->seek_in_flight = TRUE;
+        player->scrub_seek = FALSE;
+      }
+    }
+  }
+  g_mutex_unlock (&player->seek_lock);
+
+  if (final >= 0 && !play_do_seek (player, final, player->rate, player->trick_mode, GST_SEEK_FLAG_ACCURATE)) {
+    g_mutex_lock (&player->seek_lock);
+    player->seek_in_flight = FALSE;
+    g_mutex_unlock (&player->seek_lock);
+    return AAMP_FAILED;
+  }
+  return AAMP_SUCCESS;
+}
+
+int agmp_get_thumbnail(AGMP_HANDLE handle, double position, int w, int h, unsigned char* buffer)
+{
+  CHECK_POINTER_VALID(handle);
+  GstPlay* player = (GstPlay*)handle;
+  gchar *uri;
+  gboolean ret;
+
+  if (buffer == NULL || w <= 0 || h <= 0 || position < 0)
+    return AAMP_INVALID_PARAM;
+
+  g_mutex_lock (&player->uri_lock);
+  uri = g_strdup (player->uri);
+  g_mutex_unlock (&player->uri_lock);
+  if (uri == NULL)
+    return AAMP_FAILED_IN_THIS_STATE;
+
+  g_mutex_lock (&player->thumb_lock);
+  /* follow the current item across set_uri and gapless switches */
+  if (player->thumbnailer && g_strcmp0 (agmp_thumbnailer_get_uri (player->thumbnailer), uri) != 0) {
+    agmp_thumbnailer_free (player->thumbnailer);
+    player->thumbnailer = NULL;
+  }
+  if (player->thumbnailer == NULL)
+    player->thumbnailer = agmp_thumbnailer_new (uri);
+  ret = player->thumbnailer
+      && agmp_thumbnailer_get (player->thumbnailer, (gint64) (position * GST_SECOND), w, h, buffer);
+  g_mutex_unlock (&player->thumb_lock);
+  g_free (uri);
+
+  return ret ? AAMP_SUCCESS : AAMP_FAILED;
+}
+
 int agmp_seek(AGMP_HANDLE handle, double position)
 {
   CHECK_POINTER_VALID(handle);
@@ -1022,6 +2680,9 @@ int agmp_seek(AGMP_HANDLE handle, double position)
   gboolean seekable = FALSE;
 
   gst_print("seek to %lf\n", position);
+  if (player->scrubbing)
+    return play_scrub_seek (player, GST_SECOND * position);
+
   query = gst_query_new_seeking (GST_FORMAT_TIME);
   if (!gst_element_query (player->playbin, query)) {
     gst_query_unref (query);
@@ -1043,7 +2704,7 @@ int agmp_seek(AGMP_HANDLE handle, double position)
   } else {
     if (pos < 0)
       pos = 0;
-    play_do_seek (player, pos, player->rate, player->trick_mode);
+    play_do_seek (player, pos, player->rate, player->trick_mode, GST_SEEK_FLAG_ACCURATE);
   }
 
   return AAMP_SUCCESS;
@@ -1058,6 +2719,92 @@ seek_failed:
   player->wait_on_eos = enable;
 }*/
 
+int agmp_set_buffering_config(AGMP_HANDLE handle, BufferingConfig* config)
+{
+  CHECK_POINTER_VALID(handle);
+  CHECK_POINTER_VALID(config);
+  GstPlay* player = (GstPlay*)handle;
+
+  if (config->low_percent < 0 || config->high_percent > 100
+      || (config->high_percent > 0 && config->low_percent >= config->high_percent))
+  {
+    gst_print ("invalid buffering thresholds %d/%d.\n", config->low_percent, config->high_percent);
+    return AAMP_INVALID_PARAM;
+  }
+
+  player->buffering_config = *config;
+  if (player->buffering_config.low_percent <= 0)
+    player->buffering_config.low_percent = BUFFERING_DEFAULT_LOW_PERCENT;
+  if (player->buffering_config.high_percent <= 0)
+    player->buffering_config.high_percent = BUFFERING_DEFAULT_HIGH_PERCENT;
+  player->has_buffering_config = TRUE;
+  return AAMP_SUCCESS;
+}
+
+/* playbin properties only matter before the source is created */
+static void play_apply_buffering_config (GstPlay *player, GstElement *playbin)
+{
+  BufferingConfig *config = &player->buffering_config;
+  guint flags = 0;
+
+  if (!player->has_buffering_config)
+    return;
+
+  if (config->buffer_size >= 0)
+    g_object_set (playbin, "buffer-size", (gint) config->buffer_size, NULL);
+  if (config->buffer_duration >= 0)
+    g_object_set (playbin, "buffer-duration", (gint64) config->buffer_duration, NULL);
+  g_object_set (playbin, "ring-buffer-max-size", (guint64) config->ring_buffer_max_size, NULL);
+
+  g_object_get (playbin, "flags", &flags, NULL);
+  if (config->download)
+    flags |= GST_PLAY_FLAG_DOWNLOAD;
+  else
+    flags &= ~GST_PLAY_FLAG_DOWNLOAD;
+  g_object_set (playbin, "flags", flags, NULL);
+
+  gst_print ("buffering size:%lld duration:%lld download:%d ring:%llu percent:%d/%d\n",
+      config->buffer_size, config->buffer_duration, config->download,
+      config->ring_buffer_max_size, config->low_percent, config->high_percent);
+}
+
+/* pause only when the level really runs low and resume at the high mark,
+ * or earlier when the download rate keeps ahead of playback */
+static void play_buffering_policy (GstPlay *player, GstMessage *msg, gint percent)
+{
+  BufferingConfig *config = &player->buffering_config;
+  GstBufferingMode mode;
+  gint avg_in = -1, avg_out = -1;
+  gint64 left = -1;
+
+  /* no state management needed for live pipelines */
+  if (player->is_live)
+    return;
+
+  gst_message_parse_buffering_stats (msg, &mode, &avg_in, &avg_out, &left);
+
+  if (!player->buffering) {
+    if (percent < config->low_percent && player->desired_state == GST_STATE_PLAYING) {
+      gst_print ("buffering low %d%%, in:%d out:%d, pause\n", percent, avg_in, avg_out);
+      player->buffering = TRUE;
+      gst_element_set_state (player->playbin, GST_STATE_PAUSED);
+    }
+  } else {
+    gboolean resume = percent >= config->high_percent || percent >= 100;
+
+    if (!resume && percent >= config->low_percent && avg_in > 0 && avg_out > 0
+        && avg_in >= avg_out * BUFFERING_RATE_MARGIN)
+      resume = TRUE;
+
+    if (resume) {
+      gst_print ("buffering done %d%%, in:%d out:%d left:%" G_GINT64_FORMAT "ms, resume\n",
+          percent, avg_in, avg_out, left);
+      player->buffering = FALSE;
+      gst_element_set_state (player->playbin, player->desired_state);
+    }
+  }
+}
+
 int agmp_get_buffering_percent(AGMP_HANDLE handle)
 {
   CHECK_POINTER_VALID(handle);
@@ -1065,6 +2812,25 @@ int agmp_get_buffering_percent(AGMP_HANDLE handle)
   return player->percent;
 }
 
+/* runs on the posting thread, only for what has to happen before data flows on.
+ * notifications stay with play_bus_msg so the app gets them in bus order, after
+ * the state they report has been updated */
+static GstBusSyncReply play_bus_sync_msg (GstBus * bus, GstMessage * msg, gpointer user_data)
+{
+  GstPlay *player = user_data;
+
+  switch (GST_MESSAGE_TYPE (msg)) {
+    case GST_MESSAGE_ELEMENT:
+      /* the cached container caps must be validated before typefind sees data */
+      if (gst_message_has_name (msg, "http-headers"))
+        play_probe_http_headers (player, gst_message_get_structure (msg));
+      break;
+    default:
+      break;
+  }
+  return GST_BUS_PASS;
+}
+
 static gboolean play_bus_msg (GstBus * bus, GstMessage * msg, gpointer user_data)
 {
   GstPlay *player = user_data;
@@ -1086,6 +2852,15 @@ static gboolean play_bus_msg (GstBus * bus, GstMessage * msg, gpointer user_data
         replay (player);
       }
       player->async_done = TRUE;
+      if (player->status == AGMP_STATUS_PLAYING)
+        play_anchor_position (player, TRUE);
+      /* flushes and rate changes start a new run */
+      g_mutex_lock (&player->progress_lock);
+      agmp_av_sync_reset (&player->av_sync);
+      g_mutex_unlock (&player->progress_lock);
+      play_probe_done (player);
+      play_rate_switch_done (player, -1);
+      play_seek_done (player);
       //notify app
       callback_to_app(player, AGMP_MESSAGE_ASYNC_DONE, player->userdata);
       break;
@@ -1094,37 +2869,20 @@ static gboolean play_bus_msg (GstBus * bus, GstMessage * msg, gpointer user_data
 
       gst_message_parse_buffering (msg, &percent);
 
-#if 0
-      if (!player->buffering)
-        gst_print ("\n");
-
-      gst_print ("%s %d%%  \r", "Buffering...", percent);
-
-      if (percent == 100) {
-        // a 100% message means buffering is done
-        if (player->buffering) {
-          player->buffering = FALSE;
-          // no state management needed for live pipelines
-          if (!player->is_live)
-            gst_element_set_state (player->playbin, player->desired_state);
-        }
-      } else {
-        // buffering...
-        if (!player->buffering) {
-          if (!player->is_live)
-            gst_element_set_state (player->playbin, GST_STATE_PAUSED);
-          player->buffering = TRUE;
-        }
-      }
-#endif
+      if (player->has_buffering_config)
+        play_buffering_policy (player, msg, percent);
 
       //notify app
       player->percent = percent;
       callback_to_app(player, AGMP_MESSAGE_BUFFERING, player->userdata);
       break;
     }
+    case GST_MESSAGE_DURATION_CHANGED:
+      play_invalidate_duration (player);
+      break;
     case GST_MESSAGE_CLOCK_LOST:{
       gst_print ("Clock lost, selecting a new one\n");
+      play_anchor_position (player, FALSE);
       gst_element_set_state (player->playbin, GST_STATE_PAUSED);
       gst_element_set_state (player->playbin, GST_STATE_PLAYING);
       break;
@@ -1182,14 +2940,18 @@ static gboolean play_bus_msg (GstBus * bus, GstMessage * msg, gpointer user_data
     case GST_MESSAGE_ERROR:{
       GError *err;
       gchar *dbg;
+      gchar *uri;
 
       // dump graph on error
       GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS (GST_BIN (player->playbin),
           GST_DEBUG_GRAPH_SHOW_ALL, "agmplayer.error");
 
       gst_message_parse_error (msg, &err, &dbg);
-      gst_printerr ("ERROR %s for %s\n", err->message,
-          player->uri);
+      g_mutex_lock (&player->uri_lock);
+      uri = g_strdup (player->uri);
+      g_mutex_unlock (&player->uri_lock);
+      gst_printerr ("ERROR %s for %s\n", err->message, uri);
+      g_free (uri);
       if (dbg != NULL)
         gst_printerr ("ERROR debug information: %s\n", dbg);
       g_clear_error (&err);
@@ -1197,6 +2959,8 @@ static gboolean play_bus_msg (GstBus * bus, GstMessage * msg, gpointer user_data
 
       // flush any other error messages from the bus and clean up
       gst_element_set_state (player->playbin, GST_STATE_NULL);
+      play_seek_reset (player);
+      play_probe_failed (player);
 
       if (player->missing != NULL && play_install_missing_plugins (player)) {
         gst_print ("New plugins installed, trying again...\n");
@@ -1339,6 +3103,37 @@ static gboolean play_bus_msg (GstBus * bus, GstMessage * msg, gpointer user_data
       }
       break;
     }
+    case GST_MESSAGE_APPLICATION:
+    {
+      if (gst_message_has_name (msg, "agmp-track-switched")) {
+        gint64 latency = -1;
+
+        gst_structure_get_int64 (gst_message_get_structure (msg), "latency", &latency);
+        gst_print ("audio track switched in %" G_GINT64_FORMAT " us\n", latency);
+        callback_to_app(player, AGMP_MESSAGE_TRACK_SWITCHED, player->userdata);
+      }
+      break;
+    }
+    case GST_MESSAGE_STREAM_START:
+    {
+      gboolean next_started;
+      gchar *uri;
+
+      g_mutex_lock (&player->uri_lock);
+      next_started = player->next_pending;
+      player->next_pending = FALSE;
+      uri = g_strdup (player->uri);
+      g_mutex_unlock (&player->uri_lock);
+
+      if (next_started) {
+        gst_print ("next item started: %s\n", uri);
+        play_invalidate_duration (player);
+        play_anchor_position (player, player->status == AGMP_STATUS_PLAYING);
+        callback_to_app(player, AGMP_MESSAGE_NEXT_ITEM_STARTED, player->userdata);
+      }
+      g_free (uri);
+      break;
+    }
     case GST_MESSAGE_STATE_CHANGED:
     {
       GstState state;
@@ -1372,6 +3167,10 @@ static gboolean play_bus_msg (GstBus * bus, GstMessage * msg, gpointer user_data
           player->status = AGMP_STATUS_PLAYING;
           set_aamp_state(player, eSTATE_PLAYING);
         }
+        play_anchor_position (player, state == GST_STATE_PLAYING);
+        play_update_progress_timer (player);
+        play_update_live_timer (player);
+        play_update_av_timer (player);
         callback_to_app(player, AGMP_MESSAGE_STATE_CHANGE, player->userdata);
       }
       break;
@@ -1441,7 +3240,7 @@ int agmp_set_video_mute(AGMP_HANDLE handle, int mute)
   return AAMP_SUCCESS;
 }
 
-/*static gchar * play_uri_get_display_name (GstPlay * play, const gchar * uri)
+static gchar * play_uri_get_display_name (GstPlay * play, const gchar * uri)
 {
   gchar *loc;
 
@@ -1457,46 +3256,177 @@ int agmp_set_video_mute(AGMP_HANDLE handle, int mute)
   return loc;
 }
 
+/* called from a streaming thread once playbin has read all data of the
+ * current item; setting the uri here makes playbin pre-roll the next item
+ * and switch to it without changing the pipeline state */
 static void play_about_to_finish (GstElement * playbin, gpointer user_data)
 {
   GstPlay *play = user_data;
-  const gchar *next_uri;
+  gchar *next_uri;
   gchar *loc;
-  guint next_idx;
 
-  if (!play->gapless)
+  if (NULL == play)
     return;
 
-  next_idx = play->cur_idx + 1;
-  if (next_idx >= play->num_uris)
+  g_mutex_lock (&play->uri_lock);
+  if (!play->gapless || play->next_uri == NULL) {
+    g_mutex_unlock (&play->uri_lock);
     return;
+  }
+
+  next_uri = play->next_uri;
+  play->next_uri = NULL;
+  play->gapless = FALSE;
+  play->next_pending = TRUE;
+  g_free ((gchar *) play->uri);
+  play->uri = next_uri;
+  g_mutex_unlock (&play->uri_lock);
 
-  next_uri = play->uri;
   loc = play_uri_get_display_name (play, next_uri);
-  gst_print ("About to finish, preparing next title: %s", loc);
-  gst_print ("\n");
+  gst_print ("About to finish, preparing next title: %s\n", loc);
   g_free (loc);
 
-  g_object_set (play->playbin, "uri", next_uri, NULL);
-  play->cur_idx = next_idx;
-}*/
+  g_object_set (playbin, "uri", next_uri, NULL);
+}
+
+static GstSeekFlags play_trick_mode_flags (GstPlayTrickMode mode)
+{
+  switch (mode) {
+    case GST_PLAY_TRICK_MODE_DEFAULT:
+      return GST_SEEK_FLAG_TRICKMODE;
+    case GST_PLAY_TRICK_MODE_DEFAULT_NO_AUDIO:
+      return GST_SEEK_FLAG_TRICKMODE | GST_SEEK_FLAG_TRICKMODE_NO_AUDIO;
+    case GST_PLAY_TRICK_MODE_KEY_UNITS:
+      return GST_SEEK_FLAG_TRICKMODE_KEY_UNITS;
+    case GST_PLAY_TRICK_MODE_KEY_UNITS_NO_AUDIO:
+      return GST_SEEK_FLAG_TRICKMODE_KEY_UNITS | GST_SEEK_FLAG_TRICKMODE_NO_AUDIO;
+    case GST_PLAY_TRICK_MODE_NONE:
+    default:
+      break;
+  }
+  return GST_SEEK_FLAG_NONE;
+}
+
+#if GST_CHECK_VERSION(1,18,0)
+/* change the rate of the running segment in place, nothing is flushed */
+static gboolean play_instant_rate_change (GstPlay * play, gdouble rate)
+{
+  GstEvent *seek;
+
+  g_rec_mutex_lock (&play->rate_lock);
+  /* trick mode flags have to match the running segment */
+  seek = gst_event_new_seek (rate, GST_FORMAT_TIME,
+      GST_SEEK_FLAG_INSTANT_RATE_CHANGE | play_trick_mode_flags (play->trick_mode),
+      GST_SEEK_TYPE_NONE, -1, GST_SEEK_TYPE_NONE, -1);
+  if (!gst_element_send_event (play->playbin, seek)) {
+    g_rec_mutex_unlock (&play->rate_lock);
+    return FALSE;
+  }
+
+  play->rate = rate;
+  g_rec_mutex_unlock (&play->rate_lock);
+  if (play->status == AGMP_STATUS_PLAYING)
+    play_anchor_position (play, TRUE);
+  return TRUE;
+}
+#endif
 
 static gboolean
 play_set_rate_and_trick_mode (GstPlay * play, gdouble rate,
     GstPlayTrickMode mode)
 {
-  gint64 pos = -1;
+  gboolean ret;
 
   g_return_val_if_fail (rate != 0, FALSE);
 
+  /* the live controller reads and nudges the rate from the dispatcher */
+  g_rec_mutex_lock (&play->rate_lock);
+  ret = play_set_rate_and_trick_mode_locked (play, rate, mode);
+  g_rec_mutex_unlock (&play->rate_lock);
+  return ret;
+}
+
+static gboolean
+play_set_rate_and_trick_mode_locked (GstPlay * play, gdouble rate,
+    GstPlayTrickMode mode)
+{
+  gint64 pos = -1;
+  gint64 start;
+  gboolean reverse_trick = FALSE;
+
+  start = g_get_monotonic_time ();
+
+  /* reverse playback steps through keyframes, demuxers can't feed anything else backwards */
+  if (rate < 0 && mode == GST_PLAY_TRICK_MODE_NONE) {
+    mode = GST_PLAY_TRICK_MODE_KEY_UNITS_NO_AUDIO;
+    reverse_trick = TRUE;
+  } else if (rate > 0 && play->reverse_trick && mode == GST_PLAY_TRICK_MODE_KEY_UNITS_NO_AUDIO) {
+    mode = GST_PLAY_TRICK_MODE_NONE;
+  } else if (rate < 0) {
+    reverse_trick = play->reverse_trick && mode == GST_PLAY_TRICK_MODE_KEY_UNITS_NO_AUDIO;
+  }
+
+#if GST_CHECK_VERSION(1,18,0)
+  /* only the speed changes: skip the flush and the preroll that comes with it */
+  if (mode == play->trick_mode && (rate > 0) == (play->rate > 0)
+      && play->async_done && play_instant_rate_change (play, rate)) {
+    play->reverse_trick = reverse_trick;
+    play_rate_switch_done (play, start);
+    return TRUE;
+  }
+#endif
+
   if (!gst_element_query_position (play->playbin, GST_FORMAT_TIME, &pos))
     return FALSE;
 
-  return play_do_seek (play, pos, rate, mode);
+  if (!play_do_seek (play, pos, rate, mode, GST_SEEK_FLAG_ACCURATE))
+    return FALSE;
+
+  play->reverse_trick = reverse_trick;
+  /* done once the pipeline prerolled again */
+  g_mutex_lock (&play->seek_lock);
+  play->rate_switch_start = start;
+  g_mutex_unlock (&play->seek_lock);
+  return TRUE;
+}
+
+/* start -1: ASYNC_DONE of a flushing rate change, if one is pending */
+static void play_rate_switch_done (GstPlay *player, gint64 start)
+{
+  gint64 latency;
+
+  g_mutex_lock (&player->seek_lock);
+  if (start < 0)
+    start = player->rate_switch_start;
+  if (start < 0) {
+    g_mutex_unlock (&player->seek_lock);
+    return;
+  }
+  latency = g_get_monotonic_time () - start;
+  player->rate_switch_start = -1;
+  player->rate_switch_latency = latency;
+  g_mutex_unlock (&player->seek_lock);
+  gst_print ("rate switch to %.2f took %" G_GINT64_FORMAT " us\n", player->rate, latency);
+}
+
+long long agmp_get_rate_switch_latency(AGMP_HANDLE handle)
+{
+  if (NULL == handle)
+  {
+    return -1;
+  }
+  GstPlay* player = (GstPlay*)handle;
+  long long latency;
+
+  g_mutex_lock (&player->seek_lock);
+  latency = player->rate_switch_latency;
+  g_mutex_unlock (&player->seek_lock);
+  return latency;
 }
 
 static gboolean
-play_do_seek (GstPlay * play, gint64 pos, gdouble rate, GstPlayTrickMode mode)
+play_do_seek (GstPlay * play, gint64 pos, gdouble rate, GstPlayTrickMode mode,
+    GstSeekFlags flags)
 {
   GstSeekFlags seek_flags;
   GstQuery *query;
@@ -1515,43 +3445,30 @@ play_do_seek (GstPlay * play, gint64 pos, gdouble rate, GstPlayTrickMode mode)
   if (!seekable)
     return FALSE;
 
-  seek_flags = GST_SEEK_FLAG_FLUSH;
-
-  switch (mode) {
-    case GST_PLAY_TRICK_MODE_DEFAULT:
-      seek_flags |= GST_SEEK_FLAG_TRICKMODE;
-      break;
-    case GST_PLAY_TRICK_MODE_DEFAULT_NO_AUDIO:
-      seek_flags |= GST_SEEK_FLAG_TRICKMODE | GST_SEEK_FLAG_TRICKMODE_NO_AUDIO;
-      break;
-    case GST_PLAY_TRICK_MODE_KEY_UNITS:
-      seek_flags |= GST_SEEK_FLAG_TRICKMODE_KEY_UNITS;
-      break;
-    case GST_PLAY_TRICK_MODE_KEY_UNITS_NO_AUDIO:
-      seek_flags |=
-          GST_SEEK_FLAG_TRICKMODE_KEY_UNITS | GST_SEEK_FLAG_TRICKMODE_NO_AUDIO;
-      break;
-    case GST_PLAY_TRICK_MODE_NONE:
-    default:
-      break;
-  }
+  seek_flags = GST_SEEK_FLAG_FLUSH | play_trick_mode_flags (mode) | flags;
 
   if (rate >= 0)
     seek = gst_event_new_seek (rate, GST_FORMAT_TIME,
-        seek_flags | GST_SEEK_FLAG_ACCURATE,
+        seek_flags,
         /* start */ GST_SEEK_TYPE_SET, pos,
         /* stop */ GST_SEEK_TYPE_SET, GST_CLOCK_TIME_NONE);
   else
     seek = gst_event_new_seek (rate, GST_FORMAT_TIME,
-        seek_flags | GST_SEEK_FLAG_ACCURATE,
+        seek_flags,
         /* start */ GST_SEEK_TYPE_SET, 0,
         /* stop */ GST_SEEK_TYPE_SET, pos);
 
-  if (!gst_element_send_event (play->playbin, seek))
+  /* position comes from queries until the seek settles */
+  play_anchor_position (play, FALSE);
+  g_rec_mutex_lock (&play->rate_lock);
+  if (!gst_element_send_event (play->playbin, seek)) {
+    g_rec_mutex_unlock (&play->rate_lock);
     return FALSE;
+  }
 
   play->rate = rate;
   play->trick_mode = mode;
+  g_rec_mutex_unlock (&play->rate_lock);
   return TRUE;
 }
 
@@ -1642,6 +3559,144 @@ play_get_nth_stream_in_collection (GstPlay * play, guint index,
   return NULL;
 }
 
+static void play_switch_cancel (GstPlay *player)
+{
+  g_mutex_lock (&player->switch_lock);
+  if (player->switch_probe_id)
+    gst_pad_remove_probe (player->switch_pad, player->switch_probe_id);
+  player->switch_probe_id = 0;
+  if (player->switch_pad)
+    gst_object_unref (player->switch_pad);
+  player->switch_pad = NULL;
+  g_free (player->switch_sid);
+  player->switch_sid = NULL;
+  g_mutex_unlock (&player->switch_lock);
+}
+
+/* old audio keeps playing until the new stream reaches the sink, new audio
+ * overlapping what was already played is dropped so it cuts over at the
+ * running time where the old stream ends */
+static GstPadProbeReturn play_switch_probe_cb (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+  GstPlay *play = user_data;
+  GstPadProbeReturn ret = GST_PAD_PROBE_OK;
+  gint64 latency = -1;
+
+  g_mutex_lock (&play->switch_lock);
+  if (!play->switch_sid) {
+    play->switch_probe_id = 0;
+    g_mutex_unlock (&play->switch_lock);
+    return GST_PAD_PROBE_REMOVE;
+  }
+
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_STREAM_START:{
+        const gchar *sid = NULL;
+
+        gst_event_parse_stream_start (event, &sid);
+        if (sid && !strcmp (sid, play->switch_sid))
+          play->switch_arrived = TRUE;
+        break;
+      }
+      case GST_EVENT_SEGMENT:
+        gst_event_copy_segment (event, &play->switch_segment);
+        break;
+      case GST_EVENT_FLUSH_STOP:
+        /* a seek came in between, nothing played before it matters */
+        play->switch_boundary = GST_CLOCK_TIME_NONE;
+        break;
+      default:
+        break;
+    }
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+    GstClockTime pts = GST_BUFFER_PTS (buf);
+    GstClockTime rt_end = GST_CLOCK_TIME_NONE;
+
+    if (GST_CLOCK_TIME_IS_VALID (pts)) {
+      if (GST_BUFFER_DURATION_IS_VALID (buf))
+        pts += GST_BUFFER_DURATION (buf);
+      rt_end = gst_segment_to_running_time (&play->switch_segment, GST_FORMAT_TIME, pts);
+    }
+
+    if (!play->switch_arrived) {
+      if (GST_CLOCK_TIME_IS_VALID (rt_end))
+        play->switch_boundary = rt_end;
+    } else if (GST_CLOCK_TIME_IS_VALID (play->switch_boundary)
+        && GST_CLOCK_TIME_IS_VALID (rt_end) && rt_end <= play->switch_boundary) {
+      ret = GST_PAD_PROBE_DROP;
+    } else {
+      latency = g_get_monotonic_time () - play->switch_start;
+      play->switch_latency = latency;
+      g_free (play->switch_sid);
+      play->switch_sid = NULL;
+      play->switch_probe_id = 0;
+      ret = GST_PAD_PROBE_REMOVE;
+    }
+  }
+  g_mutex_unlock (&play->switch_lock);
+
+  if (latency >= 0) {
+    GstStructure *st = gst_structure_new ("agmp-track-switched",
+        "latency", G_TYPE_INT64, latency, NULL);
+
+    gst_element_post_message (play->playbin,
+        gst_message_new_application (GST_OBJECT (play->playbin), st));
+  }
+  return ret;
+}
+
+static void play_switch_begin (GstPlay *play, const gchar *sid)
+{
+  GstPad *pad;
+
+  if (!play->asink)
+    return;
+  pad = gst_element_get_static_pad (play->asink, "sink");
+  if (!pad)
+    return;
+
+  play_switch_cancel (play);
+
+  g_mutex_lock (&play->switch_lock);
+  play->switch_sid = g_strdup (sid);
+  play->switch_arrived = FALSE;
+  play->switch_start = g_get_monotonic_time ();
+  play->switch_boundary = GST_CLOCK_TIME_NONE;
+  gst_segment_init (&play->switch_segment, GST_FORMAT_TIME);
+  {
+    /* buffers of the old stream are timed against its current segment */
+    GstEvent *seg = gst_pad_get_sticky_event (pad, GST_EVENT_SEGMENT, 0);
+    if (seg) {
+      gst_event_copy_segment (seg, &play->switch_segment);
+      gst_event_unref (seg);
+    }
+  }
+  play->switch_pad = pad;
+  play->switch_probe_id = gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      play_switch_probe_cb, play, NULL);
+  g_mutex_unlock (&play->switch_lock);
+}
+
+long long agmp_get_track_switch_latency(AGMP_HANDLE handle)
+{
+  if (NULL == handle)
+  {
+    return -1;
+  }
+  GstPlay* player = (GstPlay*)handle;
+  long long latency;
+
+  g_mutex_lock (&player->switch_lock);
+  latency = player->switch_latency;
+  g_mutex_unlock (&player->switch_lock);
+  return latency;
+}
+
 static void play_track_selection (GstPlay * play, GstPlayTrackType track_type, gint index)
 {
   const gchar *prop_cur, *prop_n, *prop_get, *name;
@@ -1654,6 +3709,7 @@ static void play_track_selection (GstPlay * play, GstPlayTrackType track_type, g
   gint cur_audio_idx = -1, cur_video_idx = -1, cur_text_idx = -1;
   gint nb_audio = 0, nb_video = 0, nb_text = 0;
   guint len, i;
+  gchar *switch_sid = NULL;
 
   g_mutex_lock (&play->selection_lock);
   if (play->is_playbin3) {
@@ -1779,9 +3835,13 @@ static void play_track_selection (GstPlay * play, GstPlayTrackType track_type, g
 
         stream = play_get_nth_stream_in_collection (play, index, track_type);
         if (stream) {
-          selected_streams = g_list_append (selected_streams,
-              (gchar *) gst_stream_get_stream_id (stream));
+          const gchar *sid = gst_stream_get_stream_id (stream);
+
+          selected_streams = g_list_append (selected_streams, (gchar *) sid);
           tags = gst_stream_get_tags (stream);
+          if (track_type == GST_PLAY_TRACK_TYPE_AUDIO && sid
+              && g_strcmp0 (sid, play->cur_audio_sid))
+            switch_sid = g_strdup (sid);
         } else {
           gst_print ("Collection has no stream for track %d of %d.\n",
               index + 1, n);
@@ -1813,6 +3873,9 @@ static void play_track_selection (GstPlay * play, GstPlayTrackType track_type, g
     g_mutex_unlock (&play->selection_lock);
 
     if (play->is_playbin3) {
+      /* decodebin3 switches without flushing, the probe does the cut over */
+      if (switch_sid)
+        play_switch_begin (play, switch_sid);
       if (selected_streams)
         gst_element_send_event (play->playbin,
             gst_event_new_select_streams (selected_streams));
@@ -1825,6 +3888,7 @@ static void play_track_selection (GstPlay * play, GstPlayTrackType track_type, g
 
   if (selected_streams)
     g_list_free (selected_streams);
+  g_free (switch_sid);
 }
 
 int aamp_get_media_track_num(AGMP_HANDLE handle, int* pn_video, int* pn_audio, int* pn_text)
@@ -2115,25 +4179,24 @@ static int porting_timeout (void* handle)
   if (player->buffering)
     return TRUE;
 
+  /* both are cheap now: cached duration and clock derived position */
   dur = agmp_get_duration(handle);
   pos = agmp_get_position(handle);
 
-  player->timer_cnt++;
   if (pos >= 0 && dur > 0) {
-    gchar dstr[32], pstr[32];
-
-    /* FIXME: pretty print in nicer format */
-    g_snprintf (pstr, 32, "%" GST_TIME_FORMAT, GST_TIME_ARGS (pos));
-    pstr[9] = '\0';
-    g_snprintf (dstr, 32, "%" GST_TIME_FORMAT, GST_TIME_ARGS (dur));
-    dstr[9] = '\0';
-    log_trace ("%s / %s\r", pstr, dstr);
+    if (agmp_log_enabled (LOG_TRACE, AGMP_LOG_MODULE)) {
+      gchar dstr[32], pstr[32];
+
+      /* FIXME: pretty print in nicer format */
+      g_snprintf (pstr, 32, "%" GST_TIME_FORMAT, GST_TIME_ARGS (pos));
+      pstr[9] = '\0';
+      g_snprintf (dstr, 32, "%" GST_TIME_FORMAT, GST_TIME_ARGS (dur));
+      dstr[9] = '\0';
+      log_trace ("%s / %s\r", pstr, dstr);
+    }
 
     // progress update call back
-    if (player->timer_cnt >= PROGRESS_CALLBACK_CNT) {
-      player->timer_cnt = 0;
-      callback_to_app(player, AGMP_MESSAGE_PROGRESS_UPDATE, player->userdata);
-    }
+    callback_to_app(player, AGMP_MESSAGE_PROGRESS_UPDATE, player->userdata);
   }
 
   return TRUE;
@@ -2147,5 +4210,6 @@ int aamp_register_events(AGMP_HANDLE handle, message_callback callback, void* us
 
   player->notify_app = callback;
   player->userdata = userdata;
+  play_update_progress_timer (player);
   return AAMP_SUCCESS;
 }
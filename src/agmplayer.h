@@ -42,6 +42,10 @@ typedef enum
   AGMP_PLAY_SPEED_2,
   AGMP_PLAY_SPEED_4,
   AGMP_PLAY_SPEED_8,
+  AGMP_PLAY_SPEED_REV_1,
+  AGMP_PLAY_SPEED_REV_2,
+  AGMP_PLAY_SPEED_REV_4,
+  AGMP_PLAY_SPEED_REV_8,
 } AGMP_PLAY_SPEED;
 
 typedef enum
@@ -59,6 +63,10 @@ typedef enum
   AGMP_MESSAGE_STATE_CHANGE,
   AGMP_MESSAGE_AAMP_STATE_CHANGE,//support aamp
   AGMP_MESSAGE_PROGRESS_UPDATE,
+  AGMP_MESSAGE_NEXT_ITEM_STARTED, //uri queued by agmp_queue_uri starts playing
+  AGMP_MESSAGE_TRACK_SWITCHED, //new audio track reached the sink, see agmp_get_track_switch_latency
+  AGMP_MESSAGE_SCRUB_FRAME, //a frame of a scrubbing seek is displayed
+  AGMP_MESSAGE_AV_SYNC_ALERT, //rendered a/v offset went over the bound set by agmp_set_av_sync_bound
 } AGMP_MESSAGE_TYPE;
 
 /* log */
@@ -118,12 +126,65 @@ typedef struct
   char lang[INFO_STRING_MAXLEN];
 } TextInfo;
 
+typedef enum
+{
+  AGMP_ELEMENT_VIDEO_DECODER = 0,
+  AGMP_ELEMENT_AUDIO_DECODER,
+  AGMP_ELEMENT_VIDEO_SINK,
+  AGMP_ELEMENT_AUDIO_SINK,
+  AGMP_ELEMENT_DEMUXER,
+  AGMP_ELEMENT_VIDEO_QUEUE,
+  AGMP_ELEMENT_AUDIO_QUEUE,
+} AGMP_ELEMENT_ROLE;
+
+typedef struct
+{
+  char name[INFO_STRING_MAXLEN];
+  char factory[INFO_STRING_MAXLEN];
+  int state;                      //GstState of the element
+  unsigned long long rendered;    //sinks only
+  unsigned long long dropped;     //sinks only
+  double average_rate;            //sinks only
+  unsigned int level_buffers;     //queues only
+  unsigned int level_bytes;       //queues only
+  unsigned long long level_time;  //queues only, ns
+} ElementStats;
+
+typedef struct
+{
+  long long buffer_size;                    //bytes of network buffer, -1 for default
+  long long buffer_duration;                //ns of network buffer, -1 for default
+  int download;                             //progressive download buffering into a file
+  unsigned long long ring_buffer_max_size;  //bytes of download ring buffer, 0 to disable
+  int low_percent;                          //pause playback below this level, 0 for default 10
+  int high_percent;                         //resume playback at this level, 0 for default 100
+} BufferingConfig;
+
+typedef struct
+{
+  long long offset;               //us, how much later video is rendered than audio against the clock, positive when audio leads
+  long long jitter;               //us, smoothed change of offset between samples
+  double drift;                   //ppm, rate offset changes at against the pipeline clock
+  long long max_offset;           //us, largest absolute offset since the last seek or start
+  int samples;                    //samples taken since the last seek or start, 0 when nothing is known
+} AvSyncStats;
+
 #define AGMP_HANDLE void*
 typedef void (*timeout_callback) (AGMP_HANDLE handle);
 typedef void (*message_callback) (AGMP_HANDLE handle, AGMP_MESSAGE_TYPE type, void* userdata);
 
 AGMP_HANDLE agmp_init (void);
+int agmp_set_shared_loop (int enable); //called before agmp_init: one dispatcher thread serves all handles, or set AGMP_SHARED_LOOP=1
 int agmp_set_uri(AGMP_HANDLE handle, const char* uri); //called before agmp_prepare
+int agmp_queue_uri(AGMP_HANDLE handle, const char* uri); //gapless: play uri after the current one, NULL to clear
+int agmp_set_dual_pipeline(AGMP_HANDLE handle, int enable); //fast channel switch: keep a second playbin for preload
+int agmp_preload_uri(AGMP_HANDLE handle, const char* uri); //preroll uri muted and hidden in the standby playbin
+int agmp_switch_to_preloaded(AGMP_HANDLE handle); //make the preloaded uri active, the old pipeline is dropped in background
+int agmp_register_memory_clip(const char* name, const void* data, unsigned int size); //copy data into RAM, play it as "mem://<name>"
+int agmp_register_file_clip(const char* name, const char* path); //load the file into RAM, play it as "mem://<name>"
+int agmp_unregister_clip(const char* name);
+int agmp_set_clip_cache_limit(unsigned long long bytes); //RAM held by all clips, least recently played go first, default 32MB
+int agmp_set_http_cache(const char* dir, unsigned long long max_bytes); //called after agmp_init, http resources fetched completely are replayed from dir, NULL or 0 to disable
 int agmp_set_license_url(AGMP_HANDLE handle, char* license_url); //called before agmp_prepare if need license_url
 int agmp_set_volume(AGMP_HANDLE handle, double volume);
 double agmp_get_volume(AGMP_HANDLE handle);
@@ -137,7 +198,14 @@ long long agmp_get_duration(AGMP_HANDLE handle);
 long long agmp_get_position(AGMP_HANDLE handle);
 int agmp_set_speed(AGMP_HANDLE handle, AGMP_PLAY_SPEED rate);
 int agmp_get_speed(AGMP_HANDLE handle);
+long long agmp_get_rate_switch_latency(AGMP_HANDLE handle); //us of the last agmp_set_speed until the new rate took effect, -1 if none
 int agmp_seek(AGMP_HANDLE handle, double position);
+int agmp_get_thumbnail(AGMP_HANDLE handle, double position, int w, int h, unsigned char* buffer); //RGBA w*h*4 bytes of the keyframe before position (s), blocks while decoding
+int agmp_set_scrubbing(AGMP_HANDLE handle, int enable); //while enabled agmp_seek coalesces to keyframes, disabling seeks accurately to the last position
+int agmp_set_live_latency_target(AGMP_HANDLE handle, int target_ms); //ms behind the live edge to converge on by playing at 0.95-1.05, 0 for off. set before agmp_prepare to keep audio pitch
+long long agmp_get_live_latency(AGMP_HANDLE handle); //ms behind the live edge last measured while playing live, -1 if unknown
+int agmp_get_av_sync_stats(AGMP_HANDLE handle, AvSyncStats* stats); //rendered a/v offset, jitter and drift, sampled every 200ms while playing
+int agmp_set_av_sync_bound(AGMP_HANDLE handle, int bound_ms); //AGMP_MESSAGE_AV_SYNC_ALERT when |offset| goes over it, again after it fell below half, 0 for off
 AGMP_SSTATUS agmp_get_state(AGMP_HANDLE handle);
 
 
@@ -152,8 +220,14 @@ int aamp_get_video_track_info(AGMP_HANDLE handle, int trackid, VideoInfo* video_
 int aamp_get_audio_track_info(AGMP_HANDLE handle, int trackid, AudioInfo* audio_info);
 int aamp_get_text_track_info(AGMP_HANDLE handle, int trackid, TextInfo* text_info);
 int aamp_set_audio_track(AGMP_HANDLE handle, int trackid);
+long long agmp_get_track_switch_latency(AGMP_HANDLE handle); //us from audio track request to cut over, playbin3 only, -1 if none
+int agmp_set_buffering_config(AGMP_HANDLE handle, BufferingConfig* config); //called before agmp_prepare, also enables the buffering pause policy
 int agmp_get_buffering_percent(AGMP_HANDLE handle);
+int agmp_get_element_stats(AGMP_HANDLE handle, AGMP_ELEMENT_ROLE role, ElementStats* stats);
+int agmp_set_progress_interval(AGMP_HANDLE handle, int interval_ms); //AGMP_MESSAGE_PROGRESS_UPDATE period while playing, default 1000, 0 to disable
 int agmp_set_log_level (LOG_LEVEL level);
+int agmp_set_module_log_level (const char* module, LOG_LEVEL level); //module is the tag in the log line, e.g. "AGMPlayer"
+unsigned long long agmp_get_dropped_log_count (void); //logs dropped because the logging thread's ring was full
 
 /* support aamp */
 unsigned int agmp_get_aamp_state(AGMP_HANDLE handle);
@@ -0,0 +1,240 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "agmplayer_av_sync.h"
+
+#define AV_SYNC_JITTER_GAIN 16
+#define AV_SYNC_FORGET 0.98     /* per sample, ~50 samples of memory for drift */
+#define AV_SYNC_DRIFT_MIN_SPAN 2.0 /* s of samples before drift means anything */
+
+struct _AgmpAvSyncTap
+{
+  GMutex lock;
+  GstElement *sink;
+  GstPad *pad;
+  gulong probe;
+  GstSegment segment;
+  GstClockTime rt;              /* running time of the last buffer, NONE until one came */
+  GstClockTime rt_end;          /* running time it ends at, NONE without a duration */
+  GstClockTimeDiff arrival;     /* clock running time it came at minus rt */
+};
+
+static void av_sync_tap_set_segment (AgmpAvSyncTap *tap, GstEvent *event)
+{
+  g_mutex_lock (&tap->lock);
+  if (event)
+    gst_event_copy_segment (event, &tap->segment);
+  else
+    gst_segment_init (&tap->segment, GST_FORMAT_UNDEFINED);
+  tap->rt = GST_CLOCK_TIME_NONE;
+  g_mutex_unlock (&tap->lock);
+}
+
+static GstPadProbeReturn av_sync_tap_probe (GstPad *pad, GstPadProbeInfo *info,
+    gpointer user_data)
+{
+  AgmpAvSyncTap *tap = user_data;
+  GstElement *parent;
+  GstClock *clock;
+  GstBuffer *buf;
+  GstClockTime ts, rt, now;
+
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_BOTH) {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT)
+      av_sync_tap_set_segment (tap, event);
+    else if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+      av_sync_tap_set_segment (tap, NULL);
+    return GST_PAD_PROBE_OK;
+  }
+
+  buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  ts = GST_BUFFER_PTS_IS_VALID (buf) ? GST_BUFFER_PTS (buf) : GST_BUFFER_DTS (buf);
+  parent = GST_ELEMENT_CAST (GST_PAD_PARENT (pad));
+  if (!GST_CLOCK_TIME_IS_VALID (ts) || !parent)
+    return GST_PAD_PROBE_OK;
+
+  clock = gst_element_get_clock (parent);
+  if (!clock)
+    return GST_PAD_PROBE_OK;
+  now = gst_clock_get_time (clock) - gst_element_get_base_time (parent);
+  gst_object_unref (clock);
+
+  g_mutex_lock (&tap->lock);
+  if (tap->segment.format == GST_FORMAT_TIME) {
+    rt = gst_segment_to_running_time (&tap->segment, GST_FORMAT_TIME, ts);
+    if (GST_CLOCK_TIME_IS_VALID (rt)) {
+      tap->rt = rt;
+      /* through the segment so the rate is taken into account */
+      tap->rt_end = GST_BUFFER_DURATION_IS_VALID (buf) ? gst_segment_to_running_time (&tap->segment,
+          GST_FORMAT_TIME, ts + GST_BUFFER_DURATION (buf)) : GST_CLOCK_TIME_NONE;
+      tap->arrival = GST_CLOCK_DIFF (rt, now);
+    }
+  }
+  g_mutex_unlock (&tap->lock);
+  return GST_PAD_PROBE_OK;
+}
+
+AgmpAvSyncTap *agmp_av_sync_tap_new (GstElement *sink)
+{
+  AgmpAvSyncTap *tap;
+  GstEvent *segment;
+  GstPad *pad;
+
+  pad = sink ? gst_element_get_static_pad (sink, "sink") : NULL;
+  if (!pad)
+    return NULL;
+
+  tap = g_new0 (AgmpAvSyncTap, 1);
+  g_mutex_init (&tap->lock);
+  tap->sink = gst_object_ref (sink);
+  tap->pad = pad;
+  tap->rt = GST_CLOCK_TIME_NONE;
+  gst_segment_init (&tap->segment, GST_FORMAT_UNDEFINED);
+  /* the segment is sticky, a tap added mid stream still gets to map buffers */
+  segment = gst_pad_get_sticky_event (pad, GST_EVENT_SEGMENT, 0);
+  if (segment) {
+    gst_event_copy_segment (segment, &tap->segment);
+    gst_event_unref (segment);
+  }
+  tap->probe = gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER
+      | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+      av_sync_tap_probe, tap, NULL);
+  return tap;
+}
+
+void agmp_av_sync_tap_free (AgmpAvSyncTap *tap)
+{
+  if (!tap)
+    return;
+  /* returns once a running callback is done */
+  gst_pad_remove_probe (tap->pad, tap->probe);
+  gst_object_unref (tap->pad);
+  gst_object_unref (tap->sink);
+  g_mutex_clear (&tap->lock);
+  g_free (tap);
+}
+
+gboolean agmp_av_sync_tap_is_for (AgmpAvSyncTap *tap, GstElement *sink)
+{
+  return tap && tap->sink == sink;
+}
+
+/* how much later than its time the sink shows what it has, -1 without a buffer.
+ * buffers that came early wait in the sink, the last one running out of
+ * duration means nothing new came and the sink is behind by the gap */
+static GstClockTimeDiff av_sync_tap_delay (AgmpAvSyncTap *tap, GstClockTime now,
+    GstClockTime latency)
+{
+  GstClockTimeDiff delay = -1, gap;
+
+  g_mutex_lock (&tap->lock);
+  if (GST_CLOCK_TIME_IS_VALID (tap->rt)) {
+    delay = MAX (tap->arrival - (GstClockTimeDiff) latency, 0);
+    if (GST_CLOCK_TIME_IS_VALID (tap->rt_end) && tap->rt_end > tap->rt) {
+      gap = GST_CLOCK_DIFF (tap->rt_end + latency, now);
+      delay = MAX (delay, gap);
+    }
+  }
+  g_mutex_unlock (&tap->lock);
+  return delay;
+}
+
+void agmp_av_sync_reset (AgmpAvSync *sync)
+{
+  memset (sync, 0, sizeof (*sync));
+  sync->first = GST_CLOCK_TIME_NONE;
+}
+
+static void av_sync_add (AgmpAvSync *sync, GstClockTime now, gint64 offset)
+{
+  gdouble t, span, denom;
+
+  if (sync->samples > 0) {
+    gint64 d = ABS (offset - sync->offset);
+
+    sync->jitter += (d - sync->jitter) / AV_SYNC_JITTER_GAIN;
+  } else {
+    sync->first = now;
+  }
+  sync->offset = offset;
+  if (ABS (offset) > sync->max_offset)
+    sync->max_offset = ABS (offset);
+  sync->samples++;
+
+  /* weighted least squares of offset (us) over t (s), slope in us/s is ppm */
+  t = (gdouble) (now - sync->first) / GST_SECOND;
+  sync->sum_w = sync->sum_w * AV_SYNC_FORGET + 1.0;
+  sync->sum_t = sync->sum_t * AV_SYNC_FORGET + t;
+  sync->sum_o = sync->sum_o * AV_SYNC_FORGET + offset;
+  sync->sum_tt = sync->sum_tt * AV_SYNC_FORGET + t * t;
+  sync->sum_to = sync->sum_to * AV_SYNC_FORGET + t * offset;
+
+  span = t;
+  denom = sync->sum_w * sync->sum_tt - sync->sum_t * sync->sum_t;
+  if (span >= AV_SYNC_DRIFT_MIN_SPAN && denom > 0)
+    sync->drift = (sync->sum_w * sync->sum_to - sync->sum_t * sync->sum_o) / denom;
+}
+
+gboolean agmp_av_sync_sample (AgmpAvSync *sync, GstElement *pipeline,
+    AgmpAvSyncTap *vtap, AgmpAvSyncTap *atap)
+{
+  GstClock *clock;
+  GstClockTime now, latency = 0;
+  GstClockTimeDiff vdelay, adelay;
+
+  if (!vtap || !atap || GST_STATE (pipeline) != GST_STATE_PLAYING)
+    return FALSE;
+
+  clock = gst_element_get_clock (pipeline);
+  if (!clock)
+    return FALSE;
+  now = gst_clock_get_time (clock);
+  gst_object_unref (clock);
+
+  /* both sinks render latency after the running time of a buffer */
+  if (GST_IS_PIPELINE (pipeline))
+    latency = gst_pipeline_get_latency (GST_PIPELINE (pipeline));
+  if (!GST_CLOCK_TIME_IS_VALID (latency))
+    latency = 0;
+
+  vdelay = av_sync_tap_delay (vtap, now - gst_element_get_base_time (pipeline), latency);
+  adelay = av_sync_tap_delay (atap, now - gst_element_get_base_time (pipeline), latency);
+  if (vdelay < 0 || adelay < 0)
+    return FALSE;
+
+  /* video shown late means audio leads */
+  av_sync_add (sync, now, (vdelay - adelay) / GST_USECOND);
+  return TRUE;
+}
+
+gboolean agmp_av_sync_check_bound (AgmpAvSync *sync, gint64 bound_us)
+{
+  gint64 offset = ABS (sync->offset);
+
+  if (bound_us <= 0 || sync->samples == 0)
+    return FALSE;
+
+  if (!sync->alerted && offset > bound_us) {
+    sync->alerted = TRUE;
+    return TRUE;
+  }
+  if (sync->alerted && offset < bound_us / 2)
+    sync->alerted = FALSE;
+  return FALSE;
+}
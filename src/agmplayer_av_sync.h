@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __AGMPLAYER_AV_SYNC_H__
+#define __AGMPLAYER_AV_SYNC_H__
+
+#include <gst/gst.h>
+
+/*
+ * a/v alignment as rendered. a synced sink holds early buffers until their
+ * running time comes up on the clock, so the streams only drift apart on
+ * screen when buffers reach their sink after that time, or stop coming.
+ * a tap on each sink pad records how late the last buffer arrived against
+ * the clock, offset is that delay of video minus the one of audio.
+ * position queries can't tell this, in PLAYING both answer from the clock.
+ * jitter is the smoothed change of offset between samples (rfc 3550 style),
+ * drift the least squares slope of offset against the clock with older
+ * samples slowly forgotten.
+ */
+typedef struct
+{
+  gint64 offset;                /* us, positive when audio leads */
+  gint64 jitter;                /* us */
+  gdouble drift;                /* ppm */
+  gint64 max_offset;            /* us, largest |offset| of this run */
+  guint samples;
+  gboolean alerted;             /* |offset| went over the bound and didn't come back yet */
+
+  /* private */
+  GstClockTime first;
+  gdouble sum_w, sum_t, sum_o, sum_tt, sum_to;
+} AgmpAvSync;
+
+/* what one sink was given to render, fed from a probe on its sink pad */
+typedef struct _AgmpAvSyncTap AgmpAvSyncTap;
+
+/* linked into both libAGMPlayer and libAGMPlayerEs, so none of these are exported */
+
+/* NULL if sink has no sink pad */
+G_GNUC_INTERNAL AgmpAvSyncTap *agmp_av_sync_tap_new (GstElement *sink);
+G_GNUC_INTERNAL void agmp_av_sync_tap_free (AgmpAvSyncTap *tap);
+/* TRUE if tap watches sink */
+G_GNUC_INTERNAL gboolean agmp_av_sync_tap_is_for (AgmpAvSyncTap *tap, GstElement *sink);
+
+/* start a new run, after flushes, seeks and rate changes */
+G_GNUC_INTERNAL void agmp_av_sync_reset (AgmpAvSync *sync);
+/* FALSE if either sink didn't get a buffer of the running segment yet */
+G_GNUC_INTERNAL gboolean agmp_av_sync_sample (AgmpAvSync *sync, GstElement *pipeline,
+    AgmpAvSyncTap *vtap, AgmpAvSyncTap *atap);
+/* TRUE once when |offset| goes over bound_us, again only after it fell below half of it */
+G_GNUC_INTERNAL gboolean agmp_av_sync_check_bound (AgmpAvSync *sync, gint64 bound_us);
+
+#endif /* __AGMPLAYER_AV_SYNC_H__ */
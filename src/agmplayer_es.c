@@ -27,6 +27,7 @@
 #include "agmplayer_es.h"
 // #include "agmplayer_es_secure.h"
 #include "agmplayer_es_video_color_metadata_internal.h"
+#include "agmplayer_av_sync.h"
 
 GST_DEBUG_CATEGORY(agmp_es_debug);
 #define GST_CAT_DEFAULT agmp_es_debug
@@ -44,16 +45,28 @@ GST_DEBUG_CATEGORY(agmp_es_debug);
 #define AGMP_ES_MAX_VID_BUF_TIME 2000              // ms
 #define AGMP_ES_MAX_AUD_BUF_TIME 1000              // ms
 #define AGMP_ES_DEFAULT_STATUS_UPDATE_INTERVAL 200 // ms
+#define AGMP_ES_DEFAULT_RETENTION_WINDOW 0         // ms
+#define AGMP_ES_DEFAULT_LATENCY_TARGET 100         // ms
+#define AGMP_ES_LOW_LATENCY_MAX_LATENESS 20        // ms
+#define AGMP_ES_LATE_ANCHOR_INTERVAL 500           // ms
+#define AGMP_ES_DEFAULT_AV_SYNC_BOUND 0            // ms
+#define AGMP_ES_SUSPEND_CHECK_INTERVAL 100         // ms
+#define AGMP_ES_RETAIN_KEY_NUM 32 // keyframe pts kept when samples are not retained
 
 #define AGMP_ES_DEFAULT_PIP_MODE FALSE
 #define AGMP_ES_DEFAULT_SERIAL_DATA_MODE TRUE
+#define AGMP_ES_DEFAULT_LOW_LATENCY_MODE FALSE
+
+#define AGMP_ES_LATENCY_STAMPS 64 // write time of latest vid samples kept for latency measuring
 
 #define GST_CAPS_FEATURE_SECURE_TS "secure:AesEnc"
 #define GST_CAPS_FEATURE_MEMORY_SECMEM_MEMORY "memory:SecMem"
 #define GST_CAPS_FEATURE_MEMORY_DMABUF "memory:DMABuf"
 
-static GstClockTime _start_time = 0;
-#define GST_TRACER_TS GST_CLOCK_DIFF(_start_time, gst_util_get_timestamp())
+#define GST_TRACER_TS(ctxt) GST_CLOCK_DIFF((ctxt)->start_time, gst_util_get_timestamp())
+#define GST_TRACER_TS_US(ctxt) (GST_TRACER_TS(ctxt) / GST_USECOND)
+
+#define AGMP_ES_BUS_FAST_PATH_QUARK g_quark_from_static_string("agmp-es-bus-fast-path") // set on msgs handled by bus sync cb
 
 #define AGMP_ASSERT_FAIL_DO(expr, fail_do, message) \
     G_STMT_START                                    \
@@ -79,6 +92,7 @@ typedef struct _AgmpEsAudPath AgmpEsAudPath;
 typedef struct _AgmpEsDataControl AgmpEsDataControl;
 typedef struct _AgmpMonitorData AgmpMonitorData;
 typedef struct _AgmpMsgString AgmpMsgString;
+typedef struct _AgmpEsLatencyStamp AgmpEsLatencyStamp;
 typedef enum _AgmpEsMonitorType AgmpEsMonitorType;
 typedef enum _AgmpEsDataStatus AgmpEsDataStatus;
 
@@ -95,6 +109,12 @@ enum _AgmpEsDataStatus
     AGMP_ES_DATA_BUFFERING_DONE,
 };
 
+struct _AgmpEsLatencyStamp
+{
+    GstClockTime ts;    // sample timestamp
+    gint64 write_time;  // us, monotonic time the sample was written by upper layer
+};
+
 struct _AgmpEsVidPath
 {
     gboolean exist;
@@ -114,8 +134,13 @@ struct _AgmpEsVidPath
     GstElement *parser;
     GstElement *sec_parser;
     GstElement *decoder;
+    GstElement *converter; // only for s/w decoder
+    GstElement *scaler;    // only for s/w decoder, downscales to display window
+    GstElement *scale_filter;
     GstElement *sink;
 
+    gboolean sw_decode; // fall back to s/w decoder
+
 #if 0
     AgmpEsSecCtxt *sec_ctxt;
 #endif
@@ -131,6 +156,24 @@ struct _AgmpEsVidPath
     guint dropped_frame_num;
 
     gint data_waiting; // used for serial data mode
+
+    /* retention window */
+    GQueue retained;        // pushed bufs in push order, always starts from a keyframe
+    GstClockTime resume_ts; // last ts replayed by latest seek. GST_CLOCK_TIME_NONE if seek flushed all data
+    GstClockTime key_ts[AGMP_ES_RETAIN_KEY_NUM]; // pts of latest keyframes pushed, oldest first. only kept while bufs are not retained
+    guint key_ts_num;
+
+    /* key unit seek */
+    gulong snap_probe_id;
+    gboolean snap_pending; // segment after seek is held until the first buf decides where to snap
+    GstSegment snap_segment;
+
+    /* low latency */
+    gboolean catching_up;  // late frame met, dropping frames at ingest until next keyframe in time
+    guint late_frame_num;  // frames dropped at ingest for being late
+    gulong latency_probe_id;
+    AgmpEsLatencyStamp stamps[AGMP_ES_LATENCY_STAMPS];
+    guint stamp_idx;
 };
 
 struct _AgmpEsAudPath
@@ -161,6 +204,18 @@ struct _AgmpEsAudPath
     GstClockTime max_ts;      // max timestamp appsrc-video received after init playback or seek
 
     gint data_waiting; // used for serial data mode
+
+    /* retention window */
+    GQueue retained;        // pushed bufs in push order
+    GstClockTime resume_ts; // last ts replayed by latest seek. GST_CLOCK_TIME_NONE if seek flushed all data
+
+    /* key unit seek */
+    gulong snap_probe_id;
+    gboolean snap_pending; // segment after seek is held until the first buf decides where to snap
+    GstSegment snap_segment;
+
+    /* low latency */
+    guint late_frame_num; // samples dropped at ingest for being late
 };
 
 struct _AgmpEsDataControl
@@ -183,6 +238,7 @@ struct _AgmpEsCtxt
 {
     /* state */
     AgmpEsStateType state;
+    GRecMutex state_lock; // transitions come from the app thread and the bus sync handler
 
     /* pipeline context */
     GstElement *pipeline;
@@ -190,6 +246,7 @@ struct _AgmpEsCtxt
     GMainLoop *main_loop;
     GMainContext *main_loop_context;
     GThread *msg_thread;
+    GstClockTime start_time; // base of GST_TRACER_TS, msg and seek info timestamps of this instance
 
     /* data control */
     GThread *data_ctl_thread;
@@ -204,6 +261,7 @@ struct _AgmpEsCtxt
 
     /* cfgs */
     AgmpEsCommonCfg common_cfgs;
+    AgmpEsExtCfg ext_cfgs;
 
     /* A/V path context */
     AgmpEsVidPath v_path;
@@ -221,6 +279,35 @@ struct _AgmpEsCtxt
 
     /* seek */
     GstClockTime seek_to_pos;
+    GMutex retain_lock; // protect retained bufs of both paths
+    AgmpEsSeekMode seek_mode;
+    AgmpSeekInfo seek_info;
+    GstPad *seek_probe_pad; // pad watched for the first decoded output after seek
+    gulong seek_probe_id;
+    GMutex snap_lock;
+    guint32 snap_seqnum;   // bumped by every seek, a snap decided for an older seek is not applied
+    gboolean snap_decided; // video met its first keyframe or eos after seek
+    GstClockTime snap_ts;  // segment start both paths snap to. GST_CLOCK_TIME_NONE to keep seek position
+    gulong snap_hold_id;   // blocking probe holding aud bufs until video decides
+
+    /* suspend */
+    gint suspended;           // decoders and sinks released, pipeline kept in READY
+    GMutex write_lock;        // serializes writes, play, pause, seek and rate with suspend and resume
+    GstClockTime suspend_pos; // position to re-preroll at on resume
+
+    /* low latency, all in us */
+    GMutex latency_lock;
+    gint64 latency;     // latest rendered vid frame, -1 if not measured yet
+    gint64 avg_latency;
+    gint64 max_latency;
+    GstClockTime late_anchor_pos;   // position queried for late checks, extrapolated in between
+    GstClockTime late_anchor_clock; // clock time of late_anchor_pos, GST_CLOCK_TIME_NONE when invalid
+
+    /* a/v sync */
+    GMutex av_sync_lock;
+    AgmpAvSync av_sync;
+    AgmpAvSyncTap *av_vtap; // what the sinks were given, created on the first sample
+    AgmpAvSyncTap *av_atap;
 };
 
 struct _AgmpMsgString
@@ -247,6 +334,8 @@ static AgmpMsgString messages[] = {
     {AGMP_MSG_ERROR_DEC, "error dec"},
     {AGMP_MSG_ERROR_CAP_CHG, "error cap chg"},
 
+    {AGMP_MSG_AV_SYNC_ALERT, "av sync alert"},
+
     {0, NULL}};
 
 static gboolean agmp_es_gsource_dispatch(GSource *source, GSourceFunc callback, gpointer usr_data)
@@ -288,17 +377,24 @@ static void _agmp_es_init_cfgs(AgmpEsCtxt *ctxt);
 static void _agmp_es_init_common_cfgs(AgmpEsCommonCfg *common_cfgs);
 static void _agmp_es_init_vid_cfgs(AgmpEsVidCfg *vid_cfgs);
 static void _agmp_es_init_aud_cfgs(AgmpEsAudCfg *aud_cfgs);
+static void _agmp_es_init_ext_cfgs(AgmpEsExtCfg *ext_cfgs);
 
 static gboolean _agmp_es_update_cfgs(AgmpEsCtxt *ctxt, AgmpEsCfg *cfgs, gboolean *updated);
 static gboolean _agmp_es_update_common_cfgs(AgmpEsCommonCfg *dst, AgmpEsCommonCfg *src, gboolean *updated);
 static gboolean _agmp_es_update_vid_cfgs(AgmpEsVidCfg *dst, AgmpEsVidCfg *src, gboolean *updated);
 static gboolean _agmp_es_update_aud_cfgs(AgmpEsAudCfg *dst, AgmpEsAudCfg *src, gboolean *updated);
+static gboolean _agmp_es_update_ext_cfgs(AgmpEsExtCfg *dst, AgmpEsExtCfg *src, gboolean *updated);
 
 static gboolean _agmp_es_create_paths(AgmpEsCtxt *ctxt);
 static gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt);
 static gboolean _agmp_es_create_apath(AgmpEsCtxt *ctxt);
+static GstAllocator *_agmp_es_create_sec_allocator(AgmpEsCtxt *ctxt);
 static gboolean _agmp_es_create_vcaps(AgmpEsCtxt *ctxt);
+static GstElement *_agmp_es_make_vdec(AgmpEsCtxt *ctxt, const gchar *hw_name, const gchar *sw_name);
+static void _agmp_es_config_sw_vdec(AgmpEsCtxt *ctxt, GstElement *decoder);
+static void _agmp_es_update_sw_scale(AgmpEsCtxt *ctxt);
 static gboolean _agmp_es_create_acaps(AgmpEsCtxt *ctxt);
+static gboolean _agmp_es_sink_accept_caps(GstElement *sink, GstCaps *caps, gboolean all);
 
 static gboolean _agmp_es_start_msg_thread(AgmpEsCtxt *ctxt);
 static gboolean _agmp_es_start_data_ctl_thread(AgmpEsCtxt *ctxt);
@@ -306,17 +402,22 @@ static gpointer _agmp_es_msg_thread_func(gpointer data);
 static gpointer _agmp_es_data_ctl_thread_func(gpointer data);
 
 static gboolean _agmp_es_bus_cb(GstBus *bus, GstMessage *message, gpointer user_data);
+static GstBusSyncReply _agmp_es_bus_sync_cb(GstBus *bus, GstMessage *message, gpointer user_data);
+static gboolean _agmp_es_handle_error(AgmpEsCtxt *ctxt, GstMessage *message);
+static gboolean _agmp_es_handle_async_done(AgmpEsCtxt *ctxt);
 
 static gboolean _agmp_dispatch_data_msg(AgmpEsCtxt *ctxt, AgmpMsgType msg_type, AgmpEsType es_type, void *data_ptr);
 static gboolean _agmp_dispatch_state_msg(AgmpEsCtxt *ctxt, AgmpMsgType msg_type);
 static gboolean _agmp_dispatch_status_msg(AgmpEsCtxt *ctxt, AgmpMsgType msg_type);
 static gboolean _agmp_dispatch_error_msg(AgmpEsCtxt *ctxt, AgmpMsgType msg_type);
+static gboolean _agmp_dispatch_alert_msg(AgmpEsCtxt *ctxt, AgmpMsgType msg_type);
 static gboolean _agmp_dispatch_msg_uncheck(AgmpEsCtxt *ctxt, AgmpMsgType msg_type);
 static gboolean _agmp_dispatch_msg_on_mainloop(AgmpEsCtxt *ctxt, AgmpMsg *msg);
 
 static gboolean _agmp_es_gsource_cb(gpointer msg);
 
 static gboolean _agmp_es_set_state(AgmpEsCtxt *ctxt, AgmpEsStateType state);
+static AgmpEsStateType _agmp_es_get_state(AgmpEsCtxt *ctxt);
 static gboolean _agmp_es_set_pipeline_state(AgmpEsCtxt *ctxt, GstState state);
 
 static gboolean _agmp_es_write_v(AgmpEsCtxt *ctxt, AgmpDataInfo *data_info);
@@ -345,8 +446,36 @@ static gboolean _agmp_es_monitor_cb(AgmpMonitorData *monitor_data);
 
 static AgmpEsDataStatus _agmp_es_data_status(AgmpEsCtxt *ctxt, AgmpEsType type);
 static void _agmp_es_data_clear_status(AgmpEsCtxt *ctxt);
+static void _agmp_es_av_sync_sample(AgmpEsCtxt *ctxt);
 
 static GstClockTime _agmp_es_get_position(AgmpEsCtxt *ctxt);
+static void _agmp_es_lock_elements(AgmpEsCtxt *ctxt, gboolean lock);
+
+static void _agmp_es_push_buf(AgmpEsCtxt *ctxt, AgmpEsType type, GstBuffer *buf);
+static void _agmp_es_retain_buf(AgmpEsCtxt *ctxt, AgmpEsType type, GstBuffer *buf);
+static void _agmp_es_retain_clear(AgmpEsCtxt *ctxt);
+static gboolean _agmp_es_retain_lookup(AgmpEsCtxt *ctxt, GstClockTime pos, GList **v_start, GList **a_start);
+static GstClockTime _agmp_es_retain_key_before(AgmpEsCtxt *ctxt, GstClockTime pos);
+static gboolean _agmp_es_seek(AgmpEsCtxt *ctxt, double rate, int64_t pos);
+static void _agmp_es_retain_replay(AgmpEsCtxt *ctxt, GList *v_start, GList *a_start);
+
+static void _agmp_es_seek_watch_output(AgmpEsCtxt *ctxt);
+static GstPadProbeReturn _agmp_es_seek_output_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static void _agmp_es_snap_prepare(AgmpEsCtxt *ctxt);
+static GstPadProbeReturn _agmp_es_snap_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static GstPadProbeReturn _agmp_es_snap_hold_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static void _agmp_es_snap_decide(AgmpEsCtxt *ctxt, GstPad *v_pad, GstClockTime ts);
+static void _agmp_es_snap_push_segment(GstPad *pad, GstSegment *segment, GstClockTime snap_ts);
+
+static void _agmp_es_low_latency_config(AgmpEsCtxt *ctxt);
+static void _agmp_es_low_latency_config_src(AgmpEsCtxt *ctxt, GstElement *src);
+static void _agmp_es_low_latency_config_sink(AgmpEsCtxt *ctxt, GstElement *sink);
+static gboolean _agmp_es_drop_late(AgmpEsCtxt *ctxt, AgmpDataInfo *data_info);
+static GstClockTime _agmp_es_late_position(AgmpEsCtxt *ctxt);
+static void _agmp_es_late_anchor_reset(AgmpEsCtxt *ctxt);
+static void _agmp_es_latency_stamp(AgmpEsCtxt *ctxt, GstClockTime ts);
+static void _agmp_es_latency_reset(AgmpEsCtxt *ctxt);
+static GstPadProbeReturn _agmp_es_latency_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
 
 static inline AgmpEsType _agmp_es_appsrc_media_type(AgmpEsCtxt *ctxt, GstAppSrc *src);
 static inline gboolean _agmp_es_data_has_enough(AgmpEsCtxt *ctxt);
@@ -362,6 +491,11 @@ static inline gboolean _agmp_es_is_state_msg(AgmpMsgType type);
 
 /* global function definition */
 AGMP_ES_HANDLE agmp_es_create(AgmpEsCfg *cfg)
+{
+    return agmp_es_create_ext(cfg, NULL);
+}
+
+AGMP_ES_HANDLE agmp_es_create_ext(AgmpEsCfg *cfg, AgmpEsExtCfg *ext_cfg)
 {
     AgmpEsCtxt *ctxt;
 
@@ -370,6 +504,9 @@ AGMP_ES_HANDLE agmp_es_create(AgmpEsCfg *cfg)
     AGMP_ASSERT_FAIL_GOTO(cfg, errors, "invalid input cfgs.");
     AGMP_ASSERT_FAIL_GOTO((ctxt = _agmp_es_init()), errors, "init failed.");
     AGMP_ASSERT_FAIL_GOTO(_agmp_es_update_cfgs(ctxt, cfg, NULL), errors, "update cfgs failed.");
+    if (ext_cfg)
+        AGMP_ASSERT_FAIL_GOTO(_agmp_es_update_ext_cfgs(&ctxt->ext_cfgs, ext_cfg, NULL), errors, "update ext cfgs failed.");
+    _agmp_es_low_latency_config(ctxt);
     AGMP_ASSERT_FAIL_GOTO(_agmp_es_create_paths(ctxt), errors, "create paths failed.");
     AGMP_ASSERT_FAIL_GOTO(_agmp_es_set_pipeline_state(ctxt, GST_STATE_READY), errors, "chg pipeline state failed."); // change pip state in main thread not in msg thread
     AGMP_ASSERT_FAIL_GOTO(_agmp_es_start_msg_thread(ctxt), errors, "start msg thread failed.");
@@ -430,6 +567,32 @@ BOOL agmp_es_acquire_cfgs(AGMP_ES_HANDLE handle, AgmpEsCfg *cfg)
     return TRUE;
 }
 
+BOOL agmp_es_acquire_ext_cfgs(AGMP_ES_HANDLE handle, AgmpEsExtCfg *ext_cfg)
+{
+    /*
+        don't print gst log in this func
+        because it called before debug category obj init
+    */
+
+    AgmpEsExtCfg cfg;
+    uint32_t size;
+
+    AGMP_ASSERT_FAIL_RET(ext_cfg && ext_cfg->size >= sizeof(ext_cfg->size), FALSE, "invalid input ext cfgs, size not set");
+
+    size = MIN(ext_cfg->size, sizeof(AgmpEsExtCfg));
+
+    if (handle)
+        memcpy(&cfg, &((AgmpEsCtxt *)handle)->ext_cfgs, sizeof(AgmpEsExtCfg));
+    else
+        _agmp_es_init_ext_cfgs(&cfg);
+
+    // only fill the fields upper layer knows about
+    cfg.size = size;
+    memcpy(ext_cfg, &cfg, size);
+
+    return TRUE;
+}
+
 BOOL agmp_es_start(AGMP_ES_HANDLE handle)
 {
     AgmpEsCtxt *ctxt;
@@ -440,7 +603,7 @@ BOOL agmp_es_start(AGMP_ES_HANDLE handle)
     ctxt = (AgmpEsCtxt *)handle;
     ret = TRUE;
 
-    AGMP_ASSERT_FAIL_RET(AGMP_ES_STATE_INIT == ctxt->state, FALSE, "should call this interface in state:AGMP_ES_STATE_INIT");
+    AGMP_ASSERT_FAIL_RET(AGMP_ES_STATE_INIT == _agmp_es_get_state(ctxt), FALSE, "should call this interface in state:AGMP_ES_STATE_INIT");
 
     ctxt->seek_to_pos = 0; // play from 0 by default
 
@@ -448,7 +611,7 @@ BOOL agmp_es_start(AGMP_ES_HANDLE handle)
 
     ret &= _agmp_es_set_pipeline_state(ctxt, GST_STATE_PAUSED);
 
-    if (GST_STATE_PAUSED == GST_STATE(ctxt->pipeline) && !ctxt->wait_preroll)
+    if (GST_STATE_PAUSED == GST_STATE(ctxt->pipeline) && !g_atomic_int_get(&ctxt->wait_preroll))
     {
         GST_DEBUG("pipeline has been synchronously switched to the pause state");
         ret &= _agmp_es_set_state(ctxt, AGMP_ES_STATE_PRESENT);
@@ -511,6 +674,7 @@ BOOL agmp_es_update_format(AGMP_ES_HANDLE handle, AgmpFormatInfo *info)
         {
             AGMP_ASSERT_FAIL_RET(_agmp_es_create_vcaps(ctxt), FALSE, "create new vcaps error");
             gst_app_src_set_caps(GST_APP_SRC(ctxt->v_path.src), ctxt->v_path.caps);
+            _agmp_es_update_sw_scale(ctxt);
         }
     }
     else if (AGMP_AUD == info->type)
@@ -541,7 +705,15 @@ BOOL agmp_es_write(AGMP_ES_HANDLE handle, AgmpDataInfo *data_info)
 
     ctxt = (AgmpEsCtxt *)handle;
 
-    if (AGMP_VID == data_info->type)
+    /* suspend must not release the secure allocator under a sample being written */
+    g_mutex_lock(&ctxt->write_lock);
+    if (g_atomic_int_get(&ctxt->suspended))
+    {
+        GST_WARNING("agmp-es suspended, release %s sample %" GST_TIME_FORMAT, AGMP_AUD == data_info->type ? "aud" : "vid", GST_TIME_ARGS(data_info->timestamp));
+        _agmp_dispatch_data_msg(ctxt, AGMP_MSG_DATA_RELEASE, data_info->type, data_info->usr_data);
+        ret = FALSE;
+    }
+    else if (AGMP_VID == data_info->type)
         ret = _agmp_es_write_v(ctxt, data_info);
     else if (AGMP_AUD == data_info->type)
         ret = _agmp_es_write_a(ctxt, data_info);
@@ -550,6 +722,7 @@ BOOL agmp_es_write(AGMP_ES_HANDLE handle, AgmpDataInfo *data_info)
         GST_ERROR("meet wrong type");
         ret = FALSE;
     }
+    g_mutex_unlock(&ctxt->write_lock);
 
     _agmp_es_free_data_info(ctxt, data_info);
     GST_TRACE("trace out ret bool:%d", ret);
@@ -564,39 +737,272 @@ BOOL agmp_es_seek(AGMP_ES_HANDLE handle, double rate, int64_t pos)
     GST_TRACE("trace in");
 
     ctxt = (AgmpEsCtxt *)handle;
+
+    /* elements are torn down while suspended, resume re-prerolls at the latest seek position instead */
+    g_mutex_lock(&ctxt->write_lock);
+    if (g_atomic_int_get(&ctxt->suspended))
+    {
+        GST_INFO("suspended, seek to %lld(ms) with rate:%f is applied on resume", (long long)pos, rate);
+        ctxt->suspend_pos = pos * GST_MSECOND;
+        ctxt->play_rate = rate;
+        ret = TRUE;
+    }
+    else
+        ret = _agmp_es_seek(ctxt, rate, pos);
+    g_mutex_unlock(&ctxt->write_lock);
+
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+}
+
+gboolean _agmp_es_seek(AgmpEsCtxt *ctxt, double rate, int64_t pos)
+{
+    GList *v_start;
+    GList *a_start;
+    gboolean in_window;
+    GstSeekFlags flags;
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    v_start = a_start = NULL;
     ret = TRUE;
 
-    GST_INFO("seek to pos %" GST_TIME_FORMAT " with rate:%f(old rate:%f)", GST_TIME_ARGS(pos * GST_MSECOND), rate, ctxt->play_rate);
+    GST_INFO("seek to pos %" GST_TIME_FORMAT " with rate:%f(old rate:%f) mode:%d", GST_TIME_ARGS(pos * GST_MSECOND), rate, ctxt->play_rate, ctxt->seek_mode);
+
+    ctxt->seek_info.seek_count++;
+    ctxt->seek_info.seek_time = GST_TRACER_TS_US(ctxt);
+    ctxt->seek_info.flush_done_time = -1;
+    ctxt->seek_info.first_push_time = -1;
+    ctxt->seek_info.first_decoded_time = -1;
+    ctxt->seek_info.present_time = -1;
+
     ctxt->seek_to_pos = pos * GST_MSECOND;
     if (rate != ctxt->play_rate)
         ctxt->play_rate = rate;
 
+    /*
+        hold retain lock until replay done, so that no new sample
+        is pushed between flushing appsrc queue and replaying retained samples
+    */
+    g_mutex_lock(&ctxt->retain_lock);
+    in_window = _agmp_es_retain_lookup(ctxt, ctxt->seek_to_pos, &v_start, &a_start);
+    if (in_window)
+        GST_INFO("seek pos is inside retention window. replay retained samples instead of flushing all data");
+    else
+        _agmp_es_retain_clear(ctxt);
+
     _agmp_es_data_clear_status(ctxt);
 
-    /* only video need preroll */
+    /*
+        enter preroll before the seek, replayed samples can preroll the pipeline
+        and post async done on a streaming thread before the seek call returns.
+        only video need preroll
+    */
     if (ctxt->v_path.exist)
-        ctxt->wait_preroll = TRUE;
+        g_atomic_int_set(&ctxt->wait_preroll, TRUE);
+    _agmp_es_set_state(ctxt, AGMP_ES_STATE_PREROLL_AFTER_SEEK);
+
+    _agmp_es_snap_prepare(ctxt);
+
+    if (AGMP_SEEK_MODE_KEY_UNIT_SNAP_BEFORE == ctxt->seek_mode)
+        flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_BEFORE;
+    else
+        flags = GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE;
 
     if (!gst_element_seek(ctxt->pipeline, ctxt->play_rate, GST_FORMAT_TIME,
-                          (GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE),
+                          flags,
                           GST_SEEK_TYPE_SET,
                           ctxt->seek_to_pos,
                           GST_SEEK_TYPE_NONE, 0))
     {
         GST_ERROR("send seek event failed.");
+        _agmp_es_retain_clear(ctxt);
+        g_mutex_unlock(&ctxt->retain_lock);
         ret = FALSE;
         goto done;
     }
 
+    ctxt->seek_info.flush_done_time = GST_TRACER_TS_US(ctxt);
+    _agmp_es_seek_watch_output(ctxt);
+
+    /* appsrc queues are flushed synchronously during seek, it's safe to replay now */
+    if (in_window)
+    {
+        _agmp_es_retain_replay(ctxt, v_start, a_start);
+        ctxt->seek_info.first_push_time = GST_TRACER_TS_US(ctxt);
+    }
+    g_mutex_unlock(&ctxt->retain_lock);
+
     GST_INFO("send seek event succ.");
     // ctxt->paused_internal = TRUE;
-    _agmp_es_set_state(ctxt, AGMP_ES_STATE_PREROLL_AFTER_SEEK);
 
 done:
     GST_TRACE("trace out ret bool:%d", ret);
     return ret;
 }
 
+int64_t agmp_es_get_resume_timestamp(AGMP_ES_HANDLE handle, AgmpEsType type)
+{
+    AgmpEsCtxt *ctxt;
+    GstClockTime ts;
+
+    GST_TRACE("trace in");
+
+    ctxt = (AgmpEsCtxt *)handle;
+    ts = GST_CLOCK_TIME_NONE;
+
+    g_mutex_lock(&ctxt->retain_lock);
+    if (AGMP_VID == type)
+        ts = ctxt->v_path.resume_ts;
+    else if (AGMP_AUD == type)
+        ts = ctxt->a_path.resume_ts;
+    else
+        GST_ERROR("can't find stream path for this type:%d", type);
+    g_mutex_unlock(&ctxt->retain_lock);
+
+    GST_TRACE("trace out ret int64:%lld (GstClockTime:%" GST_TIME_FORMAT ")", (gint64)ts, GST_TIME_ARGS(ts));
+    return GST_CLOCK_TIME_IS_VALID(ts) ? (int64_t)ts : -1;
+}
+
+BOOL agmp_es_set_seek_mode(AGMP_ES_HANDLE handle, AgmpEsSeekMode mode)
+{
+    AgmpEsCtxt *ctxt;
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    ctxt = (AgmpEsCtxt *)handle;
+    ret = TRUE;
+
+    if (AGMP_SEEK_MODE_ACCURATE != mode && AGMP_SEEK_MODE_KEY_UNIT_SNAP_BEFORE != mode)
+    {
+        GST_ERROR("invalid seek mode:%d", mode);
+        ret = FALSE;
+        goto done;
+    }
+
+    GST_INFO("change seek mode from %d to %d", ctxt->seek_mode, mode);
+    ctxt->seek_mode = mode;
+
+done:
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+}
+
+BOOL agmp_es_suspend(AGMP_ES_HANDLE handle)
+{
+    AgmpEsCtxt *ctxt;
+    AgmpEsStateType state;
+    GstClockTime pos;
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    ctxt = (AgmpEsCtxt *)handle;
+    ret = TRUE;
+
+    /* waits for the write in flight, no sample uses the secure allocator after this */
+    g_mutex_lock(&ctxt->write_lock);
+    if (g_atomic_int_get(&ctxt->suspended))
+    {
+        GST_DEBUG("already suspended");
+        goto done;
+    }
+
+    state = _agmp_es_get_state(ctxt);
+    AGMP_ASSERT_FAIL_GOTO(state >= AGMP_ES_STATE_PREROLL_INIT && state < AGMP_ES_STATE_DESTROY, errors, "should call this interface after agmp_es_start");
+
+    pos = _agmp_es_get_position(ctxt);
+    ctxt->suspend_pos = GST_CLOCK_TIME_IS_VALID(pos) ? pos : ctxt->seek_to_pos;
+
+    /* without retained samples, resume has upper layer write again from the keyframe before the position */
+    g_mutex_lock(&ctxt->retain_lock);
+    pos = _agmp_es_retain_key_before(ctxt, ctxt->suspend_pos);
+    g_mutex_unlock(&ctxt->retain_lock);
+    if (GST_CLOCK_TIME_IS_VALID(pos))
+        ctxt->suspend_pos = pos;
+
+    g_atomic_int_set(&ctxt->suspended, TRUE);
+
+    /*
+        READY stops streaming and flushes appsrc queues but keeps caps,
+        NULL on locked decoders and sinks then gives back the hardware
+    */
+    if (!_agmp_es_set_pipeline_state(ctxt, GST_STATE_READY))
+    {
+        g_atomic_int_set(&ctxt->suspended, FALSE);
+        GST_ERROR("chg pipeline state failed, stay resumed.");
+        goto errors;
+    }
+    _agmp_es_lock_elements(ctxt, TRUE);
+    ctxt->paused_internal = FALSE;
+    g_atomic_int_set(&ctxt->wait_preroll, FALSE);
+
+    if (ctxt->v_path.sec_allocator)
+    {
+        gst_object_unref(ctxt->v_path.sec_allocator);
+        ctxt->v_path.sec_allocator = NULL;
+    }
+
+    GST_INFO("suspended at %" GST_TIME_FORMAT, GST_TIME_ARGS(ctxt->suspend_pos));
+
+done:
+    g_mutex_unlock(&ctxt->write_lock);
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+errors:
+    ret = FALSE;
+    goto done;
+}
+
+BOOL agmp_es_resume(AGMP_ES_HANDLE handle)
+{
+    AgmpEsCtxt *ctxt;
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    ctxt = (AgmpEsCtxt *)handle;
+    ret = TRUE;
+
+    /* play, pause, seek and rate calls recorded while suspended are applied below */
+    g_mutex_lock(&ctxt->write_lock);
+    if (!g_atomic_int_get(&ctxt->suspended))
+    {
+        GST_DEBUG("not suspended");
+        goto done;
+    }
+
+    if (ctxt->common_cfgs.secure_mode && ctxt->v_path.exist)
+        AGMP_ASSERT_FAIL_GOTO((ctxt->v_path.sec_allocator = _agmp_es_create_sec_allocator(ctxt)), errors, "create secure allocator meet error.");
+
+    _agmp_es_lock_elements(ctxt, FALSE);
+    AGMP_ASSERT_FAIL_GOTO(_agmp_es_set_pipeline_state(ctxt, GST_STATE_PAUSED), errors, "chg pipeline state failed.");
+
+    /*
+        writes stay rejected until the seek flushed appsrc queues,
+        retained samples are replayed if the position is inside the retention window.
+        ms are rounded up, a position snapped to a keyframe must not land before it
+    */
+    AGMP_ASSERT_FAIL_GOTO(_agmp_es_seek(ctxt, ctxt->play_rate, (ctxt->suspend_pos + GST_MSECOND - 1) / GST_MSECOND), errors, "re-preroll meet error.");
+    g_atomic_int_set(&ctxt->suspended, FALSE);
+
+    if (ctxt->play_state)
+        ret = _agmp_es_set_pipeline_state(ctxt, GST_STATE_PLAYING);
+
+    GST_INFO("resumed at %" GST_TIME_FORMAT ", upper layer resumes writing after vid:%" GST_TIME_FORMAT " aud:%" GST_TIME_FORMAT,
+             GST_TIME_ARGS(ctxt->suspend_pos), GST_TIME_ARGS(ctxt->v_path.resume_ts), GST_TIME_ARGS(ctxt->a_path.resume_ts));
+
+done:
+    g_mutex_unlock(&ctxt->write_lock);
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+errors:
+    ret = FALSE;
+    goto done;
+}
+
 BOOL agmp_es_set_eos(AGMP_ES_HANDLE handle, AgmpEsType type)
 {
     AgmpEsCtxt *ctxt;
@@ -704,8 +1110,13 @@ void agmp_es_set_display_window(AGMP_ES_HANDLE handle, AgmpWindow *window)
     if (ctxt->v_path.exist && ctxt->v_path.sink)
     {
         gchar *rect = g_strdup_printf("%d,%d,%d,%d", window->x, window->y, window->w, window->h);
+        ctxt->v_path.cfgs.disp_window = *window;
+        _agmp_es_update_sw_scale(ctxt);
         GST_TRACE("Set Bounds: rect %s", rect);
-        g_object_set(ctxt->v_path.sink, "rectangle", rect, NULL);
+        if (g_object_class_find_property(G_OBJECT_GET_CLASS(ctxt->v_path.sink), "rectangle"))
+            g_object_set(ctxt->v_path.sink, "rectangle", rect, NULL);
+        else
+            GST_WARNING("video sink can't set display window");
         free(rect);
     }
     else
@@ -724,17 +1135,25 @@ BOOL agmp_es_set_pause(AGMP_ES_HANDLE handle)
     ctxt = (AgmpEsCtxt *)handle;
     ret = FALSE;
 
-    if (ctxt->state < AGMP_ES_STATE_PREROLL_INIT)
+    g_mutex_lock(&ctxt->write_lock);
+    if (_agmp_es_get_state(ctxt) < AGMP_ES_STATE_PREROLL_INIT)
     {
-        GST_ERROR("should not set pause when agmp-es is in state:%d", ctxt->state);
+        GST_ERROR("should not set pause when agmp-es is in state:%d", _agmp_es_get_state(ctxt));
         ret = FALSE;
         goto done;
     }
 
     ctxt->play_state = 0;
+    if (g_atomic_int_get(&ctxt->suspended))
+    {
+        GST_INFO("suspended, stay paused on resume");
+        ret = TRUE;
+        goto done;
+    }
     ret = _agmp_es_set_pipeline_state(ctxt, GST_STATE_PAUSED);
 
 done:
+    g_mutex_unlock(&ctxt->write_lock);
     GST_TRACE("trace out ret bool:%d", ret);
     return ret;
 }
@@ -750,12 +1169,16 @@ BOOL agmp_es_set_play(AGMP_ES_HANDLE handle)
 
     ctxt = (AgmpEsCtxt *)handle;
 
+    g_mutex_lock(&ctxt->write_lock);
     ctxt->play_state = 1;
 
-    if (ctxt->paused_internal)
+    if (g_atomic_int_get(&ctxt->suspended))
+        GST_INFO("suspended, play on resume");
+    else if (ctxt->paused_internal)
         GST_INFO("ignore upper-layer play command when paused internal");
     else
         ret = _agmp_es_set_pipeline_state(ctxt, GST_STATE_PLAYING);
+    g_mutex_unlock(&ctxt->write_lock);
 
     GST_TRACE("trace out ret bool:%d", ret);
     return ret;
@@ -772,6 +1195,7 @@ BOOL agmp_es_set_rate(AGMP_ES_HANDLE handle, double rate)
     ctxt = (AgmpEsCtxt *)handle;
     ret = TRUE;
 
+    g_mutex_lock(&ctxt->write_lock);
     if (rate == ctxt->play_rate)
     {
         GST_INFO("rate not change");
@@ -781,6 +1205,13 @@ BOOL agmp_es_set_rate(AGMP_ES_HANDLE handle, double rate)
 
     ctxt->play_rate = rate;
 
+    /* the resume seek carries play_rate */
+    if (g_atomic_int_get(&ctxt->suspended))
+    {
+        GST_INFO("suspended, rate:%f is applied on resume", rate);
+        goto done;
+    }
+
     if (ctxt->a_path.exist && ctxt->a_path.src)
     {
         GstPad *sink_pad = gst_element_get_static_pad(ctxt->a_path.sink, "sink");
@@ -816,6 +1247,7 @@ BOOL agmp_es_set_rate(AGMP_ES_HANDLE handle, double rate)
     }
 
 done:
+    g_mutex_unlock(&ctxt->write_lock);
     GST_TRACE("trace out ret bool:%d", ret);
     return ret;
 }
@@ -828,8 +1260,8 @@ AgmpEsStateType agmp_es_get_state(AGMP_ES_HANDLE handle)
 
     ctxt = (AgmpEsCtxt *)handle;
 
-    GST_TRACE("trace out ret AgmpEsStateType:%d", ctxt->state);
-    return ctxt->state;
+    GST_TRACE("trace out ret AgmpEsStateType:%d", _agmp_es_get_state(ctxt));
+    return _agmp_es_get_state(ctxt);
 }
 
 BOOL agmp_es_get_play_info(AGMP_ES_HANDLE handle, AgmpPlayInfo *play_info)
@@ -847,6 +1279,8 @@ BOOL agmp_es_get_play_info(AGMP_ES_HANDLE handle, AgmpPlayInfo *play_info)
 
     play_info->duration /= GST_MSECOND;
     play_info->position /= GST_MSECOND;
+    if (g_atomic_int_get(&ctxt->suspended))
+        play_info->position = ctxt->suspend_pos / GST_MSECOND;
 
     if (ctxt->v_path.exist)
     {
@@ -854,8 +1288,10 @@ BOOL agmp_es_get_play_info(AGMP_ES_HANDLE handle, AgmpPlayInfo *play_info)
         play_info->frame_height = ctxt->v_path.cfgs.format_info.frame_height;
         play_info->total_video_frames = ctxt->v_path.total_frame_num;
         play_info->corrupted_video_frames = 0;
-        if (ctxt->v_path.sink)
+        if (ctxt->v_path.sink && g_object_class_find_property(G_OBJECT_GET_CLASS(ctxt->v_path.sink), "frames-dropped"))
             g_object_get(G_OBJECT(ctxt->v_path.sink), "frames-dropped", &play_info->dropped_video_frames, NULL);
+        else
+            play_info->dropped_video_frames = ctxt->v_path.dropped_frame_num;
     }
     else
     {
@@ -881,6 +1317,65 @@ BOOL agmp_es_get_play_info(AGMP_ES_HANDLE handle, AgmpPlayInfo *play_info)
     return ret;
 }
 
+BOOL agmp_es_get_seek_info(AGMP_ES_HANDLE handle, AgmpSeekInfo *seek_info)
+{
+    AgmpEsCtxt *ctxt;
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    ctxt = (AgmpEsCtxt *)handle;
+    ret = TRUE;
+
+    memcpy(seek_info, &ctxt->seek_info, sizeof(AgmpSeekInfo));
+
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+}
+
+BOOL agmp_es_get_latency_info(AGMP_ES_HANDLE handle, AgmpLatencyInfo *latency_info)
+{
+    AgmpEsCtxt *ctxt;
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    ctxt = (AgmpEsCtxt *)handle;
+    ret = TRUE;
+
+    g_mutex_lock(&ctxt->latency_lock);
+    latency_info->latency = ctxt->latency;
+    latency_info->avg_latency = ctxt->avg_latency;
+    latency_info->max_latency = ctxt->max_latency;
+    g_mutex_unlock(&ctxt->latency_lock);
+    latency_info->late_dropped_frames = ctxt->v_path.late_frame_num + ctxt->a_path.late_frame_num;
+
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+}
+
+BOOL agmp_es_get_av_sync_info(AGMP_ES_HANDLE handle, AgmpAvSyncInfo *av_sync_info)
+{
+    AgmpEsCtxt *ctxt;
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    ctxt = (AgmpEsCtxt *)handle;
+    ret = TRUE;
+
+    g_mutex_lock(&ctxt->av_sync_lock);
+    av_sync_info->av_offset = ctxt->av_sync.offset;
+    av_sync_info->av_jitter = ctxt->av_sync.jitter;
+    av_sync_info->av_drift = ctxt->av_sync.drift;
+    av_sync_info->av_max_offset = ctxt->av_sync.max_offset;
+    av_sync_info->av_sync_samples = ctxt->av_sync.samples;
+    g_mutex_unlock(&ctxt->av_sync_lock);
+
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+}
+
 /* static function definition */
 AgmpEsCtxt *_agmp_es_init(void)
 {
@@ -896,11 +1391,11 @@ AgmpEsCtxt *_agmp_es_init(void)
 
     GST_TRACE("trace in");
 
-    _start_time = gst_util_get_timestamp();
-
     AGMP_ASSERT_FAIL_GOTO((ctxt = g_new0(AgmpEsCtxt, 1)), errors, "new AgmpEsCtxt failed.");
     memset(ctxt, 0, sizeof(AgmpEsCtxt));
 
+    ctxt->start_time = gst_util_get_timestamp();
+
     AGMP_ASSERT_FAIL_GOTO((ctxt->main_loop_context = g_main_context_new()), errors, "new main loop ctxt failed.");
     g_main_context_push_thread_default(ctxt->main_loop_context);
     AGMP_ASSERT_FAIL_GOTO((ctxt->main_loop = g_main_loop_new(ctxt->main_loop_context, FALSE)), errors, "new main loop failed.");
@@ -909,6 +1404,7 @@ AgmpEsCtxt *_agmp_es_init(void)
     AGMP_ASSERT_FAIL_GOTO((ctxt->pipeline = gst_pipeline_new("agmp_es_static_pipeline")), errors, "new pipeline element failed.");
     AGMP_ASSERT_FAIL_GOTO((bus = gst_element_get_bus(ctxt->pipeline)), errors, "get bus from pipeline failed.");
     ctxt->bus_watch = gst_bus_add_watch(bus, _agmp_es_bus_cb, ctxt);
+    gst_bus_set_sync_handler(bus, _agmp_es_bus_sync_cb, ctxt, NULL);
     gst_object_unref(bus);
 
     ctxt->paused_internal = TRUE;
@@ -926,6 +1422,28 @@ AgmpEsCtxt *_agmp_es_init(void)
 
     ctxt->seek_to_pos = GST_CLOCK_TIME_NONE;
 
+    ctxt->seek_mode = AGMP_SEEK_MODE_ACCURATE;
+    ctxt->seek_info.seek_time = -1;
+    ctxt->seek_info.flush_done_time = -1;
+    ctxt->seek_info.first_push_time = -1;
+    ctxt->seek_info.first_decoded_time = -1;
+    ctxt->seek_info.present_time = -1;
+    ctxt->snap_ts = GST_CLOCK_TIME_NONE;
+    g_mutex_init(&ctxt->snap_lock);
+    g_rec_mutex_init(&ctxt->state_lock);
+
+    g_mutex_init(&ctxt->retain_lock);
+    g_mutex_init(&ctxt->write_lock);
+    g_mutex_init(&ctxt->latency_lock);
+    ctxt->late_anchor_clock = GST_CLOCK_TIME_NONE;
+    g_mutex_init(&ctxt->av_sync_lock);
+    agmp_av_sync_reset(&ctxt->av_sync);
+    ctxt->latency = ctxt->avg_latency = ctxt->max_latency = -1;
+    g_queue_init(&ctxt->v_path.retained);
+    g_queue_init(&ctxt->a_path.retained);
+    ctxt->v_path.resume_ts = GST_CLOCK_TIME_NONE;
+    ctxt->a_path.resume_ts = GST_CLOCK_TIME_NONE;
+
     _agmp_es_init_cfgs(ctxt);
 
 done:
@@ -982,6 +1500,12 @@ void _agmp_es_deinit(AgmpEsCtxt *ctxt)
             gst_object_unref(ctxt->v_path.parser);
         if (ctxt->v_path.decoder)
             gst_object_unref(ctxt->v_path.decoder);
+        if (ctxt->v_path.converter)
+            gst_object_unref(ctxt->v_path.converter);
+        if (ctxt->v_path.scaler)
+            gst_object_unref(ctxt->v_path.scaler);
+        if (ctxt->v_path.scale_filter)
+            gst_object_unref(ctxt->v_path.scale_filter);
         if (ctxt->v_path.sink)
         {
             if (ctxt->v_path.underflow_conn_sig_id)
@@ -1019,6 +1543,18 @@ void _agmp_es_deinit(AgmpEsCtxt *ctxt)
         if (ctxt->main_loop)
             g_main_loop_unref(ctxt->main_loop);
 
+        _agmp_es_retain_clear(ctxt);
+        g_mutex_clear(&ctxt->retain_lock);
+        g_mutex_clear(&ctxt->write_lock);
+        g_mutex_clear(&ctxt->latency_lock);
+        agmp_av_sync_tap_free(ctxt->av_vtap);
+        agmp_av_sync_tap_free(ctxt->av_atap);
+        g_mutex_clear(&ctxt->av_sync_lock);
+        if (ctxt->seek_probe_pad)
+            gst_object_unref(ctxt->seek_probe_pad);
+        g_mutex_clear(&ctxt->snap_lock);
+        g_rec_mutex_clear(&ctxt->state_lock);
+
         g_free(ctxt);
     }
 
@@ -1033,6 +1569,7 @@ void _agmp_es_init_cfgs(AgmpEsCtxt *ctxt)
     _agmp_es_init_common_cfgs(&ctxt->common_cfgs);
     _agmp_es_init_vid_cfgs(&ctxt->v_path.cfgs);
     _agmp_es_init_aud_cfgs(&ctxt->a_path.cfgs);
+    _agmp_es_init_ext_cfgs(&ctxt->ext_cfgs);
 
     GST_TRACE("trace out ret void");
 }
@@ -1091,6 +1628,20 @@ void _agmp_es_init_aud_cfgs(AgmpEsAudCfg *aud_cfgs)
     aud_cfgs->format_info.data.size = 0;
 }
 
+void _agmp_es_init_ext_cfgs(AgmpEsExtCfg *ext_cfgs)
+{
+    /*
+        don't print gst log in this func
+        because it called before debug category obj init
+    */
+
+    ext_cfgs->size = sizeof(AgmpEsExtCfg);
+    ext_cfgs->retention_window = AGMP_ES_DEFAULT_RETENTION_WINDOW;
+    ext_cfgs->low_latency_mode = AGMP_ES_DEFAULT_LOW_LATENCY_MODE;
+    ext_cfgs->latency_target = AGMP_ES_DEFAULT_LATENCY_TARGET;
+    ext_cfgs->av_sync_bound = AGMP_ES_DEFAULT_AV_SYNC_BOUND;
+}
+
 gboolean _agmp_es_update_cfgs(AgmpEsCtxt *ctxt, AgmpEsCfg *cfgs, gboolean *updated_in)
 {
     gboolean ret, ret_common, ret_vid, ret_aud;
@@ -1284,35 +1835,83 @@ done:
     return ret;
 }
 
-gboolean _agmp_es_create_paths(AgmpEsCtxt *ctxt)
+gboolean _agmp_es_update_ext_cfgs(AgmpEsExtCfg *dst, AgmpEsExtCfg *src_in, gboolean *updated)
 {
-    gboolean ret, ret_vpath, ret_apath;
+    AgmpEsExtCfg src_cfg, *src;
+    gboolean is_updated;
+    gboolean ret;
 
     GST_TRACE("trace in");
 
-    ret = ret_vpath = ret_apath = FALSE;
+    is_updated = FALSE;
+    ret = TRUE;
+    src = &src_cfg;
 
-    ret_vpath = _agmp_es_create_vpath(ctxt);
-    GST_DEBUG("create vpath:%d", ret_vpath);
-    ret_apath = _agmp_es_create_apath(ctxt);
-    GST_DEBUG("create apath:%d", ret_apath);
+    AGMP_ASSERT_FAIL_GOTO(src_in->size >= sizeof(src_in->size), errors, "ext cfgs size not set");
 
-    ret = ret_vpath && ret_apath;
+    // upper layer built with an older header doesn't know the trailing fields, keep ours for them
+    memcpy(src, dst, sizeof(AgmpEsExtCfg));
+    memcpy(src, src_in, MIN(src_in->size, sizeof(AgmpEsExtCfg)));
+    src->size = sizeof(AgmpEsExtCfg);
 
-    GST_TRACE("trace out ret bool:%d", ret);
-    return ret;
-}
+    if (!memcmp(dst, src, sizeof(AgmpEsExtCfg)))
+    {
+        GST_DEBUG("ext cfgs not change");
+        goto done;
+    }
 
-gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
-{
-    AgmpVidCodecType codec;
-    GstElement *tmp;
-    gboolean ret;
+    if (src->retention_window >= 0)
+        dst->retention_window = src->retention_window;
 
-    GST_TRACE("trace in");
+    dst->low_latency_mode = src->low_latency_mode;
+    if (src->latency_target > 0)
+        dst->latency_target = src->latency_target;
 
-    codec = ctxt->v_path.cfgs.vcodec;
-    ret = TRUE;
+    if (src->av_sync_bound >= 0)
+        dst->av_sync_bound = src->av_sync_bound;
+
+    is_updated = TRUE;
+
+done:
+    if (updated)
+        *updated = is_updated;
+
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+errors:
+    ret = FALSE;
+    goto done;
+}
+
+gboolean _agmp_es_create_paths(AgmpEsCtxt *ctxt)
+{
+    gboolean ret, ret_vpath, ret_apath;
+
+    GST_TRACE("trace in");
+
+    ret = ret_vpath = ret_apath = FALSE;
+
+    ret_vpath = _agmp_es_create_vpath(ctxt);
+    GST_DEBUG("create vpath:%d", ret_vpath);
+    ret_apath = _agmp_es_create_apath(ctxt);
+    GST_DEBUG("create apath:%d", ret_apath);
+
+    ret = ret_vpath && ret_apath;
+
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+}
+
+gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
+{
+    AgmpVidCodecType codec;
+    GstElement *tmp;
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    codec = ctxt->v_path.cfgs.vcodec;
+    ret = TRUE;
 
     if (VCODEC_NONE == codec)
     {
@@ -1325,20 +1924,7 @@ gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
     /* create secure allocator for secure case */
     // TODO:need to deal with secure_mode is TRUE but only audio is enc
     if (ctxt->common_cfgs.secure_mode)
-    {
-        uint8_t format = SECMEM_DECODER_DEFAULT;
-        if (VCODEC_AV1 == codec)
-            format = SECMEM_DECODER_AV1;
-        else if (VCODEC_VP9 == codec)
-            format = SECMEM_DECODER_VP9;
-
-        gboolean is_4k = TRUE;
-        if (ctxt->v_path.cfgs.disp_window.w <= 1920 && ctxt->v_path.cfgs.disp_window.h <= 1080)
-        {
-            is_4k = FALSE;
-        }
-        AGMP_ASSERT_FAIL_GOTO((ctxt->v_path.sec_allocator = gst_secmem_allocator_new(is_4k, format)), errors, "create secure allocator meet error.");
-    }
+        AGMP_ASSERT_FAIL_GOTO((ctxt->v_path.sec_allocator = _agmp_es_create_sec_allocator(ctxt)), errors, "create secure allocator meet error.");
 
     /* init vpath ctxt flags */
     ctxt->v_path.exist = TRUE;
@@ -1362,7 +1948,7 @@ gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
         else
             ctxt->v_path.parser = gst_element_factory_make("h264parse", "h264parse");
 
-        ctxt->v_path.decoder = gst_element_factory_make("amlv4l2h264dec", "amlv4l2h264dec");
+        ctxt->v_path.decoder = _agmp_es_make_vdec(ctxt, "amlv4l2h264dec", "avdec_h264");
 
         if ((!ctxt->common_cfgs.secure_mode && !ctxt->v_path.parser) ||
             (ctxt->common_cfgs.secure_mode && !ctxt->v_path.sec_parser) ||
@@ -1378,7 +1964,7 @@ gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
         else
             ctxt->v_path.parser = gst_element_factory_make("h265parse", "h265parse");
 
-        ctxt->v_path.decoder = gst_element_factory_make("amlv4l2h265dec", "amlv4l2h265dec");
+        ctxt->v_path.decoder = _agmp_es_make_vdec(ctxt, "amlv4l2h265dec", "avdec_h265");
 
         if (!ctxt->v_path.parser || !ctxt->v_path.decoder)
             goto errors;
@@ -1387,7 +1973,7 @@ gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
     }
     case VCODEC_MPEG2:
     {
-        ctxt->v_path.decoder = gst_element_factory_make("amlv4l2mpeg4dec", "amlv4l2mpeg4dec");
+        ctxt->v_path.decoder = _agmp_es_make_vdec(ctxt, "amlv4l2mpeg4dec", "avdec_mpeg2video");
 
         if (!ctxt->v_path.decoder)
             goto errors;
@@ -1396,12 +1982,16 @@ gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
     }
     case VCODEC_THEORA:
     {
-        // TODO: need add S/W decoder?
-        goto errors;
+        ctxt->v_path.decoder = _agmp_es_make_vdec(ctxt, NULL, "theoradec");
+
+        if (!ctxt->v_path.decoder)
+            goto errors;
+
+        break;
     }
     case VCODEC_VC1:
     {
-        ctxt->v_path.decoder = gst_element_factory_make("amlv4l2vc1dec", "amlv4l2vc1dec");
+        ctxt->v_path.decoder = _agmp_es_make_vdec(ctxt, "amlv4l2vc1dec", "avdec_vc1");
 
         if (!ctxt->v_path.decoder)
             goto errors;
@@ -1410,7 +2000,7 @@ gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
     }
     case VCODEC_AV1:
     {
-        ctxt->v_path.decoder = gst_element_factory_make("amlv4l2av1dec", "amlv4l2av1dec");
+        ctxt->v_path.decoder = _agmp_es_make_vdec(ctxt, "amlv4l2av1dec", "dav1ddec");
 
         if (!ctxt->v_path.decoder)
             goto errors;
@@ -1419,12 +2009,16 @@ gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
     }
     case VCODEC_VP8:
     {
-        // TODO: need add S/W decoder?
-        goto errors;
+        ctxt->v_path.decoder = _agmp_es_make_vdec(ctxt, NULL, "vp8dec");
+
+        if (!ctxt->v_path.decoder)
+            goto errors;
+
+        break;
     }
     case VCODEC_VP9:
     {
-        ctxt->v_path.decoder = gst_element_factory_make("amlv4l2vp9dec", "amlv4l2vp9dec");
+        ctxt->v_path.decoder = _agmp_es_make_vdec(ctxt, "amlv4l2vp9dec", "vp9dec");
 
         if (!ctxt->v_path.decoder)
             goto errors;
@@ -1446,9 +2040,34 @@ gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
     gst_app_src_set_max_bytes(GST_APP_SRC(ctxt->v_path.src), ctxt->v_path.cfgs.src_max_byte_size);
     g_object_set(G_OBJECT(ctxt->v_path.src), "min-percent", ctxt->v_path.cfgs.src_min_percent, NULL);
     GST_DEBUG("cfg vid-appsrc max bytes:%d, min percent:%d", ctxt->v_path.cfgs.src_max_byte_size, ctxt->v_path.cfgs.src_min_percent);
+    _agmp_es_low_latency_config_src(ctxt, ctxt->v_path.src);
+    {
+        GstPad *src_pad = gst_element_get_static_pad(ctxt->v_path.src, "src");
+        ctxt->v_path.snap_probe_id = gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                                                       _agmp_es_snap_probe_cb, ctxt, NULL);
+        gst_object_unref(src_pad);
+    }
 
     /* make sink element */
-    AGMP_ASSERT_FAIL_GOTO((ctxt->v_path.sink = gst_element_factory_make("amlvideosink", "vidsink")), errors, "create video sink failed.");
+    ctxt->v_path.sink = gst_element_factory_make("amlvideosink", "vidsink");
+    if (ctxt->v_path.sw_decode)
+    {
+        /* s/w decoded frames may need color conversion, and there may be no amlvideosink on workstations */
+        AGMP_ASSERT_FAIL_GOTO((ctxt->v_path.converter = gst_element_factory_make("videoconvert", "videoconvert")), errors, "create video converter failed.");
+        AGMP_ASSERT_FAIL_GOTO((ctxt->v_path.scaler = gst_element_factory_make("videoscale", "videoscale")), errors, "create video scaler failed.");
+        AGMP_ASSERT_FAIL_GOTO((ctxt->v_path.scale_filter = gst_element_factory_make("capsfilter", "videoscalefilter")), errors, "create video scale filter failed.");
+        _agmp_es_update_sw_scale(ctxt);
+        if (!ctxt->v_path.sink)
+            ctxt->v_path.sink = gst_element_factory_make("autovideosink", "vidsink");
+    }
+    AGMP_ASSERT_FAIL_GOTO(ctxt->v_path.sink, errors, "create video sink failed.");
+    _agmp_es_low_latency_config_sink(ctxt, ctxt->v_path.sink);
+    if (ctxt->ext_cfgs.low_latency_mode)
+    {
+        GstPad *sink_pad = gst_element_get_static_pad(ctxt->v_path.sink, "sink");
+        ctxt->v_path.latency_probe_id = gst_pad_add_probe(sink_pad, GST_PAD_PROBE_TYPE_BUFFER, _agmp_es_latency_probe_cb, ctxt, NULL);
+        gst_object_unref(sink_pad);
+    }
     // if (ctxt->common_cfgs.pip_mode)
     //     g_object_set(G_OBJECT(ctxt->v_path.sink), "pip", TRUE, NULL);
     // // TODO:check amlvideosink support low-memory property
@@ -1487,6 +2106,27 @@ gboolean _agmp_es_create_vpath(AgmpEsCtxt *ctxt)
         gst_element_link(tmp, ctxt->v_path.decoder);
         tmp = ctxt->v_path.decoder;
     }
+    if (ctxt->v_path.scaler)
+    {
+        gst_bin_add(GST_BIN(ctxt->pipeline), ctxt->v_path.scaler);
+        AGMP_ASSERT_FAIL_GOTO(tmp, errors, "link failed.");
+        gst_element_link(tmp, ctxt->v_path.scaler);
+        tmp = ctxt->v_path.scaler;
+    }
+    if (ctxt->v_path.scale_filter)
+    {
+        gst_bin_add(GST_BIN(ctxt->pipeline), ctxt->v_path.scale_filter);
+        AGMP_ASSERT_FAIL_GOTO(tmp, errors, "link failed.");
+        gst_element_link(tmp, ctxt->v_path.scale_filter);
+        tmp = ctxt->v_path.scale_filter;
+    }
+    if (ctxt->v_path.converter)
+    {
+        gst_bin_add(GST_BIN(ctxt->pipeline), ctxt->v_path.converter);
+        AGMP_ASSERT_FAIL_GOTO(tmp, errors, "link failed.");
+        gst_element_link(tmp, ctxt->v_path.converter);
+        tmp = ctxt->v_path.converter;
+    }
     if (ctxt->v_path.sink)
     {
         gst_bin_add(GST_BIN(ctxt->pipeline), ctxt->v_path.sink);
@@ -1507,6 +2147,125 @@ errors:
     goto done;
 }
 
+GstAllocator *_agmp_es_create_sec_allocator(AgmpEsCtxt *ctxt)
+{
+    AgmpVidCodecType codec;
+    uint8_t format;
+    gboolean is_4k;
+
+    codec = ctxt->v_path.cfgs.vcodec;
+
+    format = SECMEM_DECODER_DEFAULT;
+    if (VCODEC_AV1 == codec)
+        format = SECMEM_DECODER_AV1;
+    else if (VCODEC_VP9 == codec)
+        format = SECMEM_DECODER_VP9;
+
+    is_4k = TRUE;
+    if (ctxt->v_path.cfgs.disp_window.w <= 1920 && ctxt->v_path.cfgs.disp_window.h <= 1080)
+    {
+        is_4k = FALSE;
+    }
+
+    return gst_secmem_allocator_new(is_4k, format);
+}
+
+GstElement *_agmp_es_make_vdec(AgmpEsCtxt *ctxt, const gchar *hw_name, const gchar *sw_name)
+{
+    GstElement *decoder;
+
+    GST_TRACE("trace in");
+
+    decoder = NULL;
+
+    if (hw_name && (decoder = gst_element_factory_make(hw_name, hw_name)))
+        goto done;
+
+    /* s/w decoder can't read secure memory */
+    AGMP_ASSERT_FAIL_GOTO(!ctxt->common_cfgs.secure_mode, done, "no h/w decoder for secure playback.");
+
+    GST_WARNING("h/w decoder %s not available. fall back to s/w decoder %s", hw_name ? hw_name : "(none)", sw_name);
+    AGMP_ASSERT_FAIL_GOTO((decoder = gst_element_factory_make(sw_name, sw_name)), done, "create s/w decoder failed.");
+
+    ctxt->v_path.sw_decode = TRUE;
+    _agmp_es_config_sw_vdec(ctxt, decoder);
+
+done:
+    GST_TRACE("trace out ret ptr:%p", decoder);
+    return decoder;
+}
+
+void _agmp_es_config_sw_vdec(AgmpEsCtxt *ctxt, GstElement *decoder)
+{
+    GObjectClass *klass;
+    guint threads;
+
+    GST_TRACE("trace in");
+
+    klass = G_OBJECT_GET_CLASS(decoder);
+    threads = g_get_num_processors();
+
+    /* size decoder threads to the cores available */
+    if (g_object_class_find_property(klass, "max-threads")) // avdec_*
+    {
+        g_object_set(decoder, "max-threads", threads, NULL);
+        if (g_object_class_find_property(klass, "thread-type"))
+            gst_util_set_object_arg(G_OBJECT(decoder), "thread-type", "frame+slice");
+    }
+    else if (g_object_class_find_property(klass, "threads")) // vp8dec/vp9dec
+        g_object_set(decoder, "threads", threads, NULL);
+    else if (g_object_class_find_property(klass, "n-threads")) // dav1ddec
+        g_object_set(decoder, "n-threads", threads, NULL);
+    GST_INFO("s/w decoder %s uses %u threads", GST_OBJECT_NAME(decoder), threads);
+
+    GST_TRACE("trace out ret void");
+}
+
+void _agmp_es_update_sw_scale(AgmpEsCtxt *ctxt)
+{
+    GstCaps *caps;
+    gint frame_w, frame_h;
+    gint win_w, win_h;
+
+    GST_TRACE("trace in");
+
+    if (!ctxt->v_path.scale_filter)
+        goto done;
+
+    /* scaling and converting s/w decoded frames costs per pixel, shrink them to display window first */
+    frame_w = ctxt->v_path.cfgs.format_info.frame_width;
+    frame_h = ctxt->v_path.cfgs.format_info.frame_height;
+    win_w = ctxt->v_path.cfgs.disp_window.w;
+    win_h = ctxt->v_path.cfgs.disp_window.h;
+    if (frame_w > 0 && frame_h > 0 && win_w > 0 && win_h > 0 && win_w * 2 <= frame_w && win_h * 2 <= frame_h)
+    {
+        gint w, h;
+
+        /* fit in window keeping aspect ratio, even sizes for subsampled formats */
+        w = win_w;
+        h = (gint)((gint64)frame_h * win_w / frame_w);
+        if (h > win_h)
+        {
+            h = win_h;
+            w = (gint)((gint64)frame_w * win_h / frame_h);
+        }
+        w = MAX(w & ~1, 2);
+        h = MAX(h & ~1, 2);
+
+        caps = gst_caps_new_simple("video/x-raw", "width", G_TYPE_INT, w, "height", G_TYPE_INT, h, NULL);
+        GST_INFO("window %dx%d is small for frame %dx%d. downscale to %dx%d", win_w, win_h, frame_w, frame_h, w, h);
+    }
+    else
+        caps = gst_caps_new_empty_simple("video/x-raw");
+
+    /* capsfilter asks upstream to renegotiate when its caps change */
+    g_object_set(ctxt->v_path.scale_filter, "caps", caps, NULL);
+    gst_caps_unref(caps);
+
+done:
+    GST_TRACE("trace out ret void");
+}
+
 gboolean _agmp_es_create_apath(AgmpEsCtxt *ctxt)
 {
     AgmpAudCodecType codec;
@@ -1536,6 +2295,18 @@ gboolean _agmp_es_create_apath(AgmpEsCtxt *ctxt)
     /* create audio caps */
     AGMP_ASSERT_FAIL_GOTO(_agmp_es_create_acaps(ctxt), errors, "create audio caps failed.");
 
+    /* make sink element first, path below is decided by what it accepts */
+    AGMP_ASSERT_FAIL_GOTO((ctxt->a_path.sink = gst_element_factory_make("amlhalasink", "audsink")), errors, "create audio sink failed.");
+    g_object_set(G_OBJECT(ctxt->a_path.sink), "wait-video", TRUE, NULL);
+    g_object_set(G_OBJECT(ctxt->a_path.sink), "a-wait-timeout", 4000, NULL);
+    g_object_set(G_OBJECT(ctxt->a_path.sink), "disable-xrun", FALSE, NULL);
+    _agmp_es_low_latency_config_sink(ctxt, ctxt->a_path.sink);
+    if (ctxt->common_cfgs.pip_mode)
+        g_object_set(G_OBJECT(ctxt->a_path.sink), "direct-mode", FALSE, NULL);
+    // ctxt->a_path.underflow_conn_sig_id = g_signal_connect_swapped(ctxt->a_path.sink,
+    //                                                               "underrun-callback",
+    //                                                               G_CALLBACK(_agmp_es_underflow_cb), ctxt);
+
     /* make parser & decoder & converter & resample elements */
     switch (codec)
     {
@@ -1557,6 +2328,35 @@ gboolean _agmp_es_create_apath(AgmpEsCtxt *ctxt)
         if (!ctxt->a_path.parser)
             goto errors;
 
+        /*
+            passthrough compressed bitstream if sink can take it, else decode it.
+            ask with what ac3parse outputs, it tells ac3 from eac3 unlike appsrc caps
+        */
+        {
+            GstCaps *parsed_caps;
+            gboolean passthrough;
+
+            parsed_caps = gst_caps_new_simple(ACODEC_AC3 == codec ? "audio/x-ac3" : "audio/x-eac3",
+                                              "framed", G_TYPE_BOOLEAN, TRUE,
+                                              "alignment", G_TYPE_STRING, "frame", NULL);
+            if (ctxt->a_path.cfgs.format_info.number_of_channels > 0)
+                gst_caps_set_simple(parsed_caps, "channels", G_TYPE_INT, ctxt->a_path.cfgs.format_info.number_of_channels, NULL);
+            if (ctxt->a_path.cfgs.format_info.samples_per_second > 0)
+                gst_caps_set_simple(parsed_caps, "rate", G_TYPE_INT, ctxt->a_path.cfgs.format_info.samples_per_second, NULL);
+
+            passthrough = _agmp_es_sink_accept_caps(ctxt->a_path.sink, parsed_caps, FALSE);
+            GST_INFO("audio sink %s %" GST_PTR_FORMAT, passthrough ? "accepts, passthrough" : "doesn't accept, decode", parsed_caps);
+            gst_caps_unref(parsed_caps);
+            if (passthrough)
+                break;
+        }
+
+        /* both codecs use audio/x-eac3 caps, eac3 decoder handles ac3 frames as well */
+        ctxt->a_path.decoder = gst_element_factory_make("avdec_eac3", "avdec_eac3");
+
+        if (!ctxt->a_path.decoder)
+            goto errors;
+
         break;
     }
     case ACODEC_OPUS:
@@ -1592,13 +2392,31 @@ gboolean _agmp_es_create_apath(AgmpEsCtxt *ctxt)
     }
     }
 
-    if (codec != ACODEC_AC3 && codec != ACODEC_EAC3)
+    /* decoded pcm only needs converting when sink can't take every format decoder may output */
+    if (ctxt->a_path.decoder)
     {
-        ctxt->a_path.converter = gst_element_factory_make("audioconvert", "audioconvert");
-        ctxt->a_path.resample = gst_element_factory_make("audioresample", "audioresample");
+        GstPad *dec_pad;
+        GstCaps *dec_caps;
+        gboolean need_convert;
 
-        if (!ctxt->a_path.converter || !ctxt->a_path.resample)
-            goto errors;
+        need_convert = TRUE;
+        if ((dec_pad = gst_element_get_static_pad(ctxt->a_path.decoder, "src")))
+        {
+            dec_caps = gst_pad_get_pad_template_caps(dec_pad);
+            need_convert = !_agmp_es_sink_accept_caps(ctxt->a_path.sink, dec_caps, TRUE);
+            gst_caps_unref(dec_caps);
+            gst_object_unref(dec_pad);
+        }
+        GST_INFO("audio decoder output %s audioconvert/audioresample", need_convert ? "needs" : "skips");
+
+        if (need_convert)
+        {
+            ctxt->a_path.converter = gst_element_factory_make("audioconvert", "audioconvert");
+            ctxt->a_path.resample = gst_element_factory_make("audioresample", "audioresample");
+
+            if (!ctxt->a_path.converter || !ctxt->a_path.resample)
+                goto errors;
+        }
     }
 
     /* make src element */
@@ -1609,17 +2427,14 @@ gboolean _agmp_es_create_apath(AgmpEsCtxt *ctxt)
     gst_app_src_set_max_bytes(GST_APP_SRC(ctxt->a_path.src), ctxt->a_path.cfgs.src_max_byte_size);
     g_object_set(G_OBJECT(ctxt->a_path.src), "min-percent", ctxt->a_path.cfgs.src_min_percent, NULL);
     GST_DEBUG("cfg aud-appsrc max bytes:%d, min percent:%d", ctxt->a_path.cfgs.src_max_byte_size, ctxt->a_path.cfgs.src_min_percent);
+    _agmp_es_low_latency_config_src(ctxt, ctxt->a_path.src);
+    {
+        GstPad *src_pad = gst_element_get_static_pad(ctxt->a_path.src, "src");
+        ctxt->a_path.snap_probe_id = gst_pad_add_probe(src_pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                                                       _agmp_es_snap_probe_cb, ctxt, NULL);
+        gst_object_unref(src_pad);
+    }
 
-    /* make sink element */
-    AGMP_ASSERT_FAIL_GOTO((ctxt->a_path.sink = gst_element_factory_make("amlhalasink", "audsink")), errors, "create audio sink failed.");
-    g_object_set(G_OBJECT(ctxt->a_path.sink), "wait-video", TRUE, NULL);
-    g_object_set(G_OBJECT(ctxt->a_path.sink), "a-wait-timeout", 4000, NULL);
-    g_object_set(G_OBJECT(ctxt->a_path.sink), "disable-xrun", FALSE, NULL);
-    if (ctxt->common_cfgs.pip_mode)
-        g_object_set(G_OBJECT(ctxt->a_path.sink), "direct-mode", FALSE, NULL);
-    // ctxt->a_path.underflow_conn_sig_id = g_signal_connect_swapped(ctxt->a_path.sink,
-    //                                                               "underrun-callback",
-    //                                                               G_CALLBACK(_agmp_es_underflow_cb), ctxt);
     /* add elements */
     tmp = NULL;
     if (ctxt->a_path.src)
@@ -1924,6 +2739,60 @@ done:
     return ret;
 }
 
+gboolean _agmp_es_sink_accept_caps(GstElement *sink, GstCaps *caps, gboolean all)
+{
+    GstPad *sink_pad;
+    GstCaps *sink_caps;
+    gboolean opened;
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    sink_pad = NULL;
+    sink_caps = NULL;
+    opened = FALSE;
+    ret = FALSE;
+
+    AGMP_ASSERT_FAIL_GOTO(sink && caps, done, "invalid input params.");
+    AGMP_ASSERT_FAIL_GOTO((sink_pad = gst_element_get_static_pad(sink, "sink")), done, "get sink pad failed.");
+
+    /* sink only reports what the device supports once opened, before that it's the template caps */
+    if (GST_STATE(sink) < GST_STATE_READY)
+    {
+        opened = GST_STATE_CHANGE_FAILURE != gst_element_set_state(sink, GST_STATE_READY);
+        if (!opened)
+            GST_WARNING_OBJECT(sink, "can't open sink, decide on its template caps");
+    }
+
+    if (gst_caps_is_fixed(caps))
+    {
+        ret = gst_pad_query_accept_caps(sink_pad, caps);
+        GST_DEBUG("sink %s caps %" GST_PTR_FORMAT, ret ? "accepts" : "doesn't accept", caps);
+    }
+    else
+    {
+        sink_caps = gst_pad_query_caps(sink_pad, NULL);
+        if (all)
+            ret = gst_caps_is_subset(caps, sink_caps);
+        else
+            ret = gst_caps_can_intersect(caps, sink_caps);
+
+        GST_DEBUG("sink caps %" GST_PTR_FORMAT " %s caps %" GST_PTR_FORMAT,
+                  sink_caps, ret ? "accepts" : "doesn't accept", caps);
+    }
+
+done:
+    /* back to NULL, sink isn't in the pipeline yet and follows it from there */
+    if (opened)
+        gst_element_set_state(sink, GST_STATE_NULL);
+    if (sink_caps)
+        gst_caps_unref(sink_caps);
+    if (sink_pad)
+        gst_object_unref(sink_pad);
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+}
+
 gboolean _agmp_es_start_msg_thread(AgmpEsCtxt *ctxt)
 {
     gboolean ret;
@@ -2003,6 +2872,12 @@ gpointer _agmp_es_data_ctl_thread_func(gpointer data)
 
         memset(&msg, 0, sizeof(msg));
 
+        if (g_atomic_int_get(&ctxt->suspended))
+        {
+            g_usleep(AGMP_ES_SUSPEND_CHECK_INTERVAL * G_TIME_SPAN_MILLISECOND);
+            continue;
+        }
+
         if (GST_STATE(ctxt->pipeline) < GST_STATE_PAUSED)
         {
             GST_WARNING("pipeline is not in PAUSED or PLAYING state");
@@ -2022,7 +2897,9 @@ gpointer _agmp_es_data_ctl_thread_func(gpointer data)
 
         if (ctxt->paused_internal)
         {
-            if (AGMP_ES_DATA_BUFFERING_DONE == v_status && AGMP_ES_DATA_BUFFERING_DONE == a_status)
+            /* low latency mode never waits for data to pile up */
+            if (ctxt->ext_cfgs.low_latency_mode ||
+                (AGMP_ES_DATA_BUFFERING_DONE == v_status && AGMP_ES_DATA_BUFFERING_DONE == a_status))
             {
                 msg.type = AGMP_MSG_DATA_STAT_HIGH;
                 _agmp_dispatch_msg_on_mainloop(ctxt, &msg);
@@ -2038,7 +2915,8 @@ gpointer _agmp_es_data_ctl_thread_func(gpointer data)
         }
         else
         {
-            if (AGMP_ES_DATA_NEED_BUFFERING == v_status || AGMP_ES_DATA_NEED_BUFFERING == a_status)
+            if (!ctxt->ext_cfgs.low_latency_mode &&
+                (AGMP_ES_DATA_NEED_BUFFERING == v_status || AGMP_ES_DATA_NEED_BUFFERING == a_status))
             {
                 GST_INFO("Set Pipline to PAUSE internal(v status:%d, a status:%d)", v_status, a_status);
                 _agmp_es_set_pipeline_state(ctxt, GST_STATE_PAUSED);
@@ -2075,12 +2953,14 @@ gboolean _agmp_es_bus_cb(GstBus *bus, GstMessage *message, gpointer user_data)
 {
     AgmpEsCtxt *ctxt;
     gboolean ret;
+    gboolean fast_handled;
 
     GST_TRACE("trace in");
     GST_INFO("Got GST message %s from %s", GST_MESSAGE_TYPE_NAME(message), GST_MESSAGE_SRC_NAME(message));
 
     ctxt = (AgmpEsCtxt *)user_data;
     ret = TRUE;
+    fast_handled = (gst_mini_object_get_qdata(GST_MINI_OBJECT_CAST(message), AGMP_ES_BUS_FAST_PATH_QUARK) != NULL);
 
     switch (GST_MESSAGE_TYPE(message))
     {
@@ -2102,49 +2982,18 @@ gboolean _agmp_es_bus_cb(GstBus *bus, GstMessage *message, gpointer user_data)
     }
     case GST_MESSAGE_EOS:
     {
-        if (GST_MESSAGE_SRC(message) == GST_OBJECT(ctxt->pipeline))
+        if (fast_handled)
+            GST_DEBUG("eos already handled on posting thread");
+        else if (GST_MESSAGE_SRC(message) == GST_OBJECT(ctxt->pipeline))
             ret = _agmp_es_set_state(ctxt, AGMP_ES_STATE_EOS);
         break;
     }
     case GST_MESSAGE_ERROR:
     {
-        gboolean v_eos;
-        gboolean a_eos;
-        GError *err;
-        gchar *debug;
-
-        err = NULL;
-        debug = NULL;
-        gst_message_parse_error(message, &err, &debug);
-        if (!err || !debug)
-        {
-            if (err)
-                g_error_free(err);
-            if (debug)
-                g_free(debug);
-            GST_ERROR("Parse error msg err");
-            break;
-        }
-
-        v_eos = TRUE;
-        a_eos = TRUE;
-        if (ctxt->v_path.exist && !ctxt->v_path.src_data_eos)
-            v_eos = FALSE;
-        if (ctxt->a_path.exist && !ctxt->a_path.src_data_eos)
-            a_eos = FALSE;
-
-        if (err->domain == GST_STREAM_ERROR && (v_eos && a_eos))
-        {
-            GST_WARNING("Got stream error. But all streams are ended, so reporting EOS. Error code %d: %s (%s).", err->code, err->message, debug);
-            ret = _agmp_es_set_state(ctxt, AGMP_ES_STATE_EOS);
-        }
+        if (fast_handled)
+            GST_DEBUG("error already handled on posting thread");
         else
-        {
-            GST_ERROR("Error %d: %s (%s)", err->code, err->message, debug);
-            ret = _agmp_dispatch_error_msg(ctxt, AGMP_MSG_ERROR_DEC);
-        }
-        g_free(debug);
-        g_error_free(err);
+            ret = _agmp_es_handle_error(ctxt, message);
         break;
     }
     case GST_MESSAGE_STATE_CHANGED:
@@ -2174,16 +3023,10 @@ gboolean _agmp_es_bus_cb(GstBus *bus, GstMessage *message, gpointer user_data)
         if (GST_MESSAGE_SRC(message) == GST_OBJECT(ctxt->pipeline))
         {
             GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS(GST_BIN(ctxt->pipeline), GST_DEBUG_GRAPH_SHOW_ALL, "agmp-es.async-done");
-            GST_INFO("agmp-es state:%d, wait_preroll:%d", ctxt->state, ctxt->wait_preroll);
-            if ((AGMP_ES_STATE_PREROLL_AFTER_SEEK == ctxt->state || AGMP_ES_STATE_PREROLL_INIT == ctxt->state) && ctxt->wait_preroll)
-            {
-                GST_DEBUG("pipeline has been asynchronously switched to the pause state");
-                ret = _agmp_es_set_state(ctxt, AGMP_ES_STATE_PRESENT);
-                ctxt->paused_internal = FALSE;
-                ctxt->wait_preroll = FALSE;
-            }
+            if (fast_handled)
+                GST_DEBUG("async done already handled on posting thread");
             else
-                GST_ERROR("meet error here");
+                ret = _agmp_es_handle_async_done(ctxt);
         }
         break;
     }
@@ -2240,43 +3083,180 @@ gboolean _agmp_es_bus_cb(GstBus *bus, GstMessage *message, gpointer user_data)
     return ret;
 }
 
-gboolean _agmp_dispatch_data_msg(AgmpEsCtxt *ctxt, AgmpMsgType msg_type, AgmpEsType es_type, void *data_ptr)
+/*
+    runs on the thread posting the msg. eos, error and async done are handled here so the
+    resulting state msg is queued to upper-layer right away instead of after a round trip
+    through the bus watch. msgs are still passed on, _agmp_es_bus_cb skips the handled part.
+*/
+GstBusSyncReply _agmp_es_bus_sync_cb(GstBus *bus, GstMessage *message, gpointer user_data)
 {
-    gboolean ret;
-    AgmpMsg msg;
+    AgmpEsCtxt *ctxt;
+    gboolean handled;
 
     GST_TRACE("trace in");
 
-    if (G_UNLIKELY(msg_type < AGMP_MSG_DATA_NEED || msg_type > AGMP_MSG_DATA_STAT_HIGH))
-    {
-        GST_ERROR("error msg type:%d for data msg", msg_type);
-        goto errors;
-    }
+    ctxt = (AgmpEsCtxt *)user_data;
+    handled = FALSE;
 
-    if (ctxt->common_cfgs.serial_data_mode && AGMP_MSG_DATA_NEED == msg_type)
+    switch (GST_MESSAGE_TYPE(message))
     {
-        gint *data_waiting = NULL;
-
-        if (AGMP_VID == es_type)
-            data_waiting = &ctxt->v_path.data_waiting;
-        else if (AGMP_AUD == es_type)
-            data_waiting = &ctxt->a_path.data_waiting;
-        AGMP_ASSERT_FAIL_GOTO(data_waiting, errors, "meet error here. this ptr shouldn't be NULL.");
-
-        if (*data_waiting)
+    case GST_MESSAGE_EOS:
+    {
+        if (GST_MESSAGE_SRC(message) == GST_OBJECT(ctxt->pipeline))
         {
-            GST_INFO("type:%d skip this time", es_type);
-            ret = TRUE;
-            goto done;
+            _agmp_es_set_state(ctxt, AGMP_ES_STATE_EOS);
+            handled = TRUE;
         }
-        else
+        break;
+    }
+    case GST_MESSAGE_ERROR:
+    {
+        _agmp_es_handle_error(ctxt, message);
+        handled = TRUE;
+        break;
+    }
+    case GST_MESSAGE_ASYNC_DONE:
+    {
+        if (GST_MESSAGE_SRC(message) == GST_OBJECT(ctxt->pipeline))
         {
-            GST_INFO("type:%d schedule this time", es_type);
-            g_atomic_int_set(data_waiting, 1);
+            _agmp_es_handle_async_done(ctxt);
+            handled = TRUE;
         }
+        break;
     }
-
-    memset(&msg, 0, sizeof(msg));
+    default:
+        break;
+    }
+
+    if (handled)
+        gst_mini_object_set_qdata(GST_MINI_OBJECT_CAST(message), AGMP_ES_BUS_FAST_PATH_QUARK, GINT_TO_POINTER(TRUE), NULL);
+
+    GST_TRACE("trace out handled:%d", handled);
+    return GST_BUS_PASS;
+}
+
+gboolean _agmp_es_handle_error(AgmpEsCtxt *ctxt, GstMessage *message)
+{
+    gboolean ret;
+    gboolean v_eos;
+    gboolean a_eos;
+    GError *err;
+    gchar *debug;
+
+    GST_TRACE("trace in");
+
+    ret = TRUE;
+    err = NULL;
+    debug = NULL;
+    gst_message_parse_error(message, &err, &debug);
+    if (!err || !debug)
+    {
+        if (err)
+            g_error_free(err);
+        if (debug)
+            g_free(debug);
+        GST_ERROR("Parse error msg err");
+        goto done;
+    }
+
+    v_eos = TRUE;
+    a_eos = TRUE;
+    if (ctxt->v_path.exist && !ctxt->v_path.src_data_eos)
+        v_eos = FALSE;
+    if (ctxt->a_path.exist && !ctxt->a_path.src_data_eos)
+        a_eos = FALSE;
+
+    if (err->domain == GST_STREAM_ERROR && (v_eos && a_eos))
+    {
+        GST_WARNING("Got stream error. But all streams are ended, so reporting EOS. Error code %d: %s (%s).", err->code, err->message, debug);
+        ret = _agmp_es_set_state(ctxt, AGMP_ES_STATE_EOS);
+    }
+    else
+    {
+        GST_ERROR("Error %d: %s (%s)", err->code, err->message, debug);
+        ret = _agmp_dispatch_error_msg(ctxt, AGMP_MSG_ERROR_DEC);
+    }
+    g_free(debug);
+    g_error_free(err);
+
+done:
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+}
+
+gboolean _agmp_es_handle_async_done(AgmpEsCtxt *ctxt)
+{
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    ret = TRUE;
+
+    g_rec_mutex_lock(&ctxt->state_lock);
+    GST_INFO("agmp-es state:%d, wait_preroll:%d", ctxt->state, ctxt->wait_preroll);
+    /* may race with the bus watch or a new seek, only the one clearing wait_preroll goes on */
+    if ((AGMP_ES_STATE_PREROLL_AFTER_SEEK == ctxt->state || AGMP_ES_STATE_PREROLL_INIT == ctxt->state) &&
+        g_atomic_int_compare_and_exchange(&ctxt->wait_preroll, TRUE, FALSE))
+    {
+        GST_DEBUG("pipeline has been asynchronously switched to the pause state");
+        if (AGMP_ES_STATE_PREROLL_AFTER_SEEK == ctxt->state)
+        {
+            ctxt->seek_info.present_time = GST_TRACER_TS_US(ctxt);
+            GST_INFO("seek#%u done. flush:%lldus first push:%lldus first decoded:%lldus present:%lldus (relative to seek call)",
+                     ctxt->seek_info.seek_count,
+                     ctxt->seek_info.flush_done_time - ctxt->seek_info.seek_time,
+                     ctxt->seek_info.first_push_time - ctxt->seek_info.seek_time,
+                     ctxt->seek_info.first_decoded_time - ctxt->seek_info.seek_time,
+                     ctxt->seek_info.present_time - ctxt->seek_info.seek_time);
+        }
+        ret = _agmp_es_set_state(ctxt, AGMP_ES_STATE_PRESENT);
+        ctxt->paused_internal = FALSE;
+    }
+    else
+        GST_ERROR("meet error here");
+    g_rec_mutex_unlock(&ctxt->state_lock);
+
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+}
+
+gboolean _agmp_dispatch_data_msg(AgmpEsCtxt *ctxt, AgmpMsgType msg_type, AgmpEsType es_type, void *data_ptr)
+{
+    gboolean ret;
+    AgmpMsg msg;
+
+    GST_TRACE("trace in");
+
+    if (G_UNLIKELY(msg_type < AGMP_MSG_DATA_NEED || msg_type > AGMP_MSG_DATA_STAT_HIGH))
+    {
+        GST_ERROR("error msg type:%d for data msg", msg_type);
+        goto errors;
+    }
+
+    if (ctxt->common_cfgs.serial_data_mode && AGMP_MSG_DATA_NEED == msg_type)
+    {
+        gint *data_waiting = NULL;
+
+        if (AGMP_VID == es_type)
+            data_waiting = &ctxt->v_path.data_waiting;
+        else if (AGMP_AUD == es_type)
+            data_waiting = &ctxt->a_path.data_waiting;
+        AGMP_ASSERT_FAIL_GOTO(data_waiting, errors, "meet error here. this ptr shouldn't be NULL.");
+
+        if (*data_waiting)
+        {
+            GST_INFO("type:%d skip this time", es_type);
+            ret = TRUE;
+            goto done;
+        }
+        else
+        {
+            GST_INFO("type:%d schedule this time", es_type);
+            g_atomic_int_set(data_waiting, 1);
+        }
+    }
+
+    memset(&msg, 0, sizeof(msg));
     msg.type = msg_type;
     msg.body.data_state.type = es_type;
     msg.body.data_state.usr_data = data_ptr;
@@ -2356,6 +3336,28 @@ errors:
     goto done;
 }
 
+gboolean _agmp_dispatch_alert_msg(AgmpEsCtxt *ctxt, AgmpMsgType msg_type)
+{
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    if (G_UNLIKELY(msg_type != AGMP_MSG_AV_SYNC_ALERT))
+    {
+        GST_ERROR("error msg type:%d for alert msg", msg_type);
+        goto errors;
+    }
+
+    ret = _agmp_dispatch_msg_uncheck(ctxt, msg_type);
+
+done:
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+errors:
+    ret = FALSE;
+    goto done;
+}
+
 gboolean _agmp_dispatch_msg_uncheck(AgmpEsCtxt *ctxt, AgmpMsgType msg_type)
 {
     gboolean ret;
@@ -2395,7 +3397,7 @@ gboolean _agmp_dispatch_msg_on_mainloop(AgmpEsCtxt *ctxt, AgmpMsg *msg)
 
     memcpy(msg_send, msg, sizeof(AgmpMsg));
     msg_send->agmp_handle = ctxt;
-    msg_send->send_time = GST_TRACER_TS;
+    msg_send->send_time = GST_TRACER_TS(ctxt);
     msg_send->Scheduling_time = GST_CLOCK_TIME_NONE;
     msg_send->finish_time = GST_CLOCK_TIME_NONE;
     g_source_set_callback(src, (GSourceFunc)_agmp_es_gsource_cb, (gpointer)msg_send, (GDestroyNotify)g_free);
@@ -2447,7 +3449,7 @@ gboolean _agmp_es_gsource_cb(gpointer msg)
     ret = TRUE;
     extra_info = "void";
 
-    agmp_msg->Scheduling_time = GST_TRACER_TS;
+    agmp_msg->Scheduling_time = GST_TRACER_TS(ctxt);
     msg_schedule_dur = agmp_msg->Scheduling_time - agmp_msg->send_time;
     if (_agmp_es_is_data_msg(agmp_msg->type))
     {
@@ -2469,7 +3471,7 @@ gboolean _agmp_es_gsource_cb(gpointer msg)
     if (ctxt && ctxt->common_cfgs.msg_cb)
         (*ctxt->common_cfgs.msg_cb)(ctxt->common_cfgs.user_data, (void *)msg);
 
-    agmp_msg->finish_time = GST_TRACER_TS;
+    agmp_msg->finish_time = GST_TRACER_TS(ctxt);
     msg_process_dur = agmp_msg->finish_time - agmp_msg->send_time;
     GST_TRACE("[msg done] msg:< %d - %s(%s)> send time: %" GST_TIME_FORMAT " Scheduling time: %" GST_TIME_FORMAT " finish time: %" GST_TIME_FORMAT " duration: %" GST_TIME_FORMAT,
               agmp_msg->type, messages[agmp_msg->type].name, extra_info,
@@ -2510,6 +3512,8 @@ static gboolean _agmp_es_set_state(AgmpEsCtxt *ctxt, AgmpEsStateType state)
 
     ret = FALSE;
 
+    /* msgs are queued under the lock too, upper layer gets them in transition order */
+    g_rec_mutex_lock(&ctxt->state_lock);
     if (state == ctxt->state)
     {
         GST_DEBUG("state not change.");
@@ -2536,14 +3540,26 @@ static gboolean _agmp_es_set_state(AgmpEsCtxt *ctxt, AgmpEsStateType state)
     ret = _agmp_dispatch_state_msg(ctxt, msg_type);
 
 done:
+    g_rec_mutex_unlock(&ctxt->state_lock);
     GST_TRACE("trace out ret bool:%d", ret);
     return ret;
 }
 
+AgmpEsStateType _agmp_es_get_state(AgmpEsCtxt *ctxt)
+{
+    AgmpEsStateType state;
+
+    g_rec_mutex_lock(&ctxt->state_lock);
+    state = ctxt->state;
+    g_rec_mutex_unlock(&ctxt->state_lock);
+    return state;
+}
+
 gboolean _agmp_es_set_pipeline_state(AgmpEsCtxt *ctxt, GstState state)
 {
     GstStateChangeReturn result;
     gboolean ret;
+    gboolean prerolling;
 
     GST_TRACE("trace in");
 
@@ -2559,14 +3575,14 @@ gboolean _agmp_es_set_pipeline_state(AgmpEsCtxt *ctxt, GstState state)
         goto done;
     }
 
+    /* set before, async done may be posted before gst_element_set_state returns */
+    prerolling = GST_STATE(ctxt->pipeline) < GST_STATE_PAUSED && state == GST_STATE_PAUSED;
+    if (prerolling)
+        g_atomic_int_set(&ctxt->wait_preroll, TRUE);
     result = gst_element_set_state(ctxt->pipeline, state);
-    if ((GST_STATE(ctxt->pipeline) < GST_STATE_PAUSED) && (state == GST_STATE_PAUSED))
-    {
-        if (result == GST_STATE_CHANGE_ASYNC)
-            ctxt->wait_preroll = TRUE;
-        else
-            ctxt->wait_preroll = FALSE;
-    }
+    _agmp_es_late_anchor_reset(ctxt);
+    if (prerolling && result != GST_STATE_CHANGE_ASYNC)
+        g_atomic_int_set(&ctxt->wait_preroll, FALSE);
 
     GST_DEBUG("setted pipeline to state:%s, need_preroll_:%d, return:%s",
               gst_element_state_get_name(state),
@@ -2594,12 +3610,23 @@ gboolean _agmp_es_write_v(AgmpEsCtxt *ctxt, AgmpDataInfo *data_info)
     /* update flags for serial data mode */
     g_atomic_int_set(&ctxt->v_path.data_waiting, 0);
 
+    if (_agmp_es_drop_late(ctxt, data_info))
+    {
+        ctxt->v_path.late_frame_num++;
+        ret = _agmp_dispatch_data_msg(ctxt, AGMP_MSG_DATA_RELEASE, AGMP_VID, data_info->usr_data);
+        AGMP_ASSERT_FAIL_GOTO(ret, errors, "release vid meet error");
+        goto done;
+    }
+
     /* construct buf */
     AGMP_ASSERT_FAIL_GOTO((buf = _agmp_es_create_buf(ctxt, data_info)), errors, "create gst vid buf meet error.");
 
     /* decrypt buf */
     AGMP_ASSERT_FAIL_GOTO((_agmp_es_decrypt(ctxt, &buf)), errors, "decrypt gst vid buf meet error.");
 
+    if (!data_info->u.vinfo.keyframe)
+        GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
     /* free input sample */
     ret = _agmp_dispatch_data_msg(ctxt, AGMP_MSG_DATA_RELEASE, AGMP_VID, data_info->usr_data);
     AGMP_ASSERT_FAIL_GOTO(ret, errors, "release vid meet error");
@@ -2608,12 +3635,11 @@ gboolean _agmp_es_write_v(AgmpEsCtxt *ctxt, AgmpDataInfo *data_info)
     GST_INFO("push vid buf into appsrc with TS %" GST_TIME_FORMAT " cur max TS %" GST_TIME_FORMAT,
              GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buf)), GST_TIME_ARGS(ctxt->v_path.max_ts));
 
-    gst_app_src_push_buffer(GST_APP_SRC(ctxt->v_path.src), buf);
-
-    if (G_UNLIKELY(GST_CLOCK_TIME_NONE == ctxt->v_path.max_ts))
-        ctxt->v_path.max_ts = GST_BUFFER_TIMESTAMP(buf);
-    else
-        ctxt->v_path.max_ts = ctxt->v_path.max_ts > GST_BUFFER_TIMESTAMP(buf) ? ctxt->v_path.max_ts : GST_BUFFER_TIMESTAMP(buf);
+    if (G_UNLIKELY(ctxt->seek_info.seek_count && -1 == ctxt->seek_info.first_push_time))
+        ctxt->seek_info.first_push_time = GST_TRACER_TS_US(ctxt);
+    if (ctxt->ext_cfgs.low_latency_mode)
+        _agmp_es_latency_stamp(ctxt, GST_BUFFER_TIMESTAMP(buf));
+    _agmp_es_push_buf(ctxt, AGMP_VID, buf);
 
     ret = TRUE;
 
@@ -2627,7 +3653,6 @@ errors:
 
 gboolean _agmp_es_write_a(AgmpEsCtxt *ctxt, AgmpDataInfo *data_info)
 {
-    GstElement *src;
     GstBuffer *buf;
     gboolean ret;
 
@@ -2638,8 +3663,15 @@ gboolean _agmp_es_write_a(AgmpEsCtxt *ctxt, AgmpDataInfo *data_info)
     /* update flags for serial data mode */
     g_atomic_int_set(&ctxt->a_path.data_waiting, 0);
 
+    if (_agmp_es_drop_late(ctxt, data_info))
+    {
+        ctxt->a_path.late_frame_num++;
+        ret = _agmp_dispatch_data_msg(ctxt, AGMP_MSG_DATA_RELEASE, AGMP_AUD, data_info->usr_data);
+        AGMP_ASSERT_FAIL_GOTO(ret, errors, "release aud meet error");
+        goto done;
+    }
+
     /* construct buf */
-    src = ctxt->a_path.src;
     buf = gst_buffer_new_allocate(NULL, data_info->size, NULL);
     gst_buffer_fill(buf, 0, data_info->data, data_info->size);
     GST_BUFFER_TIMESTAMP(buf) = data_info->timestamp;
@@ -2652,12 +3684,9 @@ gboolean _agmp_es_write_a(AgmpEsCtxt *ctxt, AgmpDataInfo *data_info)
     GST_INFO("push aud buf into appsrc with TS %" GST_TIME_FORMAT " cur max TS %" GST_TIME_FORMAT,
              GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buf)), GST_TIME_ARGS(ctxt->a_path.max_ts));
 
-    gst_app_src_push_buffer(GST_APP_SRC(src), buf);
-
-    if (G_UNLIKELY(GST_CLOCK_TIME_NONE == ctxt->a_path.max_ts))
-        ctxt->a_path.max_ts = GST_BUFFER_TIMESTAMP(buf);
-    else
-        ctxt->a_path.max_ts = ctxt->a_path.max_ts > GST_BUFFER_TIMESTAMP(buf) ? ctxt->a_path.max_ts : GST_BUFFER_TIMESTAMP(buf);
+    if (G_UNLIKELY(ctxt->seek_info.seek_count && -1 == ctxt->seek_info.first_push_time))
+        ctxt->seek_info.first_push_time = GST_TRACER_TS_US(ctxt);
+    _agmp_es_push_buf(ctxt, AGMP_AUD, buf);
 
     ret = TRUE;
 
@@ -3118,7 +4147,7 @@ gboolean _agmp_es_appsrc_seek_data(GstAppSrc *src, guint64 offset, gpointer user
     ctxt = (AgmpEsCtxt *)user_data;
     ret = TRUE;
 
-    if (AGMP_ES_STATE_PREROLL_AFTER_SEEK != ctxt->state)
+    if (AGMP_ES_STATE_PREROLL_AFTER_SEEK != _agmp_es_get_state(ctxt))
     {
         GST_DEBUG_OBJECT(src, "Not seeking");
         ret = TRUE;
@@ -3334,6 +4363,7 @@ gboolean _agmp_es_monitor_cb(AgmpMonitorData *monitor_data)
     case AGMP_ES_MONITOR_STATUS:
     {
         _agmp_dispatch_status_msg(ctxt, AGMP_MSG_STATUS_UPDATE);
+        _agmp_es_av_sync_sample(ctxt);
         return G_SOURCE_CONTINUE;
     }
 #if 0
@@ -3448,12 +4478,15 @@ void _agmp_es_data_clear_status(AgmpEsCtxt *ctxt)
 {
     GST_TRACE("trace in");
 
+    _agmp_es_late_anchor_reset(ctxt);
+
     if (ctxt->v_path.exist)
     {
         ctxt->v_path.src_data_enough = FALSE;
         ctxt->v_path.src_data_eos = FALSE;
         ctxt->v_path.max_ts = GST_CLOCK_TIME_NONE;
         ctxt->v_path.dropped_frame_num = 0;
+        ctxt->v_path.catching_up = FALSE;
         g_atomic_int_set(&ctxt->v_path.data_waiting, 0);
     }
 
@@ -3465,6 +4498,43 @@ void _agmp_es_data_clear_status(AgmpEsCtxt *ctxt)
         g_atomic_int_set(&ctxt->a_path.data_waiting, 0);
     }
 
+    _agmp_es_latency_reset(ctxt);
+
+    g_mutex_lock(&ctxt->av_sync_lock);
+    agmp_av_sync_reset(&ctxt->av_sync);
+    g_mutex_unlock(&ctxt->av_sync_lock);
+
+    GST_TRACE("trace out");
+}
+
+void _agmp_es_av_sync_sample(AgmpEsCtxt *ctxt)
+{
+    gboolean alert;
+
+    GST_TRACE("trace in");
+
+    alert = FALSE;
+
+    if (!ctxt->v_path.exist || !ctxt->a_path.exist || ctxt->common_cfgs.pip_mode)
+        goto done;
+
+    g_mutex_lock(&ctxt->av_sync_lock);
+    if (!ctxt->av_vtap)
+        ctxt->av_vtap = agmp_av_sync_tap_new(ctxt->v_path.sink);
+    if (!ctxt->av_atap)
+        ctxt->av_atap = agmp_av_sync_tap_new(ctxt->a_path.sink);
+    if (agmp_av_sync_sample(&ctxt->av_sync, ctxt->pipeline, ctxt->av_vtap, ctxt->av_atap))
+        alert = agmp_av_sync_check_bound(&ctxt->av_sync, ctxt->ext_cfgs.av_sync_bound * G_TIME_SPAN_MILLISECOND);
+    if (alert)
+        GST_WARNING("av offset %lld(us) over bound %lld(ms), jitter %lld(us), drift %.1f(ppm)",
+                    ctxt->av_sync.offset, ctxt->ext_cfgs.av_sync_bound,
+                    ctxt->av_sync.jitter, ctxt->av_sync.drift);
+    g_mutex_unlock(&ctxt->av_sync_lock);
+
+    if (alert)
+        _agmp_dispatch_alert_msg(ctxt, AGMP_MSG_AV_SYNC_ALERT);
+
+done:
     GST_TRACE("trace out");
 }
 
@@ -3508,6 +4578,788 @@ done:
     return pos;
 }
 
+void _agmp_es_lock_elements(AgmpEsCtxt *ctxt, gboolean lock)
+{
+    GstElement *elements[4];
+    guint i;
+
+    GST_TRACE("trace in");
+
+    /* decoders and sinks hold the hardware, they stay in NULL while locked whatever the pipeline does */
+    elements[0] = ctxt->v_path.exist ? ctxt->v_path.decoder : NULL;
+    elements[1] = ctxt->v_path.exist ? ctxt->v_path.sink : NULL;
+    elements[2] = ctxt->a_path.exist ? ctxt->a_path.decoder : NULL;
+    elements[3] = ctxt->a_path.exist ? ctxt->a_path.sink : NULL;
+
+    for (i = 0; i < G_N_ELEMENTS(elements); i++)
+    {
+        if (!elements[i])
+            continue;
+
+        gst_element_set_locked_state(elements[i], lock);
+        if (lock)
+            gst_element_set_state(elements[i], GST_STATE_NULL);
+        GST_DEBUG("%s %s", lock ? "released" : "restored", GST_ELEMENT_NAME(elements[i]));
+    }
+
+    GST_TRACE("trace out");
+}
+
+void _agmp_es_push_buf(AgmpEsCtxt *ctxt, AgmpEsType type, GstBuffer *buf)
+{
+    GstElement *src;
+    GstClockTime *max_ts;
+    GstClockTime ts;
+
+    GST_TRACE("trace in");
+
+    src = (AGMP_VID == type) ? ctxt->v_path.src : ctxt->a_path.src;
+    max_ts = (AGMP_VID == type) ? &ctxt->v_path.max_ts : &ctxt->a_path.max_ts;
+    ts = GST_BUFFER_TIMESTAMP(buf);
+
+    /*
+        retain and push under retain lock, so that a seek can't flush appsrc
+        and replay retained samples in between. appsrc doesn't block on push.
+    */
+    g_mutex_lock(&ctxt->retain_lock);
+    _agmp_es_retain_buf(ctxt, type, buf);
+    gst_app_src_push_buffer(GST_APP_SRC(src), buf);
+
+    if (G_UNLIKELY(GST_CLOCK_TIME_NONE == *max_ts))
+        *max_ts = ts;
+    else
+        *max_ts = *max_ts > ts ? *max_ts : ts;
+    g_mutex_unlock(&ctxt->retain_lock);
+
+    GST_TRACE("trace out ret void");
+}
+
+/* called with retain lock held */
+void _agmp_es_retain_buf(AgmpEsCtxt *ctxt, AgmpEsType type, GstBuffer *buf)
+{
+    GQueue *retained;
+    GList *next_key;
+    GstBuffer *head;
+    GstClockTime window;
+    GstClockTime newest;
+
+    GST_TRACE("trace in");
+
+    if (!GST_CLOCK_TIME_IS_VALID(GST_BUFFER_TIMESTAMP(buf)))
+        goto done;
+
+    retained = (AGMP_VID == type) ? &ctxt->v_path.retained : &ctxt->a_path.retained;
+    newest = GST_BUFFER_TIMESTAMP(buf);
+
+    /*
+        retention is off by default, and secure bufs must not pin secure memory across suspend.
+        only keyframe pts are kept then, so that resume can ask for the data again
+    */
+    if (ctxt->ext_cfgs.retention_window <= 0 || ctxt->common_cfgs.secure_mode)
+    {
+        if (AGMP_VID == type && !GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT))
+        {
+            if (AGMP_ES_RETAIN_KEY_NUM == ctxt->v_path.key_ts_num)
+            {
+                memmove(ctxt->v_path.key_ts, ctxt->v_path.key_ts + 1, (AGMP_ES_RETAIN_KEY_NUM - 1) * sizeof(GstClockTime));
+                ctxt->v_path.key_ts_num--;
+            }
+            ctxt->v_path.key_ts[ctxt->v_path.key_ts_num++] = newest;
+        }
+        goto done;
+    }
+
+    /* video window must start from a keyframe, or it can't be replayed */
+    if (AGMP_VID == type && g_queue_is_empty(retained) && GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT))
+        goto done;
+
+    /* appsrc takes the ownership of buf, retain by an extra ref instead of copying */
+    g_queue_push_tail(retained, gst_buffer_ref(buf));
+
+    /*
+        suspend needs the samples from the keyframe before the position to re-preroll,
+        samples still queued in the pipeline are at most data_ctl.max_v/max_a ahead of it
+    */
+    window = ctxt->ext_cfgs.retention_window * GST_MSECOND;
+
+    if (AGMP_VID == type)
+    {
+        window = MAX(window, ctxt->data_ctl.max_v * GST_MSECOND);
+
+        /* drop whole gops while the next one still starts before the window, the window keeps its keyframe */
+        for (;;)
+        {
+            for (next_key = retained->head->next; next_key; next_key = next_key->next)
+            {
+                if (!GST_BUFFER_FLAG_IS_SET((GstBuffer *)next_key->data, GST_BUFFER_FLAG_DELTA_UNIT))
+                    break;
+            }
+            if (!next_key || GST_BUFFER_TIMESTAMP((GstBuffer *)next_key->data) + window > newest)
+                break;
+            while (retained->head != next_key)
+                gst_buffer_unref((GstBuffer *)g_queue_pop_head(retained));
+        }
+    }
+    else
+    {
+        window = MAX(window, ctxt->data_ctl.max_a * GST_MSECOND);
+
+        /* audio has to cover the retained video to replay with it */
+        head = (GstBuffer *)g_queue_peek_head(&ctxt->v_path.retained);
+        if (ctxt->v_path.exist && head && GST_BUFFER_TIMESTAMP(head) < newest)
+            window = MAX(window, newest - GST_BUFFER_TIMESTAMP(head));
+
+        while ((head = (GstBuffer *)g_queue_peek_head(retained)) && GST_BUFFER_TIMESTAMP(head) + window < newest)
+            gst_buffer_unref((GstBuffer *)g_queue_pop_head(retained));
+    }
+
+done:
+    GST_TRACE("trace out ret void");
+}
+
+void _agmp_es_retain_clear(AgmpEsCtxt *ctxt)
+{
+    GST_TRACE("trace in");
+
+    g_queue_foreach(&ctxt->v_path.retained, (GFunc)gst_buffer_unref, NULL);
+    g_queue_clear(&ctxt->v_path.retained);
+    g_queue_foreach(&ctxt->a_path.retained, (GFunc)gst_buffer_unref, NULL);
+    g_queue_clear(&ctxt->a_path.retained);
+    ctxt->v_path.key_ts_num = 0;
+    ctxt->v_path.resume_ts = GST_CLOCK_TIME_NONE;
+    ctxt->a_path.resume_ts = GST_CLOCK_TIME_NONE;
+
+    GST_TRACE("trace out ret void");
+}
+
+gboolean _agmp_es_retain_lookup(AgmpEsCtxt *ctxt, GstClockTime pos, GList **v_start, GList **a_start)
+{
+    GList *l;
+    GstClockTime v_max;
+    GstClockTime a_max;
+    GstClockTime replay_from;
+    gboolean ret;
+
+    GST_TRACE("trace in");
+
+    *v_start = *a_start = NULL;
+    v_max = a_max = 0;
+    replay_from = pos;
+    ret = FALSE;
+
+    if (ctxt->ext_cfgs.retention_window <= 0 || ctxt->common_cfgs.secure_mode)
+        goto done;
+    /* upper layer has to re-send eos after seek, retained samples can't replay it */
+    if ((ctxt->v_path.exist && ctxt->v_path.src_data_eos) || (ctxt->a_path.exist && ctxt->a_path.src_data_eos))
+        goto done;
+
+    if (ctxt->v_path.exist)
+    {
+        /* nearest prior keyframe, bufs are in decode order so scan the whole window */
+        for (l = ctxt->v_path.retained.head; l; l = l->next)
+        {
+            GstBuffer *buf = (GstBuffer *)l->data;
+            if (!GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT) && GST_BUFFER_TIMESTAMP(buf) <= pos)
+                *v_start = l;
+            v_max = MAX(v_max, GST_BUFFER_TIMESTAMP(buf));
+        }
+        if (!*v_start || v_max < pos)
+            goto done;
+        replay_from = GST_BUFFER_TIMESTAMP((GstBuffer *)(*v_start)->data);
+    }
+
+    if (ctxt->a_path.exist)
+    {
+        for (l = ctxt->a_path.retained.head; l; l = l->next)
+        {
+            GstBuffer *buf = (GstBuffer *)l->data;
+            if (GST_BUFFER_TIMESTAMP(buf) <= replay_from)
+                *a_start = l;
+            a_max = MAX(a_max, GST_BUFFER_TIMESTAMP(buf));
+        }
+        if (!*a_start || a_max < pos)
+            goto done;
+    }
+
+    ret = ctxt->v_path.exist || ctxt->a_path.exist;
+    GST_DEBUG("pos %" GST_TIME_FORMAT " inside retention window, replay from %" GST_TIME_FORMAT,
+              GST_TIME_ARGS(pos), GST_TIME_ARGS(replay_from));
+
+done:
+    if (!ret)
+        *v_start = *a_start = NULL;
+    GST_TRACE("trace out ret bool:%d", ret);
+    return ret;
+}
+
+/* called with retain lock held, GST_CLOCK_TIME_NONE if no keyframe pts is kept for pos */
+GstClockTime _agmp_es_retain_key_before(AgmpEsCtxt *ctxt, GstClockTime pos)
+{
+    GstClockTime ret;
+    guint i;
+
+    GST_TRACE("trace in");
+
+    ret = GST_CLOCK_TIME_NONE;
+
+    if (!GST_CLOCK_TIME_IS_VALID(pos))
+        goto done;
+
+    for (i = 0; i < ctxt->v_path.key_ts_num; i++)
+    {
+        if (ctxt->v_path.key_ts[i] <= pos && (!GST_CLOCK_TIME_IS_VALID(ret) || ctxt->v_path.key_ts[i] > ret))
+            ret = ctxt->v_path.key_ts[i];
+    }
+
+done:
+    GST_TRACE("trace out ret GstClockTime:%" GST_TIME_FORMAT, GST_TIME_ARGS(ret));
+    return ret;
+}
+
+void _agmp_es_retain_replay(AgmpEsCtxt *ctxt, GList *v_start, GList *a_start)
+{
+    GList *l;
+    guint v_cnt, a_cnt;
+
+    GST_TRACE("trace in");
+
+    v_cnt = a_cnt = 0;
+
+    for (l = v_start; l; l = l->next, v_cnt++)
+    {
+        GstBuffer *buf = (GstBuffer *)l->data;
+        GstClockTime ts = GST_BUFFER_TIMESTAMP(buf);
+
+        gst_app_src_push_buffer(GST_APP_SRC(ctxt->v_path.src), gst_buffer_ref(buf));
+        if (GST_CLOCK_TIME_NONE == ctxt->v_path.max_ts || ctxt->v_path.max_ts < ts)
+            ctxt->v_path.max_ts = ts;
+    }
+    ctxt->v_path.resume_ts = ctxt->v_path.max_ts;
+
+    for (l = a_start; l; l = l->next, a_cnt++)
+    {
+        GstBuffer *buf = (GstBuffer *)l->data;
+        GstClockTime ts = GST_BUFFER_TIMESTAMP(buf);
+
+        gst_app_src_push_buffer(GST_APP_SRC(ctxt->a_path.src), gst_buffer_ref(buf));
+        if (GST_CLOCK_TIME_NONE == ctxt->a_path.max_ts || ctxt->a_path.max_ts < ts)
+            ctxt->a_path.max_ts = ts;
+    }
+    ctxt->a_path.resume_ts = ctxt->a_path.max_ts;
+
+    GST_INFO("replayed %u vid bufs up to %" GST_TIME_FORMAT ", %u aud bufs up to %" GST_TIME_FORMAT,
+             v_cnt, GST_TIME_ARGS(ctxt->v_path.resume_ts), a_cnt, GST_TIME_ARGS(ctxt->a_path.resume_ts));
+
+    GST_TRACE("trace out ret void");
+}
+
+void _agmp_es_seek_watch_output(AgmpEsCtxt *ctxt)
+{
+    GstElement *element;
+    GstPad *pad;
+
+    GST_TRACE("trace in");
+
+    /* a probe of previous seek still waiting will report for this seek */
+    if (ctxt->seek_probe_id)
+        goto done;
+
+    /* audio passthrough path has no decoder, take the sink input as decoder output */
+    if (ctxt->v_path.exist)
+        element = ctxt->v_path.decoder;
+    else if (ctxt->a_path.exist)
+        element = ctxt->a_path.decoder ? ctxt->a_path.decoder : ctxt->a_path.sink;
+    else
+        element = NULL;
+    AGMP_ASSERT_FAIL_GOTO(element, done, "no element to watch decoded output.");
+
+    pad = gst_element_get_static_pad(element, ctxt->v_path.exist || ctxt->a_path.decoder ? "src" : "sink");
+    AGMP_ASSERT_FAIL_GOTO(pad, done, "get pad for watching decoded output failed.");
+
+    if (ctxt->seek_probe_pad)
+        gst_object_unref(ctxt->seek_probe_pad);
+    ctxt->seek_probe_pad = pad;
+    ctxt->seek_probe_id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, _agmp_es_seek_output_probe_cb, ctxt, NULL);
+
+done:
+    GST_TRACE("trace out ret void");
+}
+
+GstPadProbeReturn _agmp_es_seek_output_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    AgmpEsCtxt *ctxt;
+
+    ctxt = (AgmpEsCtxt *)user_data;
+
+    ctxt->seek_info.first_decoded_time = GST_TRACER_TS_US(ctxt);
+    ctxt->seek_probe_id = 0;
+    GST_DEBUG_OBJECT(pad, "first decoded output after seek#%u at %lldus",
+                     ctxt->seek_info.seek_count, ctxt->seek_info.first_decoded_time);
+
+    return GST_PAD_PROBE_REMOVE;
+}
+
+void _agmp_es_snap_prepare(AgmpEsCtxt *ctxt)
+{
+    gboolean snap;
+    GstPad *a_pad;
+
+    GST_TRACE("trace in");
+
+    /* only video has non-key frames, audio only follows where video snapped to */
+    snap = AGMP_SEEK_MODE_KEY_UNIT_SNAP_BEFORE == ctxt->seek_mode && ctxt->v_path.exist;
+    a_pad = ctxt->a_path.exist ? gst_element_get_static_pad(ctxt->a_path.src, "src") : NULL;
+
+    g_mutex_lock(&ctxt->snap_lock);
+    ctxt->snap_seqnum++;
+    ctxt->v_path.snap_pending = snap;
+    ctxt->a_path.snap_pending = snap && a_pad;
+    gst_segment_init(&ctxt->v_path.snap_segment, GST_FORMAT_UNDEFINED);
+    gst_segment_init(&ctxt->a_path.snap_segment, GST_FORMAT_UNDEFINED);
+    ctxt->snap_decided = FALSE;
+    ctxt->snap_ts = GST_CLOCK_TIME_NONE;
+
+    /*
+        block aud bufs rather than waiting in the probe, a blocked pad is released by
+        the flush of next seek. the probe of previous seek is kept if still there
+    */
+    if (ctxt->a_path.snap_pending && !ctxt->snap_hold_id)
+        ctxt->snap_hold_id = gst_pad_add_probe(a_pad, GST_PAD_PROBE_TYPE_BLOCK | GST_PAD_PROBE_TYPE_BUFFER,
+                                               _agmp_es_snap_hold_cb, ctxt, NULL);
+    else if (!ctxt->a_path.snap_pending && ctxt->snap_hold_id)
+    {
+        gst_pad_remove_probe(a_pad, ctxt->snap_hold_id);
+        ctxt->snap_hold_id = 0;
+    }
+    g_mutex_unlock(&ctxt->snap_lock);
+
+    if (a_pad)
+        gst_object_unref(a_pad);
+
+    GST_TRACE("trace out ret void");
+}
+
+GstPadProbeReturn _agmp_es_snap_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    AgmpEsCtxt *ctxt;
+    gboolean is_vid;
+    gboolean *snap_pending;
+    GstSegment *snap_segment;
+    GstSegment segment;
+    GstClockTime snap_ts;
+    gboolean push;
+
+    ctxt = (AgmpEsCtxt *)user_data;
+    is_vid = GST_PAD_PARENT(pad) == GST_OBJECT(ctxt->v_path.src);
+    snap_pending = is_vid ? &ctxt->v_path.snap_pending : &ctxt->a_path.snap_pending;
+    snap_segment = is_vid ? &ctxt->v_path.snap_segment : &ctxt->a_path.snap_segment;
+
+    if (G_LIKELY(!*snap_pending))
+        return GST_PAD_PROBE_OK;
+
+    if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+    {
+        GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+
+        /* hold back the segment after seek, it will be resent once the snapped start is known */
+        if (GST_EVENT_SEGMENT == GST_EVENT_TYPE(event))
+        {
+            g_mutex_lock(&ctxt->snap_lock);
+            push = !*snap_pending;
+            if (!push)
+                gst_event_copy_segment(event, snap_segment);
+            g_mutex_unlock(&ctxt->snap_lock);
+            return push ? GST_PAD_PROBE_OK : GST_PAD_PROBE_DROP;
+        }
+
+        if (is_vid && GST_EVENT_EOS == GST_EVENT_TYPE(event))
+        {
+            GST_WARNING_OBJECT(pad, "eos before any keyframe, keep seek position");
+            _agmp_es_snap_decide(ctxt, pad, GST_CLOCK_TIME_NONE);
+        }
+        return GST_PAD_PROBE_OK;
+    }
+
+    if (is_vid)
+    {
+        GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER(info);
+
+        /* can't be decoded anyway, snap to the first keyframe instead */
+        if (GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT))
+        {
+            GST_DEBUG_OBJECT(pad, "drop non-key buf %" GST_TIME_FORMAT " before snapping", GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(buf)));
+            return GST_PAD_PROBE_DROP;
+        }
+        _agmp_es_snap_decide(ctxt, pad, GST_BUFFER_TIMESTAMP(buf));
+        return GST_PAD_PROBE_OK;
+    }
+
+    /*
+        audio segment held after video decided is sent from here,
+        before that bufs are blocked by the hold probe and video resends the segment
+    */
+    g_mutex_lock(&ctxt->snap_lock);
+    push = *snap_pending && ctxt->snap_decided;
+    if (push)
+    {
+        *snap_pending = FALSE;
+        gst_segment_copy_into(snap_segment, &segment);
+        snap_ts = ctxt->snap_ts;
+    }
+    g_mutex_unlock(&ctxt->snap_lock);
+
+    if (push)
+        _agmp_es_snap_push_segment(pad, &segment, snap_ts);
+
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn _agmp_es_snap_hold_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    GST_DEBUG_OBJECT(pad, "hold aud buf until video decides where to snap");
+    return GST_PAD_PROBE_OK;
+}
+
+void _agmp_es_snap_decide(AgmpEsCtxt *ctxt, GstPad *v_pad, GstClockTime ts)
+{
+    GstSegment v_segment, a_segment;
+    gboolean push_v, push_a;
+    GstClockTime snap_ts;
+    guint32 seqnum;
+    gulong hold_id;
+    GstPad *a_pad;
+
+    GST_TRACE("trace in");
+
+    push_v = push_a = FALSE;
+    snap_ts = GST_CLOCK_TIME_NONE;
+    seqnum = 0;
+    hold_id = 0;
+
+    g_mutex_lock(&ctxt->snap_lock);
+    if (!ctxt->v_path.snap_pending)
+    {
+        g_mutex_unlock(&ctxt->snap_lock);
+        goto done;
+    }
+    seqnum = ctxt->snap_seqnum;
+    ctxt->v_path.snap_pending = FALSE;
+
+    push_v = GST_FORMAT_TIME == ctxt->v_path.snap_segment.format;
+    if (push_v)
+    {
+        gst_segment_copy_into(&ctxt->v_path.snap_segment, &v_segment);
+        if (GST_CLOCK_TIME_IS_VALID(ts) && ts < v_segment.start)
+            snap_ts = ts;
+    }
+    else
+        GST_WARNING_OBJECT(v_pad, "no time segment held, keep seek position");
+    ctxt->snap_ts = snap_ts;
+    ctxt->snap_decided = TRUE;
+
+    /* audio segment arrived already, its bufs wait in the hold probe */
+    if (ctxt->a_path.snap_pending && GST_FORMAT_TIME == ctxt->a_path.snap_segment.format)
+    {
+        gst_segment_copy_into(&ctxt->a_path.snap_segment, &a_segment);
+        ctxt->a_path.snap_pending = FALSE;
+        push_a = TRUE;
+    }
+    hold_id = ctxt->snap_hold_id;
+    ctxt->snap_hold_id = 0;
+    g_mutex_unlock(&ctxt->snap_lock);
+
+    if (push_v)
+        _agmp_es_snap_push_segment(v_pad, &v_segment, snap_ts);
+
+    if (!push_a && !hold_id)
+        goto done;
+
+    a_pad = gst_element_get_static_pad(ctxt->a_path.src, "src");
+
+    /* pushed outside snap lock, a seek may have come in meanwhile */
+    g_mutex_lock(&ctxt->snap_lock);
+    if (seqnum != ctxt->snap_seqnum)
+    {
+        GST_DEBUG_OBJECT(v_pad, "snap#%u is outdated by snap#%u", seqnum, ctxt->snap_seqnum);
+        push_a = FALSE;
+    }
+    g_mutex_unlock(&ctxt->snap_lock);
+
+    if (push_a)
+        _agmp_es_snap_push_segment(a_pad, &a_segment, snap_ts);
+    if (hold_id)
+        gst_pad_remove_probe(a_pad, hold_id);
+    gst_object_unref(a_pad);
+
+done:
+    GST_TRACE("trace out ret void");
+}
+
+void _agmp_es_snap_push_segment(GstPad *pad, GstSegment *segment, GstClockTime snap_ts)
+{
+    GstEvent *event;
+
+    if (GST_FORMAT_TIME != segment->format)
+    {
+        GST_WARNING_OBJECT(pad, "refuse to push segment of format %s", gst_format_get_name(segment->format));
+        return;
+    }
+
+    if (GST_CLOCK_TIME_IS_VALID(snap_ts) && snap_ts < segment->start)
+    {
+        GST_INFO_OBJECT(pad, "snap segment start from %" GST_TIME_FORMAT " to keyframe %" GST_TIME_FORMAT,
+                        GST_TIME_ARGS(segment->start), GST_TIME_ARGS(snap_ts));
+        segment->time = snap_ts + (segment->time - segment->start);
+        segment->start = snap_ts;
+        segment->position = snap_ts;
+    }
+
+    if ((event = gst_event_new_segment(segment)))
+        gst_pad_push_event(pad, event);
+}
+
+void _agmp_es_low_latency_config(AgmpEsCtxt *ctxt)
+{
+    GstClockTime target;
+
+    GST_TRACE("trace in");
+
+    _agmp_es_latency_reset(ctxt);
+
+    if (!ctxt->ext_cfgs.low_latency_mode)
+        goto done;
+
+    /* keep only latency target worth of data queued, and ask for more well before it drains */
+    target = ctxt->ext_cfgs.latency_target;
+    ctxt->data_ctl.min_v = ctxt->data_ctl.min_a = target / 2;
+    ctxt->data_ctl.max_v = ctxt->data_ctl.max_a = target;
+    GST_INFO("low latency mode. target %" G_GINT64_FORMAT "ms", ctxt->ext_cfgs.latency_target);
+
+done:
+    GST_TRACE("trace out ret void");
+}
+
+void _agmp_es_low_latency_config_src(AgmpEsCtxt *ctxt, GstElement *src)
+{
+    GST_TRACE("trace in");
+
+    /* appsrc bounds its queue by time since 1.20, byte limit still applies as an upper bound */
+    if (ctxt->ext_cfgs.low_latency_mode && g_object_class_find_property(G_OBJECT_GET_CLASS(src), "max-time"))
+    {
+        g_object_set(G_OBJECT(src), "max-time", (guint64)(ctxt->ext_cfgs.latency_target * GST_MSECOND), NULL);
+        GST_DEBUG_OBJECT(src, "cfg max time:%" G_GINT64_FORMAT "ms", ctxt->ext_cfgs.latency_target);
+    }
+
+    GST_TRACE("trace out ret void");
+}
+
+void _agmp_es_low_latency_config_sink(AgmpEsCtxt *ctxt, GstElement *sink)
+{
+    GObjectClass *klass;
+
+    GST_TRACE("trace in");
+
+    if (!ctxt->ext_cfgs.low_latency_mode)
+        goto done;
+
+    klass = G_OBJECT_GET_CLASS(sink);
+    if (g_object_class_find_property(klass, "max-lateness"))
+        g_object_set(G_OBJECT(sink), "max-lateness", (gint64)(AGMP_ES_LOW_LATENCY_MAX_LATENESS * GST_MSECOND), NULL);
+    if (g_object_class_find_property(klass, "qos"))
+        g_object_set(G_OBJECT(sink), "qos", TRUE, NULL);
+    if (g_object_class_find_property(klass, "render-delay"))
+        g_object_set(G_OBJECT(sink), "render-delay", (guint64)0, NULL);
+    /* audio must not hold back rendering until video shows up */
+    if (g_object_class_find_property(klass, "wait-video"))
+        g_object_set(G_OBJECT(sink), "wait-video", FALSE, NULL);
+    GST_DEBUG_OBJECT(sink, "cfg max lateness:%dms", AGMP_ES_LOW_LATENCY_MAX_LATENESS);
+
+done:
+    GST_TRACE("trace out ret void");
+}
+
+/*
+    a sample written after its render time has passed is dropped before it is pushed.
+    video can't skip a single frame, so after a late one every frame is dropped
+    until a keyframe that is in time again.
+*/
+gboolean _agmp_es_drop_late(AgmpEsCtxt *ctxt, AgmpDataInfo *data_info)
+{
+    GstClockTime position;
+    gboolean late;
+    gboolean drop;
+
+    if (!ctxt->ext_cfgs.low_latency_mode)
+        return FALSE;
+
+    late = FALSE;
+    if (GST_STATE(ctxt->pipeline) == GST_STATE_PLAYING &&
+        (position = _agmp_es_late_position(ctxt)) != GST_CLOCK_TIME_NONE)
+        late = (GstClockTime)data_info->timestamp + AGMP_ES_LOW_LATENCY_MAX_LATENESS * GST_MSECOND < position;
+
+    if (AGMP_AUD == data_info->type)
+        drop = late;
+    else if (late)
+    {
+        if (!ctxt->v_path.catching_up)
+            GST_INFO("vid sample %" GST_TIME_FORMAT " is late. drop frames until next keyframe", GST_TIME_ARGS(data_info->timestamp));
+        ctxt->v_path.catching_up = TRUE;
+        drop = TRUE;
+    }
+    else if (ctxt->v_path.catching_up && data_info->u.vinfo.keyframe)
+    {
+        GST_INFO("caught up at keyframe %" GST_TIME_FORMAT ", %u frames dropped as late so far",
+                 GST_TIME_ARGS(data_info->timestamp), ctxt->v_path.late_frame_num);
+        ctxt->v_path.catching_up = FALSE;
+        drop = FALSE;
+    }
+    else
+        drop = ctxt->v_path.catching_up;
+
+    if (drop)
+        GST_LOG("drop late %s sample %" GST_TIME_FORMAT, AGMP_AUD == data_info->type ? "aud" : "vid", GST_TIME_ARGS(data_info->timestamp));
+
+    return drop;
+}
+
+/*
+    position for the per sample late check. a position query walks the whole pipeline,
+    so it is only done every AGMP_ES_LATE_ANCHOR_INTERVAL and moved on with the clock in between.
+*/
+GstClockTime _agmp_es_late_position(AgmpEsCtxt *ctxt)
+{
+    GstClock *clock;
+    GstClockTime now;
+    GstClockTime pos;
+
+    clock = gst_element_get_clock(ctxt->pipeline);
+    if (!clock)
+        return GST_CLOCK_TIME_NONE;
+    now = gst_clock_get_time(clock);
+    gst_object_unref(clock);
+
+    g_mutex_lock(&ctxt->latency_lock);
+    if (GST_CLOCK_TIME_IS_VALID(ctxt->late_anchor_clock) && ctxt->play_rate > 0 && now >= ctxt->late_anchor_clock &&
+        now - ctxt->late_anchor_clock < AGMP_ES_LATE_ANCHOR_INTERVAL * GST_MSECOND)
+    {
+        pos = ctxt->late_anchor_pos + (GstClockTime)((now - ctxt->late_anchor_clock) * ctxt->play_rate);
+        g_mutex_unlock(&ctxt->latency_lock);
+        return pos;
+    }
+    g_mutex_unlock(&ctxt->latency_lock);
+
+    pos = _agmp_es_get_position(ctxt);
+
+    g_mutex_lock(&ctxt->latency_lock);
+    ctxt->late_anchor_pos = pos;
+    ctxt->late_anchor_clock = GST_CLOCK_TIME_IS_VALID(pos) ? now : GST_CLOCK_TIME_NONE;
+    g_mutex_unlock(&ctxt->latency_lock);
+
+    return pos;
+}
+
+/* position jumps or stops moving with the clock: seek, flush, state change */
+void _agmp_es_late_anchor_reset(AgmpEsCtxt *ctxt)
+{
+    g_mutex_lock(&ctxt->latency_lock);
+    ctxt->late_anchor_clock = GST_CLOCK_TIME_NONE;
+    g_mutex_unlock(&ctxt->latency_lock);
+}
+
+void _agmp_es_latency_stamp(AgmpEsCtxt *ctxt, GstClockTime ts)
+{
+    AgmpEsLatencyStamp *stamp;
+
+    g_mutex_lock(&ctxt->latency_lock);
+    stamp = &ctxt->v_path.stamps[ctxt->v_path.stamp_idx];
+    stamp->ts = ts;
+    stamp->write_time = g_get_monotonic_time();
+    ctxt->v_path.stamp_idx = (ctxt->v_path.stamp_idx + 1) % AGMP_ES_LATENCY_STAMPS;
+    g_mutex_unlock(&ctxt->latency_lock);
+}
+
+void _agmp_es_latency_reset(AgmpEsCtxt *ctxt)
+{
+    guint i;
+
+    g_mutex_lock(&ctxt->latency_lock);
+    for (i = 0; i < AGMP_ES_LATENCY_STAMPS; i++)
+        ctxt->v_path.stamps[i].ts = GST_CLOCK_TIME_NONE;
+    ctxt->v_path.stamp_idx = 0;
+    ctxt->latency = ctxt->avg_latency = ctxt->max_latency = -1;
+    g_mutex_unlock(&ctxt->latency_lock);
+}
+
+/*
+    latency of a frame is taken when it reaches video sink: time already spent since it was
+    written plus how long sink still holds it before the clock reaches its running time.
+*/
+GstPadProbeReturn _agmp_es_latency_probe_cb(GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+    AgmpEsCtxt *ctxt;
+    GstBuffer *buf;
+    GstClockTime ts;
+    GstClockTime running_time;
+    GstEvent *event;
+    GstClock *clock;
+    gint64 write_time;
+    gint64 wait;
+    gint64 latency;
+    guint i;
+
+    ctxt = (AgmpEsCtxt *)user_data;
+    buf = GST_PAD_PROBE_INFO_BUFFER(info);
+    ts = GST_BUFFER_PTS(buf);
+    if (!GST_CLOCK_TIME_IS_VALID(ts))
+        goto done;
+
+    write_time = -1;
+    g_mutex_lock(&ctxt->latency_lock);
+    for (i = 0; i < AGMP_ES_LATENCY_STAMPS; i++)
+    {
+        if (ctxt->v_path.stamps[i].ts == ts)
+        {
+            write_time = ctxt->v_path.stamps[i].write_time;
+            break;
+        }
+    }
+    g_mutex_unlock(&ctxt->latency_lock);
+    if (-1 == write_time)
+        goto done;
+
+    wait = 0;
+    if ((event = gst_pad_get_sticky_event(pad, GST_EVENT_SEGMENT, 0)))
+    {
+        const GstSegment *segment;
+
+        gst_event_parse_segment(event, &segment);
+        running_time = gst_segment_to_running_time(segment, GST_FORMAT_TIME, ts);
+        if (GST_CLOCK_TIME_IS_VALID(running_time) && (clock = gst_element_get_clock(ctxt->pipeline)))
+        {
+            GstClockTime render_time = gst_element_get_base_time(ctxt->pipeline) + running_time;
+            GstClockTime now = gst_clock_get_time(clock);
+
+            if (render_time > now)
+                wait = (render_time - now) / GST_USECOND;
+            gst_object_unref(clock);
+        }
+        gst_event_unref(event);
+    }
+    latency = g_get_monotonic_time() - write_time + wait;
+
+    g_mutex_lock(&ctxt->latency_lock);
+    ctxt->latency = latency;
+    ctxt->avg_latency = ctxt->avg_latency < 0 ? latency : (ctxt->avg_latency * 7 + latency) / 8;
+    if (latency > ctxt->max_latency)
+        ctxt->max_latency = latency;
+    g_mutex_unlock(&ctxt->latency_lock);
+
+    GST_LOG_OBJECT(pad, "vid frame %" GST_TIME_FORMAT " latency %" G_GINT64_FORMAT "us", GST_TIME_ARGS(ts), latency);
+
+done:
+    return GST_PAD_PROBE_OK;
+}
+
 /* static inline functions */
 inline gboolean _agmp_es_data_has_enough(AgmpEsCtxt *ctxt)
 {
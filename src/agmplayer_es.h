@@ -33,9 +33,25 @@ extern "C" {
 #include "agmplayer_es_video_color_metadata.h"
 
 AGMP_ES_HANDLE agmp_es_create(AgmpEsCfg *cfg);
+/*
+    description:
+        use this func instead of agmp_es_create to also pass configs added after the first release.
+    params:
+        cfg: same as agmp_es_create
+        ext_cfg: filled by agmp_es_acquire_ext_cfgs then changed by upper layer, NULL for defaults
+*/
+AGMP_ES_HANDLE agmp_es_create_ext(AgmpEsCfg *cfg, AgmpEsExtCfg *ext_cfg);
 void agmp_es_destroy(AGMP_ES_HANDLE handle);
 
 BOOL agmp_es_acquire_cfgs(AGMP_ES_HANDLE handle, AgmpEsCfg *cfg);
+/*
+    description:
+        same as agmp_es_acquire_cfgs for AgmpEsExtCfg, defaults if handle is NULL.
+    params:
+        handle: agmp-es handle or NULL
+        ext_cfg: ext_cfg->size must be set to sizeof(AgmpEsExtCfg) before calling
+*/
+BOOL agmp_es_acquire_ext_cfgs(AGMP_ES_HANDLE handle, AgmpEsExtCfg *ext_cfg);
 
 BOOL agmp_es_start(AGMP_ES_HANDLE handle);
 BOOL agmp_es_stop(AGMP_ES_HANDLE handle);
@@ -59,9 +75,58 @@ BOOL agmp_es_write(AGMP_ES_HANDLE handle, AgmpDataInfo *data_info);
         pos: seek to postion in ms
 */
 BOOL agmp_es_seek(AGMP_ES_HANDLE handle, double rate, int64_t pos);
+/*
+    description:
+        use this func after agmp_es_seek to know where upper layer should resume writing.
+        if the seek landed inside the retention window, agmp-es already replayed the retained
+        samples and upper layer should only write samples after the returned timestamp.
+    params:
+        handle: agmp-es handle
+        type: es type
+    return:
+        timestamp in ns of the last replayed sample,
+        -1 if the seek flushed all samples and upper layer should write from the seek position
+*/
+int64_t agmp_es_get_resume_timestamp(AGMP_ES_HANDLE handle, AgmpEsType type);
+/*
+    description:
+        use this func to choose how following seeks position the playback.
+        AGMP_SEEK_MODE_KEY_UNIT_SNAP_BEFORE starts rendering from the first keyframe
+        written after seek instead of decoding and discarding frames up to seek position.
+    params:
+        handle: agmp-es handle
+        mode: seek mode, default AGMP_SEEK_MODE_ACCURATE
+*/
+BOOL agmp_es_set_seek_mode(AGMP_ES_HANDLE handle, AgmpEsSeekMode mode);
+/*
+    description:
+        use this func when upper layer goes to background instead of agmp_es_destroy.
+        decoders and sinks are taken to NULL to free hardware and secure memory,
+        pipeline, caps, position and retained samples are kept.
+        without retained samples the position is moved back to the latest keyframe
+        before it, so upper layer writes again from that keyframe after resume.
+        samples written while suspended are released and rejected.
+        play, pause, seek and rate calls while suspended are recorded and applied on resume.
+    params:
+        handle: agmp-es handle
+*/
+BOOL agmp_es_suspend(AGMP_ES_HANDLE handle);
+/*
+    description:
+        use this func to come back from agmp_es_suspend.
+        agmp-es re-prerolls at the suspended position, replaying retained samples
+        if the position is inside the retention window, and plays if it was playing.
+        upper layer resumes writing after agmp_es_get_resume_timestamp like after agmp_es_seek.
+    params:
+        handle: agmp-es handle
+*/
+BOOL agmp_es_resume(AGMP_ES_HANDLE handle);
 
 AgmpEsStateType agmp_es_get_state(AGMP_ES_HANDLE handle);
 BOOL agmp_es_get_play_info(AGMP_ES_HANDLE handle, AgmpPlayInfo *play_info);
+BOOL agmp_es_get_seek_info(AGMP_ES_HANDLE handle, AgmpSeekInfo *seek_info);
+BOOL agmp_es_get_latency_info(AGMP_ES_HANDLE handle, AgmpLatencyInfo *latency_info);
+BOOL agmp_es_get_av_sync_info(AGMP_ES_HANDLE handle, AgmpAvSyncInfo *av_sync_info);
 
 int64_t agmp_es_data_get_time_level(AGMP_ES_HANDLE handle, AgmpEsType type);
 
@@ -29,6 +29,7 @@ typedef struct _AgmpEsCfg AgmpEsCfg;
 typedef struct _AgmpEsCommonCfg AgmpEsCommonCfg;
 typedef struct _AgmpEsVidCfg AgmpEsVidCfg;
 typedef struct _AgmpEsAudCfg AgmpEsAudCfg;
+typedef struct _AgmpEsExtCfg AgmpEsExtCfg;
 
 /* cfgs struct */
 struct _AgmpEsCommonCfg
@@ -156,6 +157,55 @@ struct _AgmpEsAudCfg
     AgmpAudFormatInfo format_info;
 };
 
+/*
+    configs added after the first release, passed to agmp_es_create_ext.
+    kept out of AgmpEsCfg so that its layout stays the same for apps built against older headers.
+*/
+struct _AgmpEsExtCfg
+{
+    /*
+        sizeof(AgmpEsExtCfg) the upper layer is built with, must be set before
+        agmp_es_acquire_ext_cfgs. fields beyond it keep their defaults.
+        new fields are only appended at the end.
+    */
+    uint32_t size;
+
+    /*
+        time window(ms) of samples agmp-es keeps after pushing them into pipeline.
+        a seek landing inside this window is replayed from the nearest prior keyframe
+        of the retained samples, upper layer only needs to resume writing samples after
+        the timestamp returned by agmp_es_get_resume_timestamp.
+        agmp_es_resume re-prerolls from this window the same way.
+        ignored in secure mode, secure samples are not kept across agmp_es_suspend.
+        default 0 for disable.
+    */
+    int64_t retention_window;
+
+    /*
+        low latency profile for cloud gaming and low latency live.
+        appsrc queues are bounded to latency_target, no internal pause on low data,
+        sinks drop frames later than 20ms, samples already late when written are dropped
+        and video catches up by dropping frames until the next keyframe in time.
+        per frame latency is reported by agmp_es_get_latency_info.
+        default 0 for disable.
+    */
+    BOOL low_latency_mode;
+
+    /*
+        time(ms) of data agmp-es keeps queued in low latency mode.
+        default 100.
+    */
+    int64_t latency_target;
+
+    /*
+        agmp-es will send AGMP_MSG_AV_SYNC_ALERT when rendered a/v offset goes over this (ms),
+        and again only after it came back below half of it.
+        offset is sampled every status_update_interval, see agmp_es_get_av_sync_info.
+        default 0 for disable.
+    */
+    int64_t av_sync_bound;
+};
+
 struct _AgmpEsCfg
 {
     AgmpEsCommonCfg common_cfgs; // agmp-es common configs
@@ -38,6 +38,9 @@ typedef struct _AgmpDrmDataInfo AgmpDrmDataInfo;
 typedef struct _AgmpDrmEncPattern AgmpDrmEncPattern;
 typedef struct _AgmpDrmSubSampleMapping AgmpDrmSubSampleMapping;
 
+typedef struct _AgmpSeekInfo AgmpSeekInfo;
+typedef struct _AgmpLatencyInfo AgmpLatencyInfo;
+typedef struct _AgmpAvSyncInfo AgmpAvSyncInfo;
 typedef struct _AgmpPlayInfo AgmpPlayInfo;
 
 /* format infos */
@@ -186,6 +189,47 @@ struct _AgmpDataInfo
 };
 
 /* play infos */
+/*
+    lifecycle timestamps of the latest seek.
+    all times are in us since agmp-es created, -1 if that stage is not reached yet.
+*/
+struct _AgmpSeekInfo
+{
+    uint32_t seek_count; // seeks done since agmp-es created
+
+    int64_t seek_time;          // agmp_es_seek called
+    int64_t flush_done_time;    // pipeline flushed and ready for new samples
+    int64_t first_push_time;    // first sample pushed into pipeline after seek
+    int64_t first_decoded_time; // first frame output by decoder after seek
+    int64_t present_time;       // ASYNC_DONE received and agmp-es switched to PRESENT
+};
+
+/*
+    measured in low latency mode, from agmp_es_write to the time video frame is rendered.
+    all in us, -1 if not measured.
+*/
+struct _AgmpLatencyInfo
+{
+    int64_t latency;         // latest rendered frame
+    int64_t avg_latency;     // moving average over latest frames
+    int64_t max_latency;     // max since start or latest seek
+    int late_dropped_frames; // samples dropped at ingest for being late
+};
+
+/*
+    a/v sync of rendered samples, the buffers reaching both sinks timed against the
+    pipeline clock, sampled every status_update_interval while playing. reset on seek and flush.
+    offset and jitter in us, drift in ppm. av_sync_samples is 0 if nothing measured yet.
+*/
+struct _AgmpAvSyncInfo
+{
+    int64_t av_offset;     // how much later video is rendered than audio, positive when audio leads
+    int64_t av_jitter;     // smoothed change of offset between samples
+    double av_drift;       // rate offset changes at against the pipeline clock
+    int64_t av_max_offset; // max absolute offset since start or latest seek
+    int av_sync_samples;
+};
+
 struct _AgmpPlayInfo
 {
     gint64 duration; // ms
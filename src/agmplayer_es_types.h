@@ -48,6 +48,8 @@ typedef enum AgmpMsgType
 
     AGMP_MSG_ERROR_DEC,
     AGMP_MSG_ERROR_CAP_CHG,
+
+    AGMP_MSG_AV_SYNC_ALERT, // rendered a/v offset went over av_sync_bound, details by agmp_es_get_av_sync_info
 } AgmpMsgType;
 
 typedef enum AgmpEsStateType
@@ -61,6 +63,12 @@ typedef enum AgmpEsStateType
     AGMP_ES_STATE_DESTROY,
 } AgmpEsStateType;
 
+typedef enum AgmpEsSeekMode
+{
+    AGMP_SEEK_MODE_ACCURATE,             // render from exactly the seek position
+    AGMP_SEEK_MODE_KEY_UNIT_SNAP_BEFORE, // render from the keyframe before the seek position
+} AgmpEsSeekMode;
+
 typedef enum AgmpVidCodecType
 {
     VCODEC_NONE,
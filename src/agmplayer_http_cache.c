@@ -0,0 +1,779 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+#include "agmplayer.h"
+#include "agmplayer_http_cache.h"
+
+GST_DEBUG_CATEGORY_STATIC (agmp_http_cache_debug);
+#define GST_CAT_DEFAULT agmp_http_cache_debug
+
+#define HTTP_CACHE_INDEX "index"
+
+/* properties of souphttpsrc set by applications in source-setup and by adaptive demuxers,
+ * kept here and handed to souphttpsrc whenever it's the child */
+enum
+{
+  PROP_0,
+  PROP_USER_AGENT,
+  PROP_COOKIES,
+  PROP_EXTRA_HEADERS,
+  PROP_PROXY,
+  PROP_PROXY_ID,
+  PROP_PROXY_PW,
+  PROP_USER_ID,
+  PROP_USER_PW,
+  PROP_SSL_STRICT,
+  PROP_SSL_CA_FILE,
+  PROP_SSL_USE_SYSTEM_CA_FILE,
+  PROP_TIMEOUT,
+  PROP_RETRIES,
+  PROP_COMPRESS,
+  PROP_KEEP_ALIVE,
+  PROP_AUTOMATIC_REDIRECT,
+  PROP_IS_LIVE,
+  PROP_IRADIO_MODE,
+  PROP_LAST
+};
+
+static GParamSpec *properties[PROP_LAST];
+
+typedef struct
+{
+  guint64 start;
+  guint64 end;                  /* exclusive */
+} HttpRange;
+
+/* configuration and index, shared by all elements */
+static GMutex cache_lock;
+static gchar *cache_dir = NULL;
+static guint64 cache_max_bytes = 0;
+static GKeyFile *cache_index = NULL;
+
+struct _AgmpHttpCache
+{
+  GstBin parent;
+
+  gchar *uri;
+  gchar *key;                   /* sha1 of the uri, names the entry and its data file */
+  GstElement *child;            /* filesrc on a hit, souphttpsrc otherwise */
+  GstPad *srcpad;
+  GstStructure *child_props;    /* souphttpsrc properties set on us, by name */
+
+  /* recording what souphttpsrc delivers, only on a miss */
+  gint fd;
+  gboolean cacheable;
+  guint64 position;
+  gint64 size;                  /* -1 until known */
+  GArray *ranges;               /* HttpRange, sorted and merged */
+
+  /* freshness, what the last response said */
+  gchar *etag;
+  gchar *last_modified;
+  gint64 expires;               /* s since epoch, 0 when it must be asked again */
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static void agmp_http_cache_uri_handler_init (gpointer g_iface, gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (AgmpHttpCache, agmp_http_cache, GST_TYPE_BIN,
+    G_IMPLEMENT_INTERFACE (GST_TYPE_URI_HANDLER, agmp_http_cache_uri_handler_init));
+
+static void http_ranges_add (GArray *ranges, guint64 start, guint64 end)
+{
+  HttpRange r = { start, end };
+  guint i = 0;
+
+  while (i < ranges->len) {
+    HttpRange *cur = &g_array_index (ranges, HttpRange, i);
+
+    if (cur->end < r.start) {
+      i++;
+      continue;
+    }
+    if (cur->start > r.end)
+      break;
+    r.start = MIN (r.start, cur->start);
+    r.end = MAX (r.end, cur->end);
+    g_array_remove_index (ranges, i);
+  }
+  g_array_insert_val (ranges, i, r);
+}
+
+static gchar *http_ranges_to_string (GArray *ranges)
+{
+  GString *str = g_string_new (NULL);
+  guint i;
+
+  for (i = 0; i < ranges->len; i++) {
+    HttpRange *r = &g_array_index (ranges, HttpRange, i);
+
+    g_string_append_printf (str, "%s%" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT,
+        i ? ";" : "", r->start, r->end);
+  }
+  return g_string_free (str, FALSE);
+}
+
+static void http_ranges_from_string (GArray *ranges, const gchar *str)
+{
+  gchar **parts;
+  guint i;
+
+  g_array_set_size (ranges, 0);
+  if (!str || !*str)
+    return;
+  parts = g_strsplit (str, ";", -1);
+  for (i = 0; parts[i]; i++) {
+    guint64 start, end;
+
+    if (sscanf (parts[i], "%" G_GUINT64_FORMAT "-%" G_GUINT64_FORMAT, &start, &end) == 2 && end > start)
+      http_ranges_add (ranges, start, end);
+  }
+  g_strfreev (parts);
+}
+
+static guint64 http_ranges_bytes (GArray *ranges)
+{
+  guint64 bytes = 0;
+  guint i;
+
+  for (i = 0; i < ranges->len; i++)
+    bytes += g_array_index (ranges, HttpRange, i).end - g_array_index (ranges, HttpRange, i).start;
+  return bytes;
+}
+
+/* call with cache_lock held */
+static gchar *http_cache_data_path (const gchar *key)
+{
+  gchar *name = g_strconcat (key, ".data", NULL);
+  gchar *path = g_build_filename (cache_dir, name, NULL);
+
+  g_free (name);
+  return path;
+}
+
+/* call with cache_lock held */
+static void http_cache_save_index (void)
+{
+  gchar *path = g_build_filename (cache_dir, HTTP_CACHE_INDEX, NULL);
+  GError *err = NULL;
+
+  if (!g_key_file_save_to_file (cache_index, path, &err)) {
+    GST_WARNING ("save %s failed: %s", path, err->message);
+    g_clear_error (&err);
+  }
+  g_free (path);
+}
+
+/* call with cache_lock held */
+static void http_cache_drop (const gchar *key)
+{
+  gchar *data = http_cache_data_path (key);
+
+  g_unlink (data);
+  g_key_file_remove_group (cache_index, key, NULL);
+  g_free (data);
+}
+
+/* call with cache_lock held, least recently used go first, keep is spared */
+static void http_cache_evict (const gchar *keep)
+{
+  gchar **groups;
+  gsize n_groups, i;
+  guint64 total = 0;
+
+  groups = g_key_file_get_groups (cache_index, &n_groups);
+  for (i = 0; i < n_groups; i++)
+    total += g_key_file_get_uint64 (cache_index, groups[i], "bytes", NULL);
+
+  while (total > cache_max_bytes) {
+    gint64 oldest = G_MAXINT64;
+    gchar *victim = NULL;
+
+    for (i = 0; i < n_groups; i++) {
+      gint64 used;
+
+      if (!groups[i][0] || !g_strcmp0 (groups[i], keep))
+        continue;
+      used = g_key_file_get_int64 (cache_index, groups[i], "used", NULL);
+      if (used < oldest) {
+        oldest = used;
+        victim = groups[i];
+      }
+    }
+    if (!victim)
+      break;
+    GST_INFO ("evicting %s", victim);
+    total -= g_key_file_get_uint64 (cache_index, victim, "bytes", NULL);
+    http_cache_drop (victim);
+    victim[0] = '\0';
+  }
+  g_strfreev (groups);
+}
+
+/* NULL unless the whole resource is on disk and still fresh per Cache-Control.
+ * a stale entry keeps its ranges and validators, the response decides whether they stay */
+static gchar *http_cache_lookup (AgmpHttpCache *self)
+{
+  gchar *path = NULL, *ranges_str;
+  gint64 size, now = g_get_real_time () / G_USEC_PER_SEC;
+  GStatBuf st;
+
+  g_mutex_lock (&cache_lock);
+  if (!cache_dir || !g_key_file_has_group (cache_index, self->key)) {
+    g_mutex_unlock (&cache_lock);
+    return NULL;
+  }
+
+  size = g_key_file_get_int64 (cache_index, self->key, "size", NULL);
+  ranges_str = g_key_file_get_string (cache_index, self->key, "ranges", NULL);
+  http_ranges_from_string (self->ranges, ranges_str);
+  g_free (ranges_str);
+  self->etag = g_key_file_get_string (cache_index, self->key, "etag", NULL);
+  self->last_modified = g_key_file_get_string (cache_index, self->key, "last-modified", NULL);
+  self->expires = g_key_file_get_int64 (cache_index, self->key, "expires", NULL);
+  g_key_file_set_int64 (cache_index, self->key, "used", now);
+
+  if (now >= self->expires) {
+    GST_DEBUG_OBJECT (self, "%s is stale, asking the server", self->uri);
+  } else if (size > 0 && self->ranges->len == 1 && g_array_index (self->ranges, HttpRange, 0).start == 0
+      && g_array_index (self->ranges, HttpRange, 0).end == (guint64) size) {
+    path = http_cache_data_path (self->key);
+    if (g_stat (path, &st) != 0 || st.st_size < size) {
+      http_cache_drop (self->key);
+      http_cache_save_index ();
+      g_array_set_size (self->ranges, 0);
+      g_free (path);
+      path = NULL;
+    }
+  }
+  if (path)
+    http_cache_save_index ();
+  g_mutex_unlock (&cache_lock);
+
+  return path;
+}
+
+/* store what this session fetched */
+static void http_cache_commit (AgmpHttpCache *self)
+{
+  gchar *ranges_str;
+  gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+
+  if (!self->cacheable) {
+    /* whatever an earlier response left is no good either */
+    g_mutex_lock (&cache_lock);
+    if (cache_dir && g_key_file_has_group (cache_index, self->key)) {
+      http_cache_drop (self->key);
+      http_cache_save_index ();
+    }
+    g_mutex_unlock (&cache_lock);
+    return;
+  }
+  if (self->ranges->len == 0)
+    return;
+
+  ranges_str = http_ranges_to_string (self->ranges);
+  g_mutex_lock (&cache_lock);
+  if (cache_dir) {
+    g_key_file_set_string (cache_index, self->key, "uri", self->uri);
+    if (self->etag)
+      g_key_file_set_string (cache_index, self->key, "etag", self->etag);
+    else
+      g_key_file_remove_key (cache_index, self->key, "etag", NULL);
+    if (self->last_modified)
+      g_key_file_set_string (cache_index, self->key, "last-modified", self->last_modified);
+    else
+      g_key_file_remove_key (cache_index, self->key, "last-modified", NULL);
+    g_key_file_set_int64 (cache_index, self->key, "expires", self->expires);
+    g_key_file_set_string (cache_index, self->key, "ranges", ranges_str);
+    g_key_file_set_int64 (cache_index, self->key, "size", self->size);
+    g_key_file_set_uint64 (cache_index, self->key, "bytes", http_ranges_bytes (self->ranges));
+    g_key_file_set_int64 (cache_index, self->key, "used", now);
+    http_cache_evict (self->key);
+    http_cache_save_index ();
+  }
+  g_mutex_unlock (&cache_lock);
+
+  GST_DEBUG_OBJECT (self, "%s: %s of %" G_GINT64_FORMAT, self->uri, ranges_str, self->size);
+  g_free (ranges_str);
+}
+
+/* seconds of "name=<n>" in a Cache-Control value, -1 if missing */
+static gint64 http_cache_control_seconds (const gchar *control, const gchar *name)
+{
+  const gchar *p = control;
+  gsize len = strlen (name);
+
+  while ((p = strstr (p, name))) {
+    if ((p == control || p[-1] == ' ' || p[-1] == ',') && p[len] == '=')
+      return g_ascii_strtoll (p + len + 1, NULL, 10);
+    p += len;
+  }
+  return -1;
+}
+
+static const gchar *http_cache_header (const GstStructure *headers, const gchar *name, const gchar *alt)
+{
+  const gchar *value = gst_structure_get_string (headers, name);
+
+  return value ? value : gst_structure_get_string (headers, alt);
+}
+
+/* freshness and validators of the response. different validators than what's on disk
+ * mean the resource changed, the data recorded before is dropped */
+static void http_cache_check_headers (AgmpHttpCache *self, const GstStructure *s)
+{
+  const GValue *value = gst_structure_get_value (s, "response-headers");
+  const GstStructure *headers;
+  const gchar *type, *control, *etag, *last_modified, *age;
+  gint64 max_age;
+
+  if (!value || !GST_VALUE_HOLDS_STRUCTURE (value))
+    return;
+  headers = gst_value_get_structure (value);
+  type = gst_structure_get_string (headers, "Content-Type");
+  control = http_cache_header (headers, "Cache-Control", "cache-control");
+  if ((type && (strstr (type, "mpegurl") || strstr (type, "dash+xml")))
+      || (control && (strstr (control, "no-store") || strstr (control, "private")))) {
+    GST_DEBUG_OBJECT (self, "%s isn't cacheable", self->uri);
+    self->cacheable = FALSE;
+    return;
+  }
+
+  etag = http_cache_header (headers, "ETag", "Etag");
+  last_modified = http_cache_header (headers, "Last-Modified", "last-modified");
+  if ((self->etag || self->last_modified)
+      && (!(etag || last_modified) || g_strcmp0 (etag, self->etag) != 0
+          || g_strcmp0 (last_modified, self->last_modified) != 0)) {
+    GST_DEBUG_OBJECT (self, "%s changed on the server", self->uri);
+    g_array_set_size (self->ranges, 0);
+    if (ftruncate (self->fd, 0) != 0)
+      self->cacheable = FALSE;
+  }
+  g_free (self->etag);
+  g_free (self->last_modified);
+  self->etag = g_strdup (etag);
+  self->last_modified = g_strdup (last_modified);
+
+  /* only served from disk while max-age says so, everything else goes to the server */
+  max_age = control && !strstr (control, "no-cache") ? http_cache_control_seconds (control, "max-age") : -1;
+  if (max_age > 0) {
+    age = http_cache_header (headers, "Age", "age");
+    if (age)
+      max_age -= g_ascii_strtoll (age, NULL, 10);
+    self->expires = max_age > 0 ? g_get_real_time () / G_USEC_PER_SEC + max_age : 0;
+  } else {
+    self->expires = 0;
+  }
+
+  /* without a validator a stale copy can't be told apart from a changed one */
+  if (!etag && !last_modified && self->expires == 0) {
+    GST_DEBUG_OBJECT (self, "%s has neither validators nor max-age", self->uri);
+    self->cacheable = FALSE;
+  }
+}
+
+static GstPadProbeReturn http_cache_record (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+  AgmpHttpCache *self = user_data;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+    guint64 offset = GST_BUFFER_OFFSET_IS_VALID (buf) ? GST_BUFFER_OFFSET (buf) : self->position;
+    GstMapInfo map;
+
+    if (self->cacheable && self->fd >= 0 && gst_buffer_map (buf, &map, GST_MAP_READ)) {
+      if (pwrite (self->fd, map.data, map.size, offset) == (ssize_t) map.size)
+        http_ranges_add (self->ranges, offset, offset + map.size);
+      else
+        self->cacheable = FALSE;
+      gst_buffer_unmap (buf, &map);
+    }
+    self->position = offset + gst_buffer_get_size (buf);
+  } else {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+    const GstSegment *segment;
+
+    switch (GST_EVENT_TYPE (event)) {
+      case GST_EVENT_SEGMENT:
+        gst_event_parse_segment (event, &segment);
+        if (segment->format == GST_FORMAT_BYTES)
+          self->position = segment->start;
+        break;
+      case GST_EVENT_CUSTOM_DOWNSTREAM_STICKY:
+        if (gst_event_has_name (event, "http-headers"))
+          http_cache_check_headers (self, gst_event_get_structure (event));
+        break;
+      case GST_EVENT_EOS:
+        if (!gst_element_query_duration (self->child, GST_FORMAT_BYTES, &self->size))
+          self->cacheable = FALSE;
+        break;
+      default:
+        break;
+    }
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean http_cache_forward_prop (GQuark field, const GValue *value, gpointer user_data)
+{
+  AgmpHttpCache *self = user_data;
+  const gchar *name = g_quark_to_string (field);
+
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (self->child), name))
+    g_object_set_property (G_OBJECT (self->child), name, value);
+  return TRUE;
+}
+
+static gboolean http_cache_setup (AgmpHttpCache *self)
+{
+  gchar *path, *data, *lower;
+  GstPad *pad;
+
+  if (!self->uri)
+    return FALSE;
+
+  g_array_set_size (self->ranges, 0);
+  g_clear_pointer (&self->etag, g_free);
+  g_clear_pointer (&self->last_modified, g_free);
+  self->expires = 0;
+  self->size = -1;
+  self->position = 0;
+  self->fd = -1;
+
+  path = http_cache_lookup (self);
+  if (path) {
+    GST_INFO_OBJECT (self, "serving %s from %s", self->uri, path);
+    self->child = gst_element_factory_make ("filesrc", NULL);
+    if (self->child)
+      g_object_set (self->child, "location", path, NULL);
+    g_free (path);
+  } else {
+    self->child = gst_element_factory_make ("souphttpsrc", NULL);
+    if (self->child) {
+      g_object_set (self->child, "location", self->uri, NULL);
+      gst_structure_foreach (self->child_props, http_cache_forward_prop, self);
+    }
+
+    /* playlists change under the same uri */
+    lower = g_ascii_strdown (self->uri, -1);
+    self->cacheable = !strstr (lower, ".m3u8") && !strstr (lower, ".mpd");
+    g_free (lower);
+
+    g_mutex_lock (&cache_lock);
+    if (self->cacheable && cache_dir) {
+      data = http_cache_data_path (self->key);
+      self->fd = g_open (data, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+      g_free (data);
+    }
+    g_mutex_unlock (&cache_lock);
+  }
+  if (!self->child)
+    return FALSE;
+
+  gst_bin_add (GST_BIN (self), self->child);
+  pad = gst_element_get_static_pad (self->child, "src");
+  gst_ghost_pad_set_target (GST_GHOST_PAD (self->srcpad), pad);
+  if (self->fd >= 0)
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+        http_cache_record, self, NULL);
+  gst_object_unref (pad);
+
+  return TRUE;
+}
+
+static void http_cache_teardown (AgmpHttpCache *self)
+{
+  if (self->fd >= 0) {
+    http_cache_commit (self);
+    close (self->fd);
+    self->fd = -1;
+  }
+  if (self->child) {
+    gst_ghost_pad_set_target (GST_GHOST_PAD (self->srcpad), NULL);
+    gst_element_set_state (self->child, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (self), self->child);
+    self->child = NULL;
+  }
+}
+
+static GstStateChangeReturn agmp_http_cache_change_state (GstElement *element, GstStateChange transition)
+{
+  AgmpHttpCache *self = AGMP_HTTP_CACHE (element);
+  GstStateChangeReturn ret;
+
+  if (transition == GST_STATE_CHANGE_NULL_TO_READY && !http_cache_setup (self)) {
+    GST_ELEMENT_ERROR (self, CORE, MISSING_PLUGIN, (NULL), ("no source for %s", self->uri));
+    return GST_STATE_CHANGE_FAILURE;
+  }
+
+  ret = GST_ELEMENT_CLASS (agmp_http_cache_parent_class)->change_state (element, transition);
+
+  if (transition == GST_STATE_CHANGE_READY_TO_NULL
+      || (transition == GST_STATE_CHANGE_NULL_TO_READY && ret == GST_STATE_CHANGE_FAILURE))
+    http_cache_teardown (self);
+
+  return ret;
+}
+
+static void agmp_http_cache_finalize (GObject *object)
+{
+  AgmpHttpCache *self = AGMP_HTTP_CACHE (object);
+
+  g_array_unref (self->ranges);
+  gst_structure_free (self->child_props);
+  g_free (self->etag);
+  g_free (self->last_modified);
+  g_free (self->uri);
+  g_free (self->key);
+
+  G_OBJECT_CLASS (agmp_http_cache_parent_class)->finalize (object);
+}
+
+static void agmp_http_cache_set_property (GObject *object, guint prop_id,
+    const GValue *value, GParamSpec *pspec)
+{
+  AgmpHttpCache *self = AGMP_HTTP_CACHE (object);
+  GstElement *child = NULL;
+
+  if (prop_id == PROP_0 || prop_id >= PROP_LAST) {
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    return;
+  }
+
+  GST_OBJECT_LOCK (self);
+  gst_structure_set_value (self->child_props, pspec->name, value);
+  if (self->child)
+    child = gst_object_ref (self->child);
+  GST_OBJECT_UNLOCK (self);
+
+  /* a running souphttpsrc takes most of them for its next request */
+  if (child) {
+    if (g_object_class_find_property (G_OBJECT_GET_CLASS (child), pspec->name))
+      g_object_set_property (G_OBJECT (child), pspec->name, value);
+    gst_object_unref (child);
+  }
+}
+
+static void agmp_http_cache_get_property (GObject *object, guint prop_id,
+    GValue *value, GParamSpec *pspec)
+{
+  AgmpHttpCache *self = AGMP_HTTP_CACHE (object);
+  const GValue *stored;
+
+  if (prop_id == PROP_0 || prop_id >= PROP_LAST) {
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    return;
+  }
+
+  GST_OBJECT_LOCK (self);
+  stored = gst_structure_get_value (self->child_props, pspec->name);
+  if (stored)
+    g_value_copy (stored, value);
+  else
+    g_param_value_set_default (pspec, value);
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void agmp_http_cache_class_init (AgmpHttpCacheClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  const GParamFlags flags = G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS;
+
+  gobject_class->set_property = agmp_http_cache_set_property;
+  gobject_class->get_property = agmp_http_cache_get_property;
+  gobject_class->finalize = agmp_http_cache_finalize;
+
+  /* same names, types and defaults as souphttpsrc */
+  properties[PROP_USER_AGENT] = g_param_spec_string ("user-agent", "User-Agent",
+      "Value of the User-Agent HTTP request header field", NULL, flags);
+  properties[PROP_COOKIES] = g_param_spec_boxed ("cookies", "Cookies",
+      "HTTP request cookies", G_TYPE_STRV, flags);
+  properties[PROP_EXTRA_HEADERS] = g_param_spec_boxed ("extra-headers", "Extra Headers",
+      "Extra headers to append to the HTTP request", GST_TYPE_STRUCTURE, flags);
+  properties[PROP_PROXY] = g_param_spec_string ("proxy", "Proxy",
+      "HTTP proxy server URI", NULL, flags);
+  properties[PROP_PROXY_ID] = g_param_spec_string ("proxy-id", "proxy-id",
+      "HTTP proxy URI user id for authentication", NULL, flags);
+  properties[PROP_PROXY_PW] = g_param_spec_string ("proxy-pw", "proxy-pw",
+      "HTTP proxy URI user password for authentication", NULL, flags);
+  properties[PROP_USER_ID] = g_param_spec_string ("user-id", "user-id",
+      "HTTP location URI user id for authentication", NULL, flags);
+  properties[PROP_USER_PW] = g_param_spec_string ("user-pw", "user-pw",
+      "HTTP location URI user password for authentication", NULL, flags);
+  properties[PROP_SSL_STRICT] = g_param_spec_boolean ("ssl-strict", "SSL Strict",
+      "Strict SSL certificate checking", TRUE, flags);
+  properties[PROP_SSL_CA_FILE] = g_param_spec_string ("ssl-ca-file", "SSL CA File",
+      "Location of a SSL CA file to use", NULL, flags);
+  properties[PROP_SSL_USE_SYSTEM_CA_FILE] = g_param_spec_boolean ("ssl-use-system-ca-file",
+      "Use System CA File", "Use system CA file", TRUE, flags);
+  properties[PROP_TIMEOUT] = g_param_spec_uint ("timeout", "timeout",
+      "Value in seconds to timeout a blocking I/O (0 = No timeout).", 0, 3600, 15, flags);
+  properties[PROP_RETRIES] = g_param_spec_int ("retries", "Retries",
+      "Maximum number of retries until giving up (-1=infinite)", -1, G_MAXINT, 3, flags);
+  properties[PROP_COMPRESS] = g_param_spec_boolean ("compress", "Compress",
+      "Allow compressed content encodings", FALSE, flags);
+  properties[PROP_KEEP_ALIVE] = g_param_spec_boolean ("keep-alive", "keep-alive",
+      "Use HTTP persistent connections", TRUE, flags);
+  properties[PROP_AUTOMATIC_REDIRECT] = g_param_spec_boolean ("automatic-redirect",
+      "automatic-redirect", "Automatically follow HTTP redirects (HTTP Status Code 3xx)", TRUE, flags);
+  properties[PROP_IS_LIVE] = g_param_spec_boolean ("is-live", "is-live",
+      "Act like a live source", FALSE, flags);
+  properties[PROP_IRADIO_MODE] = g_param_spec_boolean ("iradio-mode", "iradio-mode",
+      "Enable internet radio mode (ask server to send shoutcast/icecast metadata interleaved with the actual stream data)",
+      TRUE, flags);
+  g_object_class_install_properties (gobject_class, PROP_LAST, properties);
+  element_class->change_state = GST_DEBUG_FUNCPTR (agmp_http_cache_change_state);
+
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+  gst_element_class_set_static_metadata (element_class, "AGMP HTTP cache source",
+      "Source/Network", "Replay HTTP resources from a disk cache", "Amlogic");
+}
+
+static void agmp_http_cache_init (AgmpHttpCache *self)
+{
+  self->fd = -1;
+  self->size = -1;
+  self->ranges = g_array_new (FALSE, FALSE, sizeof (HttpRange));
+  self->child_props = gst_structure_new_empty ("souphttpsrc");
+  self->srcpad = gst_ghost_pad_new_no_target_from_template ("src",
+      gst_static_pad_template_get (&src_template));
+  gst_element_add_pad (GST_ELEMENT (self), self->srcpad);
+  GST_OBJECT_FLAG_SET (self, GST_ELEMENT_FLAG_SOURCE);
+}
+
+static GstURIType agmp_http_cache_uri_get_type (GType type)
+{
+  return GST_URI_SRC;
+}
+
+static const gchar *const *agmp_http_cache_uri_get_protocols (GType type)
+{
+  static const gchar *protocols[] = { "http", "https", NULL };
+
+  return protocols;
+}
+
+static gchar *agmp_http_cache_uri_get_uri (GstURIHandler *handler)
+{
+  AgmpHttpCache *self = AGMP_HTTP_CACHE (handler);
+  gchar *uri;
+
+  GST_OBJECT_LOCK (self);
+  uri = g_strdup (self->uri);
+  GST_OBJECT_UNLOCK (self);
+
+  return uri;
+}
+
+static gboolean agmp_http_cache_uri_set_uri (GstURIHandler *handler, const gchar *uri, GError **error)
+{
+  AgmpHttpCache *self = AGMP_HTTP_CACHE (handler);
+
+  GST_OBJECT_LOCK (self);
+  if (GST_STATE (self) != GST_STATE_NULL) {
+    GST_OBJECT_UNLOCK (self);
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE,
+        "Changing the uri while running isn't supported");
+    return FALSE;
+  }
+  g_free (self->uri);
+  g_free (self->key);
+  self->uri = g_strdup (uri);
+  self->key = g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+  GST_OBJECT_UNLOCK (self);
+
+  return TRUE;
+}
+
+static void agmp_http_cache_uri_handler_init (gpointer g_iface, gpointer iface_data)
+{
+  GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+  iface->get_type = agmp_http_cache_uri_get_type;
+  iface->get_protocols = agmp_http_cache_uri_get_protocols;
+  iface->get_uri = agmp_http_cache_uri_get_uri;
+  iface->set_uri = agmp_http_cache_uri_set_uri;
+}
+
+static gboolean agmp_http_cache_plugin_init (GstPlugin *plugin)
+{
+  GST_DEBUG_CATEGORY_INIT (agmp_http_cache_debug, "agmphttpcache", 0, "agmplayer http disk cache");
+
+  /* stays behind souphttpsrc until the cache is enabled */
+  return gst_element_register (plugin, "agmphttpcache", GST_RANK_NONE, AGMP_TYPE_HTTP_CACHE);
+}
+
+int agmp_set_http_cache(const char* dir, unsigned long long max_bytes)
+{
+  static gsize registered = 0;
+  GstElementFactory *factory;
+  gboolean enable = dir != NULL && *dir && max_bytes > 0;
+  gchar *path;
+
+  if (!gst_is_initialized ())
+    return AAMP_FAILED_IN_THIS_STATE;
+
+  if (g_once_init_enter (&registered)) {
+    gst_plugin_register_static (GST_VERSION_MAJOR, GST_VERSION_MINOR, "agmphttpcache",
+        "http disk cache of agmplayer", agmp_http_cache_plugin_init, "1.0",
+        GST_LICENSE_UNKNOWN, "libAGMPlayer", "agmplayer", "http://www.amlogic.com");
+    g_once_init_leave (&registered, 1);
+  }
+
+  g_mutex_lock (&cache_lock);
+  g_free (cache_dir);
+  cache_dir = NULL;
+  if (cache_index)
+    g_key_file_free (cache_index);
+  cache_index = NULL;
+  if (enable) {
+    if (g_mkdir_with_parents (dir, 0755) != 0) {
+      g_mutex_unlock (&cache_lock);
+      return AAMP_INVALID_PARAM;
+    }
+    cache_dir = g_strdup (dir);
+    cache_max_bytes = max_bytes;
+    cache_index = g_key_file_new ();
+    path = g_build_filename (cache_dir, HTTP_CACHE_INDEX, NULL);
+    g_key_file_load_from_file (cache_index, path, G_KEY_FILE_NONE, NULL);
+    g_free (path);
+    /* the limit may have shrunk */
+    http_cache_evict (NULL);
+    http_cache_save_index ();
+  }
+  g_mutex_unlock (&cache_lock);
+
+  factory = gst_element_factory_find ("agmphttpcache");
+  if (factory) {
+    gst_plugin_feature_set_rank (GST_PLUGIN_FEATURE (factory),
+        enable ? GST_RANK_PRIMARY + 1 : GST_RANK_NONE);
+    gst_object_unref (factory);
+  }
+
+  return AAMP_SUCCESS;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __AGMPLAYER_HTTP_CACHE_H__
+#define __AGMPLAYER_HTTP_CACHE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/*
+ * http/https source bin keeping what souphttpsrc fetched on disk.
+ * byte ranges seen are recorded per uri with the ETag/Last-Modified and
+ * Cache-Control max-age of the response. a uri cached completely is served
+ * from its file while max-age lasts, afterwards it is fetched again and the
+ * recorded ranges only stay if the validators still match. playlists and
+ * no-store/private responses are never cached. the souphttpsrc properties
+ * applications and adaptive demuxers set (user-agent, cookies, extra-headers,
+ * proxy, ssl-*, ...) are exposed and forwarded. the rank is raised above
+ * souphttpsrc only while agmp_set_http_cache() has it enabled.
+ */
+#define AGMP_TYPE_HTTP_CACHE (agmp_http_cache_get_type ())
+G_DECLARE_FINAL_TYPE (AgmpHttpCache, agmp_http_cache, AGMP, HTTP_CACHE, GstBin)
+
+G_END_DECLS
+
+#endif /* __AGMPLAYER_HTTP_CACHE_H__ */
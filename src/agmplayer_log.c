@@ -0,0 +1,283 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include "agmplayer_log.h"
+
+#define AGMP_LOG_MAX_MODULES 16
+#define AGMP_LOG_WRITER_PERIOD (10 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct
+{
+  long second;
+  long usec;
+  int level;
+  int line;
+  const char *module;           /* string literals of the log macros */
+  const char *func;
+  char msg[AGMP_LOG_MSG_LEN];
+} LogRecord;
+
+/* single producer (owner thread), single consumer (writer) */
+typedef struct _LogRing LogRing;
+struct _LogRing
+{
+  gint head;                    /* next record to print, consumer only */
+  gint tail;                    /* next free record, producer only */
+  gint dead;                    /* owner thread exited */
+  LogRing *next;
+  LogRecord records[AGMP_LOG_RING_SIZE];
+};
+
+static const char *level_names[] = {
+  "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
+};
+
+static struct {
+  gint level;
+  guint64 dropped;
+  GMutex dropped_lock;
+
+  /* per module levels, entries are only appended */
+  struct {
+    gchar *name;
+    gint level;
+  } modules[AGMP_LOG_MAX_MODULES];
+  gint n_modules;
+  GMutex modules_lock;
+
+  LogRing *rings;               /* all rings, new ones pushed at head */
+  GMutex rings_lock;            /* ring list and consumer side */
+  GCond writer_cond;
+  gboolean stopping;            /* protected by rings_lock */
+  GThread *writer;
+} L = {0};
+
+static void log_ring_release (gpointer data);
+static GPrivate ring_key = G_PRIVATE_INIT (log_ring_release);
+
+static void log_ring_release (gpointer data)
+{
+  LogRing *ring = data;
+
+  /* writer frees it after printing what's left */
+  g_atomic_int_set (&ring->dead, TRUE);
+}
+
+/* print records of all rings in time order. called with rings_lock held */
+static void log_drain_locked (void)
+{
+  LogRing **link;
+
+  while (TRUE) {
+    LogRing *ring, *oldest = NULL;
+    LogRecord *rec, *oldest_rec = NULL;
+
+    for (ring = L.rings; ring; ring = ring->next) {
+      if (ring->head == g_atomic_int_get (&ring->tail))
+        continue;
+      rec = &ring->records[ring->head & (AGMP_LOG_RING_SIZE - 1)];
+      if (!oldest_rec || rec->second < oldest_rec->second
+          || (rec->second == oldest_rec->second && rec->usec < oldest_rec->usec)) {
+        oldest = ring;
+        oldest_rec = rec;
+      }
+    }
+    if (!oldest)
+      break;
+
+    printf ("[%ld.%06ld]: %-5s %s:%d [%s]: %s\n", oldest_rec->second, oldest_rec->usec,
+          level_names[oldest_rec->level], oldest_rec->func, oldest_rec->line,
+          oldest_rec->module, oldest_rec->msg);
+    g_atomic_int_set (&oldest->head, oldest->head + 1);
+  }
+  fflush (stdout);
+
+  /* rings of exited threads are empty now */
+  link = &L.rings;
+  while (*link) {
+    LogRing *ring = *link;
+
+    if (g_atomic_int_get (&ring->dead) && ring->head == g_atomic_int_get (&ring->tail)) {
+      *link = ring->next;
+      g_free (ring);
+    } else {
+      link = &ring->next;
+    }
+  }
+}
+
+static gpointer log_writer_thread (gpointer data)
+{
+  g_mutex_lock (&L.rings_lock);
+  while (!L.stopping) {
+    gint64 end_time = g_get_monotonic_time () + AGMP_LOG_WRITER_PERIOD;
+
+    g_cond_wait_until (&L.writer_cond, &L.rings_lock, end_time);
+    log_drain_locked ();
+  }
+  g_mutex_unlock (&L.rings_lock);
+  return NULL;
+}
+
+/* stop the writer at exit or when the library is unloaded, print what is still in the rings.
+ * a destructor rather than atexit, which would be left pointing into an unloaded library */
+static void __attribute__ ((destructor)) log_shutdown (void)
+{
+  GThread *writer;
+
+  g_mutex_lock (&L.rings_lock);
+  L.stopping = TRUE;
+  writer = L.writer;
+  L.writer = NULL;
+  g_cond_signal (&L.writer_cond);
+  g_mutex_unlock (&L.rings_lock);
+
+  if (writer)
+    g_thread_join (writer);
+
+  agmp_log_flush ();
+}
+
+static LogRing *log_get_ring (void)
+{
+  LogRing *ring = g_private_get (&ring_key);
+
+  if (G_LIKELY (ring))
+    return ring;
+
+  ring = g_new0 (LogRing, 1);
+  g_private_set (&ring_key, ring);
+
+  g_mutex_lock (&L.rings_lock);
+  ring->next = L.rings;
+  L.rings = ring;
+  if (!L.writer && !L.stopping)
+    L.writer = g_thread_new ("agmp log writer", log_writer_thread, NULL);
+  g_mutex_unlock (&L.rings_lock);
+
+  return ring;
+}
+
+gboolean agmp_log_enabled (int level, const char *module)
+{
+  gint n = g_atomic_int_get (&L.n_modules);
+  gint i;
+
+  for (i = 0; i < n; i++) {
+    if (!strcmp (L.modules[i].name, module))
+      return level >= g_atomic_int_get (&L.modules[i].level);
+  }
+  return level >= g_atomic_int_get (&L.level);
+}
+
+void agmp_log_write (int level, const char *module, const char *func, int line,
+    const char *fmt, ...)
+{
+  LogRing *ring;
+  LogRecord *rec;
+  struct timespec tm;
+  va_list args;
+  gint tail;
+
+  if (level < LOG_TRACE || level > LOG_FATAL || !agmp_log_enabled (level, module))
+    return;
+
+  ring = log_get_ring ();
+  tail = ring->tail;
+  if (tail - g_atomic_int_get (&ring->head) >= AGMP_LOG_RING_SIZE) {
+    g_mutex_lock (&L.dropped_lock);
+    L.dropped++;
+    g_mutex_unlock (&L.dropped_lock);
+    return;
+  }
+
+  rec = &ring->records[tail & (AGMP_LOG_RING_SIZE - 1)];
+  clock_gettime (CLOCK_MONOTONIC_RAW, &tm);
+  rec->second = tm.tv_sec;
+  rec->usec = tm.tv_nsec / 1000LL;
+  rec->level = level;
+  rec->line = line;
+  rec->module = module;
+  rec->func = func;
+  va_start (args, fmt);
+  g_vsnprintf (rec->msg, sizeof (rec->msg), fmt, args);
+  va_end (args);
+
+  /* publish the record */
+  g_atomic_int_set (&ring->tail, tail + 1);
+
+  /* errors often precede abort(), don't leave them in the ring */
+  if (level >= LOG_ERROR)
+    agmp_log_flush ();
+}
+
+void agmp_log_set_level (int level)
+{
+  g_atomic_int_set (&L.level, level);
+}
+
+void agmp_log_flush (void)
+{
+  g_mutex_lock (&L.rings_lock);
+  log_drain_locked ();
+  g_mutex_unlock (&L.rings_lock);
+}
+
+int agmp_set_module_log_level (const char* module, LOG_LEVEL level)
+{
+  gint i, n;
+
+  if (!module)
+    return AAMP_NULL_POINTER;
+
+  g_mutex_lock (&L.modules_lock);
+  n = g_atomic_int_get (&L.n_modules);
+  for (i = 0; i < n; i++) {
+    if (!strcmp (L.modules[i].name, module))
+      break;
+  }
+  if (i == n) {
+    if (n == AGMP_LOG_MAX_MODULES) {
+      g_mutex_unlock (&L.modules_lock);
+      return AAMP_FAILED;
+    }
+    L.modules[i].name = g_strdup (module);
+    L.modules[i].level = level;
+    /* entry is complete before readers can see it */
+    g_atomic_int_set (&L.n_modules, n + 1);
+  } else {
+    g_atomic_int_set (&L.modules[i].level, level);
+  }
+  g_mutex_unlock (&L.modules_lock);
+
+  return AAMP_SUCCESS;
+}
+
+unsigned long long agmp_get_dropped_log_count (void)
+{
+  guint64 dropped;
+
+  g_mutex_lock (&L.dropped_lock);
+  dropped = L.dropped;
+  g_mutex_unlock (&L.dropped_lock);
+
+  return dropped;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __AGMPLAYER_LOG_H__
+#define __AGMPLAYER_LOG_H__
+
+#include <glib.h>
+#include "agmplayer.h"
+
+/*
+ * asynchronous logger of libAGMPlayer.
+ * callers only format the message into a record of their own per-thread ring,
+ * a background thread prints the records. records are dropped when a ring is full.
+ * ERROR and FATAL records are printed before returning, the rest is printed at exit.
+ */
+
+#define AGMP_LOG_MSG_LEN 256    /* longer messages are truncated */
+#define AGMP_LOG_RING_SIZE 256  /* records per thread, power of 2 */
+
+gboolean agmp_log_enabled (int level, const char *module);
+void agmp_log_write (int level, const char *module, const char *func, int line,
+    const char *fmt, ...) G_GNUC_PRINTF (5, 6);
+void agmp_log_set_level (int level);
+/* print all pending records of all threads */
+void agmp_log_flush (void);
+
+#endif /* __AGMPLAYER_LOG_H__ */
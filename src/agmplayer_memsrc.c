@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "agmplayer.h"
+#include "agmplayer_memsrc.h"
+
+GST_DEBUG_CATEGORY_STATIC (agmp_mem_src_debug);
+#define GST_CAT_DEFAULT agmp_mem_src_debug
+
+#define MEM_CLIP_DEFAULT_LIMIT (32 * 1024 * 1024)
+#define MEM_URI_PREFIX "mem://"
+
+/* registry of clips, least recently used first in clip_lru */
+typedef struct
+{
+  gchar *name;
+  GBytes *bytes;
+} MemClip;
+
+static GMutex clip_lock;
+static GHashTable *clips = NULL;        /* name -> MemClip */
+static GQueue clip_lru = G_QUEUE_INIT;  /* MemClip */
+static guint64 clip_bytes = 0;
+static guint64 clip_limit = MEM_CLIP_DEFAULT_LIMIT;
+
+struct _AgmpMemSrc
+{
+  GstBaseSrc parent;
+
+  gchar *uri;
+  GBytes *bytes;                /* clip being served, stays valid when it gets evicted */
+  GstMemory *memory;            /* wraps bytes, buffers share slices of it */
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static void agmp_mem_src_uri_handler_init (gpointer g_iface, gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (AgmpMemSrc, agmp_mem_src, GST_TYPE_BASE_SRC,
+    G_IMPLEMENT_INTERFACE (GST_TYPE_URI_HANDLER, agmp_mem_src_uri_handler_init));
+
+/* call with clip_lock held */
+static void mem_clip_remove (MemClip *clip)
+{
+  g_queue_remove (&clip_lru, clip);
+  g_hash_table_remove (clips, clip->name);
+  clip_bytes -= g_bytes_get_size (clip->bytes);
+  g_bytes_unref (clip->bytes);
+  g_free (clip->name);
+  g_free (clip);
+}
+
+/* call with clip_lock held */
+static void mem_clip_evict (guint64 limit)
+{
+  while (clip_bytes > limit && !g_queue_is_empty (&clip_lru)) {
+    MemClip *clip = g_queue_peek_head (&clip_lru);
+
+    GST_INFO ("evicting clip %s", clip->name);
+    mem_clip_remove (clip);
+  }
+}
+
+static int mem_clip_add (const char* name, GBytes *bytes)
+{
+  MemClip *clip;
+  gsize size = g_bytes_get_size (bytes);
+
+  g_mutex_lock (&clip_lock);
+  if (size > clip_limit) {
+    g_mutex_unlock (&clip_lock);
+    g_bytes_unref (bytes);
+    return AAMP_INVALID_PARAM;
+  }
+  if (!clips)
+    clips = g_hash_table_new (g_str_hash, g_str_equal);
+  clip = g_hash_table_lookup (clips, name);
+  if (clip)
+    mem_clip_remove (clip);
+  mem_clip_evict (clip_limit - size);
+
+  clip = g_new0 (MemClip, 1);
+  clip->name = g_strdup (name);
+  clip->bytes = bytes;
+  g_hash_table_insert (clips, clip->name, clip);
+  g_queue_push_tail (&clip_lru, clip);
+  clip_bytes += size;
+  g_mutex_unlock (&clip_lock);
+
+  return AAMP_SUCCESS;
+}
+
+/* a ref of the clip's bytes, NULL if not registered */
+static GBytes *mem_clip_get (const gchar *name)
+{
+  MemClip *clip;
+  GBytes *bytes = NULL;
+
+  g_mutex_lock (&clip_lock);
+  clip = clips ? g_hash_table_lookup (clips, name) : NULL;
+  if (clip) {
+    g_queue_remove (&clip_lru, clip);
+    g_queue_push_tail (&clip_lru, clip);
+    bytes = g_bytes_ref (clip->bytes);
+  }
+  g_mutex_unlock (&clip_lock);
+
+  return bytes;
+}
+
+int agmp_register_memory_clip(const char* name, const void* data, unsigned int size)
+{
+  if (NULL == name || NULL == data || 0 == size || !*name)
+    return AAMP_INVALID_PARAM;
+
+  return mem_clip_add (name, g_bytes_new (data, size));
+}
+
+int agmp_register_file_clip(const char* name, const char* path)
+{
+  gchar *contents;
+  gsize length;
+
+  if (NULL == name || NULL == path || !*name)
+    return AAMP_INVALID_PARAM;
+  if (!g_file_get_contents (path, &contents, &length, NULL))
+    return AAMP_FAILED;
+  if (length == 0) {
+    g_free (contents);
+    return AAMP_INVALID_PARAM;
+  }
+
+  return mem_clip_add (name, g_bytes_new_take (contents, length));
+}
+
+int agmp_unregister_clip(const char* name)
+{
+  MemClip *clip;
+
+  if (NULL == name)
+    return AAMP_INVALID_PARAM;
+
+  g_mutex_lock (&clip_lock);
+  clip = clips ? g_hash_table_lookup (clips, name) : NULL;
+  if (clip)
+    mem_clip_remove (clip);
+  g_mutex_unlock (&clip_lock);
+
+  return clip ? AAMP_SUCCESS : AAMP_FAILED;
+}
+
+int agmp_set_clip_cache_limit(unsigned long long bytes)
+{
+  g_mutex_lock (&clip_lock);
+  clip_limit = bytes;
+  mem_clip_evict (clip_limit);
+  g_mutex_unlock (&clip_lock);
+
+  return AAMP_SUCCESS;
+}
+
+static void agmp_mem_src_finalize (GObject *object)
+{
+  AgmpMemSrc *src = AGMP_MEM_SRC (object);
+
+  g_free (src->uri);
+
+  G_OBJECT_CLASS (agmp_mem_src_parent_class)->finalize (object);
+}
+
+static gboolean agmp_mem_src_start (GstBaseSrc *basesrc)
+{
+  AgmpMemSrc *src = AGMP_MEM_SRC (basesrc);
+  const gchar *name;
+  gsize size;
+
+  GST_OBJECT_LOCK (src);
+  name = src->uri ? src->uri + strlen (MEM_URI_PREFIX) : NULL;
+  src->bytes = name ? mem_clip_get (name) : NULL;
+  GST_OBJECT_UNLOCK (src);
+
+  if (!src->bytes) {
+    GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND, (NULL), ("no clip registered for %s", src->uri));
+    return FALSE;
+  }
+
+  /* the memory keeps a ref on the bytes until the last buffer is gone */
+  size = g_bytes_get_size (src->bytes);
+  src->memory = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+      (gpointer) g_bytes_get_data (src->bytes, NULL), size, 0, size,
+      g_bytes_ref (src->bytes), (GDestroyNotify) g_bytes_unref);
+
+  return TRUE;
+}
+
+static gboolean agmp_mem_src_stop (GstBaseSrc *basesrc)
+{
+  AgmpMemSrc *src = AGMP_MEM_SRC (basesrc);
+
+  if (src->memory) {
+    gst_memory_unref (src->memory);
+    src->memory = NULL;
+  }
+  if (src->bytes) {
+    g_bytes_unref (src->bytes);
+    src->bytes = NULL;
+  }
+  return TRUE;
+}
+
+static gboolean agmp_mem_src_get_size (GstBaseSrc *basesrc, guint64 *size)
+{
+  AgmpMemSrc *src = AGMP_MEM_SRC (basesrc);
+
+  if (!src->bytes)
+    return FALSE;
+  *size = g_bytes_get_size (src->bytes);
+  return TRUE;
+}
+
+static gboolean agmp_mem_src_is_seekable (GstBaseSrc *basesrc)
+{
+  return TRUE;
+}
+
+static GstFlowReturn agmp_mem_src_create (GstBaseSrc *basesrc, guint64 offset,
+    guint length, GstBuffer **buffer)
+{
+  AgmpMemSrc *src = AGMP_MEM_SRC (basesrc);
+  gsize size = g_bytes_get_size (src->bytes);
+  GstBuffer *buf;
+
+  if (offset >= size)
+    return GST_FLOW_EOS;
+  length = MIN (length, size - offset);
+
+  buf = gst_buffer_new ();
+  gst_buffer_append_memory (buf, gst_memory_share (src->memory, offset, length));
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + length;
+  *buffer = buf;
+
+  return GST_FLOW_OK;
+}
+
+static void agmp_mem_src_class_init (AgmpMemSrcClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS (klass);
+
+  gobject_class->finalize = agmp_mem_src_finalize;
+
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+  gst_element_class_set_static_metadata (element_class, "AGMP memory clip source",
+      "Source", "Read a clip registered in memory", "Amlogic");
+
+  basesrc_class->start = GST_DEBUG_FUNCPTR (agmp_mem_src_start);
+  basesrc_class->stop = GST_DEBUG_FUNCPTR (agmp_mem_src_stop);
+  basesrc_class->get_size = GST_DEBUG_FUNCPTR (agmp_mem_src_get_size);
+  basesrc_class->is_seekable = GST_DEBUG_FUNCPTR (agmp_mem_src_is_seekable);
+  basesrc_class->create = GST_DEBUG_FUNCPTR (agmp_mem_src_create);
+}
+
+static void agmp_mem_src_init (AgmpMemSrc *src)
+{
+  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_BYTES);
+}
+
+static GstURIType agmp_mem_src_uri_get_type (GType type)
+{
+  return GST_URI_SRC;
+}
+
+static const gchar *const *agmp_mem_src_uri_get_protocols (GType type)
+{
+  static const gchar *protocols[] = { "mem", NULL };
+
+  return protocols;
+}
+
+static gchar *agmp_mem_src_uri_get_uri (GstURIHandler *handler)
+{
+  AgmpMemSrc *src = AGMP_MEM_SRC (handler);
+  gchar *uri;
+
+  GST_OBJECT_LOCK (src);
+  uri = g_strdup (src->uri);
+  GST_OBJECT_UNLOCK (src);
+
+  return uri;
+}
+
+static gboolean agmp_mem_src_uri_set_uri (GstURIHandler *handler, const gchar *uri, GError **error)
+{
+  AgmpMemSrc *src = AGMP_MEM_SRC (handler);
+
+  if (!g_str_has_prefix (uri, MEM_URI_PREFIX) || !uri[strlen (MEM_URI_PREFIX)]) {
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_URI, "Invalid clip uri %s", uri);
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (src);
+  if (GST_STATE (src) != GST_STATE_READY && GST_STATE (src) != GST_STATE_NULL) {
+    GST_OBJECT_UNLOCK (src);
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE,
+        "Changing the uri while running isn't supported");
+    return FALSE;
+  }
+  g_free (src->uri);
+  src->uri = g_strdup (uri);
+  GST_OBJECT_UNLOCK (src);
+
+  return TRUE;
+}
+
+static void agmp_mem_src_uri_handler_init (gpointer g_iface, gpointer iface_data)
+{
+  GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+  iface->get_type = agmp_mem_src_uri_get_type;
+  iface->get_protocols = agmp_mem_src_uri_get_protocols;
+  iface->get_uri = agmp_mem_src_uri_get_uri;
+  iface->set_uri = agmp_mem_src_uri_set_uri;
+}
+
+static gboolean agmp_mem_src_plugin_init (GstPlugin *plugin)
+{
+  GST_DEBUG_CATEGORY_INIT (agmp_mem_src_debug, "agmpmemsrc", 0, "agmplayer memory clip source");
+
+  return gst_element_register (plugin, "agmpmemsrc", GST_RANK_PRIMARY, AGMP_TYPE_MEM_SRC);
+}
+
+void agmp_mem_src_register (void)
+{
+  static gsize registered = 0;
+
+  if (g_once_init_enter (&registered)) {
+    gst_plugin_register_static (GST_VERSION_MAJOR, GST_VERSION_MINOR, "agmpmemsrc",
+        "memory clip source of agmplayer", agmp_mem_src_plugin_init, "1.0",
+        GST_LICENSE_UNKNOWN, "libAGMPlayer", "agmplayer", "http://www.amlogic.com");
+    g_once_init_leave (&registered, 1);
+  }
+}
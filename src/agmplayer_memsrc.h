@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __AGMPLAYER_MEMSRC_H__
+#define __AGMPLAYER_MEMSRC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+
+G_BEGIN_DECLS
+
+/*
+ * source for mem://<name> uris, serving clips registered with
+ * agmp_register_memory_clip/agmp_register_file_clip straight from RAM.
+ */
+#define AGMP_TYPE_MEM_SRC (agmp_mem_src_get_type ())
+G_DECLARE_FINAL_TYPE (AgmpMemSrc, agmp_mem_src, AGMP, MEM_SRC, GstBaseSrc)
+
+/* once per process */
+void agmp_mem_src_register (void);
+
+G_END_DECLS
+
+#endif /* __AGMPLAYER_MEMSRC_H__ */
@@ -0,0 +1,674 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include "agmplayer_mmapsrc.h"
+
+GST_DEBUG_CATEGORY_STATIC (agmp_mmap_src_debug);
+#define GST_CAT_DEFAULT agmp_mmap_src_debug
+
+/* files are mapped in windows so 32-bit address spaces cope with large recordings */
+#define MMAP_WINDOW_SIZE (64 * 1024 * 1024)
+#define MMAP_WINDOW_OVERLAP (4 * 1024 * 1024)   /* reads up to this size never straddle windows */
+#define MMAP_READAHEAD_SECONDS 2
+#define MMAP_READAHEAD_MIN (512 * 1024)
+#define MMAP_READAHEAD_MAX (16 * 1024 * 1024)
+#define MMAP_SEQUENTIAL_READS 8     /* in-order reads after a jump before reading ahead again */
+#define MMAP_MAX_WINDOWS 64         /* live mappings the SIGBUS guard knows about */
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+};
+
+typedef struct
+{
+  gpointer addr;
+  gsize size;
+  gpointer owner;               /* source that mapped it, only compared */
+  gint faulted;                 /* pages went away under the mapping */
+} MmapWindow;
+
+struct _AgmpMmapSrc
+{
+  GstBaseSrc parent;
+
+  gchar *location;
+  gint fd;
+  guint64 size;                 /* refreshed when reads reach it, recordings grow */
+  gboolean use_read;            /* media that may go away, pread instead of mmap */
+
+  /* current mapping, buffers share it and keep it alive */
+  GstMemory *window;
+  MmapWindow *mapping;          /* of window */
+  guint64 window_offset;
+  gsize window_size;
+  guint8 *window_data;
+
+  /* access pattern */
+  guint64 next_offset;          /* where the last read ended */
+  guint sequential;             /* in-order reads since the last jump */
+  gboolean random;              /* MADV_RANDOM in effect */
+  guint64 advised_end;          /* read-ahead requested up to here */
+  gint64 rate_start;            /* us */
+  guint64 rate_bytes;
+  guint64 byte_rate;            /* bytes/s consumed, 0 until measured */
+};
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static void agmp_mmap_src_uri_handler_init (gpointer g_iface, gpointer iface_data);
+
+G_DEFINE_TYPE_WITH_CODE (AgmpMmapSrc, agmp_mmap_src, GST_TYPE_BASE_SRC,
+    G_IMPLEMENT_INTERFACE (GST_TYPE_URI_HANDLER, agmp_mmap_src_uri_handler_init));
+
+static gboolean agmp_mmap_src_set_location (AgmpMmapSrc *src, const gchar *location, GError **error)
+{
+  GstState state;
+
+  GST_OBJECT_LOCK (src);
+  state = GST_STATE (src);
+  if (state != GST_STATE_READY && state != GST_STATE_NULL) {
+    GST_OBJECT_UNLOCK (src);
+    g_set_error (error, GST_URI_ERROR, GST_URI_ERROR_BAD_STATE,
+        "Changing the location while running isn't supported");
+    return FALSE;
+  }
+  g_free (src->location);
+  src->location = g_strdup (location);
+  GST_OBJECT_UNLOCK (src);
+
+  return TRUE;
+}
+
+static void agmp_mmap_src_set_property (GObject *object, guint prop_id,
+    const GValue *value, GParamSpec *pspec)
+{
+  AgmpMmapSrc *src = AGMP_MMAP_SRC (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      agmp_mmap_src_set_location (src, g_value_get_string (value), NULL);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void agmp_mmap_src_get_property (GObject *object, guint prop_id,
+    GValue *value, GParamSpec *pspec)
+{
+  AgmpMmapSrc *src = AGMP_MMAP_SRC (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (src);
+      g_value_set_string (value, src->location);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void agmp_mmap_src_finalize (GObject *object)
+{
+  AgmpMmapSrc *src = AGMP_MMAP_SRC (object);
+
+  g_free (src->location);
+
+  G_OBJECT_CLASS (agmp_mmap_src_parent_class)->finalize (object);
+}
+
+/*
+ * pages of a MAP_SHARED mapping raise SIGBUS when the file is truncated or the
+ * media fails, in whatever thread touches them, downstream elements included.
+ * the source checks the file still covers a range before handing its pages out.
+ * pages already downstream can't be taken back, the guard backs a faulting one
+ * with zeroes so the reader survives and the source posts an error on its next read.
+ * faults outside our windows go to the previous handler. the guard is only
+ * installed while windows are mapped, so none is left behind once we're unloaded.
+ */
+static MmapWindow *live_windows[MMAP_MAX_WINDOWS];
+static struct sigaction sigbus_chain;
+static long sigbus_page_size;
+static GMutex sigbus_lock;
+static guint sigbus_users;      /* guarded windows */
+
+static void mmap_sigbus_handler (int sig, siginfo_t *info, void *context)
+{
+  long page = sigbus_page_size;
+  guint8 *addr = info->si_addr;
+  gint i;
+
+  for (i = 0; i < MMAP_MAX_WINDOWS; i++) {
+    MmapWindow *window = g_atomic_pointer_get (&live_windows[i]);
+
+    if (window && addr >= (guint8 *) window->addr && addr < (guint8 *) window->addr + window->size) {
+      addr -= (guintptr) addr % page;
+      if (mmap (addr, page, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != MAP_FAILED) {
+        g_atomic_int_set (&window->faulted, TRUE);
+        return;
+      }
+      break;
+    }
+  }
+
+  /* not ours, hand it on. returning re-raises it under the previous action */
+  if (sigbus_chain.sa_flags & SA_SIGINFO)
+    sigbus_chain.sa_sigaction (sig, info, context);
+  else if (sigbus_chain.sa_handler != SIG_DFL && sigbus_chain.sa_handler != SIG_IGN)
+    sigbus_chain.sa_handler (sig);
+  else
+    sigaction (SIGBUS, &sigbus_chain, NULL);
+}
+
+/* call with sigbus_lock held */
+static void mmap_sigbus_install (void)
+{
+  struct sigaction action;
+
+  if (sigbus_users++ > 0)
+    return;
+
+  sigbus_page_size = sysconf (_SC_PAGESIZE);
+  memset (&action, 0, sizeof (action));
+  action.sa_sigaction = mmap_sigbus_handler;
+  action.sa_flags = SA_SIGINFO | SA_NODEFER;
+  sigemptyset (&action.sa_mask);
+  sigaction (SIGBUS, &action, &sigbus_chain);
+}
+
+/* call with sigbus_lock held */
+static void mmap_sigbus_uninstall (void)
+{
+  struct sigaction current;
+
+  if (--sigbus_users > 0)
+    return;
+
+  /* someone installed theirs on top of ours and may chain to it, leave both */
+  if (sigaction (SIGBUS, NULL, &current) == 0 && (current.sa_flags & SA_SIGINFO)
+      && current.sa_sigaction == mmap_sigbus_handler)
+    sigaction (SIGBUS, &sigbus_chain, NULL);
+  else
+    sigbus_users++;
+}
+
+static gboolean mmap_window_guard (MmapWindow *window)
+{
+  gint i;
+
+  g_mutex_lock (&sigbus_lock);
+  for (i = 0; i < MMAP_MAX_WINDOWS; i++) {
+    if (g_atomic_pointer_compare_and_exchange (&live_windows[i], NULL, window)) {
+      mmap_sigbus_install ();
+      g_mutex_unlock (&sigbus_lock);
+      return TRUE;
+    }
+  }
+  g_mutex_unlock (&sigbus_lock);
+  return FALSE;
+}
+
+static void mmap_window_free (gpointer data)
+{
+  MmapWindow *window = data;
+  gint i;
+
+  g_mutex_lock (&sigbus_lock);
+  for (i = 0; i < MMAP_MAX_WINDOWS; i++)
+    g_atomic_pointer_compare_and_exchange (&live_windows[i], window, NULL);
+  munmap (window->addr, window->size);
+  mmap_sigbus_uninstall ();
+  g_mutex_unlock (&sigbus_lock);
+  g_free (window);
+}
+
+/* a window of src, possibly one still held downstream, lost pages */
+static gboolean mmap_windows_faulted (gpointer owner)
+{
+  gboolean faulted = FALSE;
+  gint i;
+
+  g_mutex_lock (&sigbus_lock);
+  for (i = 0; i < MMAP_MAX_WINDOWS && !faulted; i++) {
+    MmapWindow *window = g_atomic_pointer_get (&live_windows[i]);
+
+    faulted = window && window->owner == owner && g_atomic_int_get (&window->faulted);
+  }
+  g_mutex_unlock (&sigbus_lock);
+
+  return faulted;
+}
+
+/* removable and network media vanish with their pages, read those */
+static gboolean mmap_fs_is_removable (gint fd)
+{
+  struct statfs fs;
+
+  if (fstatfs (fd, &fs) != 0)
+    return TRUE;
+
+  switch ((guint32) fs.f_type) {
+    case 0x4d44:                /* vfat */
+    case 0x2011bab0:            /* exfat */
+    case 0x5346544e:            /* ntfs */
+    case 0x65735546:            /* fuse */
+    case 0x6969:                /* nfs */
+    case 0x517b:                /* smb */
+    case 0xff534d42:            /* cifs */
+    case 0x9660:                /* iso9660 */
+    case 0x15013346:            /* udf */
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/* refresh the size of a growing file, FALSE if it got truncated instead */
+static gboolean agmp_mmap_src_update_size (AgmpMmapSrc *src)
+{
+  struct stat st;
+  gboolean truncated = FALSE;
+
+  if (fstat (src->fd, &st) == 0 && (guint64) st.st_size != src->size) {
+    GST_DEBUG_OBJECT (src, "size %" G_GUINT64_FORMAT " -> %" G_GINT64_FORMAT, src->size, (gint64) st.st_size);
+    truncated = (guint64) st.st_size < src->size;
+    src->size = st.st_size;
+  }
+  return !truncated;
+}
+
+static void agmp_mmap_src_advise (AgmpMmapSrc *src, guint64 start, guint64 end, int advice)
+{
+  long page = sysconf (_SC_PAGESIZE);
+  guint64 from, to;
+
+  from = MAX (start, src->window_offset) - src->window_offset;
+  to = MIN (end, src->window_offset + src->window_size) - src->window_offset;
+  from -= from % page;
+  if (to > from)
+    madvise (src->window_data + from, to - from, advice);
+}
+
+static gboolean agmp_mmap_src_map_window (AgmpMmapSrc *src, guint64 offset)
+{
+  guint64 start = offset - offset % MMAP_WINDOW_SIZE;
+  gsize size = MIN (MMAP_WINDOW_SIZE + MMAP_WINDOW_OVERLAP, src->size - start);
+  MmapWindow *window;
+  gpointer addr;
+
+  addr = mmap (NULL, size, PROT_READ, MAP_SHARED, src->fd, start);
+  if (addr == MAP_FAILED) {
+    GST_ERROR_OBJECT (src, "mmap of %" G_GSIZE_FORMAT " bytes at %" G_GUINT64_FORMAT " failed: %s",
+        size, start, g_strerror (errno));
+    return FALSE;
+  }
+
+  window = g_new0 (MmapWindow, 1);
+  window->addr = addr;
+  window->size = size;
+  window->owner = src;
+  if (!mmap_window_guard (window)) {
+    /* too many windows still held downstream, no guard for this one */
+    GST_WARNING_OBJECT (src, "no free guard slot for the mapping");
+    munmap (addr, size);
+    g_free (window);
+    return FALSE;
+  }
+  if (src->window)
+    gst_memory_unref (src->window);
+  src->window = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, addr, size, 0, size,
+      window, mmap_window_free);
+  src->mapping = window;
+  src->window_offset = start;
+  src->window_size = size;
+  src->window_data = addr;
+  src->advised_end = start;
+  agmp_mmap_src_advise (src, start, start + size, src->random ? MADV_RANDOM : MADV_SEQUENTIAL);
+
+  GST_DEBUG_OBJECT (src, "mapped %" G_GSIZE_FORMAT " bytes at %" G_GUINT64_FORMAT, size, start);
+  return TRUE;
+}
+
+/* read-ahead only pays off while reads go forward, a seek switches it off until they do again */
+static void agmp_mmap_src_track_access (AgmpMmapSrc *src, guint64 offset, guint size)
+{
+  gint64 now = g_get_monotonic_time ();
+  guint64 slack = MAX (MMAP_READAHEAD_MIN, src->byte_rate);
+  guint64 jump = offset > src->next_offset ? offset - src->next_offset : src->next_offset - offset;
+
+  /* demuxers hop between interleaved chunks, that still counts as in order */
+  if (jump <= slack) {
+    if (src->random && ++src->sequential >= MMAP_SEQUENTIAL_READS) {
+      src->random = FALSE;
+      agmp_mmap_src_advise (src, src->window_offset, src->window_offset + src->window_size, MADV_SEQUENTIAL);
+    }
+  } else {
+    src->sequential = 0;
+    src->advised_end = 0;
+    src->rate_start = now;
+    src->rate_bytes = 0;
+    if (!src->random) {
+      src->random = TRUE;
+      agmp_mmap_src_advise (src, src->window_offset, src->window_offset + src->window_size, MADV_RANDOM);
+    }
+  }
+  src->next_offset = offset + size;
+
+  src->rate_bytes += size;
+  if (now - src->rate_start >= G_USEC_PER_SEC) {
+    guint64 rate = src->rate_bytes * G_USEC_PER_SEC / (now - src->rate_start);
+
+    src->byte_rate = src->byte_rate ? (src->byte_rate * 3 + rate) / 4 : rate;
+    src->rate_start = now;
+    src->rate_bytes = 0;
+  }
+}
+
+static void agmp_mmap_src_readahead (AgmpMmapSrc *src, guint64 pos)
+{
+  guint64 len, end, window_end;
+
+  if (src->random)
+    return;
+
+  len = CLAMP (src->byte_rate * MMAP_READAHEAD_SECONDS, MMAP_READAHEAD_MIN, MMAP_READAHEAD_MAX);
+  end = MIN (pos + len, src->size);
+  /* refreshed every half read-ahead */
+  if (end <= src->advised_end + len / 2)
+    return;
+
+  window_end = src->window_offset + src->window_size;
+  agmp_mmap_src_advise (src, MAX (pos, src->advised_end), end, MADV_WILLNEED);
+  /* the rest lives in the next window, warm the page cache for it */
+  if (end > window_end)
+    posix_fadvise (src->fd, MAX (window_end, src->advised_end), end - MAX (window_end, src->advised_end),
+        POSIX_FADV_WILLNEED);
+  src->advised_end = end;
+}
+
+static GstBuffer *agmp_mmap_src_read (AgmpMmapSrc *src, guint64 offset, guint length)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  gsize done = 0;
+  ssize_t n;
+
+  buf = gst_buffer_new_allocate (NULL, length, NULL);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  while (done < length) {
+    n = pread (src->fd, map.data + done, length - done, offset + done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    done += n;
+  }
+  gst_buffer_unmap (buf, &map);
+
+  if (done == 0 && length > 0) {
+    gst_buffer_unref (buf);
+    return NULL;
+  }
+  gst_buffer_set_size (buf, done);
+  return buf;
+}
+
+static GstFlowReturn agmp_mmap_src_create (GstBaseSrc *basesrc, guint64 offset,
+    guint length, GstBuffer **buffer)
+{
+  AgmpMmapSrc *src = AGMP_MMAP_SRC (basesrc);
+  GstBuffer *buf;
+
+  /* mapped pages past a truncation fault downstream, check before handing them out */
+  if ((!src->use_read || offset + length > src->size) && !agmp_mmap_src_update_size (src))
+    goto truncated;
+  if (offset >= src->size)
+    return GST_FLOW_EOS;
+  length = MIN (length, src->size - offset);
+
+  agmp_mmap_src_track_access (src, offset, length);
+
+  if (!src->use_read && mmap_windows_faulted (src))
+    goto truncated;
+
+  if (!src->use_read && (!src->window || offset < src->window_offset
+          || offset + length > src->window_offset + src->window_size)) {
+    if (!agmp_mmap_src_map_window (src, offset)) {
+      GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL), ("mmap failed: %s", g_strerror (errno)));
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  if (!src->use_read && offset + length <= src->window_offset + src->window_size) {
+    buf = gst_buffer_new ();
+    gst_buffer_append_memory (buf, gst_memory_share (src->window, offset - src->window_offset, length));
+  } else {
+    /* media that may go away, or bigger than the window overlap */
+    buf = agmp_mmap_src_read (src, offset, length);
+    if (!buf) {
+      GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL), ("read failed: %s", g_strerror (errno)));
+      return GST_FLOW_ERROR;
+    }
+    length = gst_buffer_get_size (buf);
+  }
+
+  if (src->use_read && !src->random)
+    posix_fadvise (src->fd, offset + length,
+        CLAMP (src->byte_rate * MMAP_READAHEAD_SECONDS, MMAP_READAHEAD_MIN, MMAP_READAHEAD_MAX),
+        POSIX_FADV_WILLNEED);
+  else if (!src->use_read)
+    agmp_mmap_src_readahead (src, offset + length);
+
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + length;
+  *buffer = buf;
+  return GST_FLOW_OK;
+
+truncated:
+  GST_ELEMENT_ERROR (src, RESOURCE, READ, (NULL), ("%s was truncated or its media failed", src->location));
+  return GST_FLOW_ERROR;
+}
+
+static gboolean agmp_mmap_src_start (GstBaseSrc *basesrc)
+{
+  AgmpMmapSrc *src = AGMP_MMAP_SRC (basesrc);
+  struct stat st;
+
+  if (!src->location) {
+    GST_ELEMENT_ERROR (src, RESOURCE, NOT_FOUND, ("No file name specified for reading."), (NULL));
+    return FALSE;
+  }
+
+  src->fd = open (src->location, O_RDONLY | O_CLOEXEC);
+  if (src->fd < 0) {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL),
+        ("could not open %s: %s", src->location, g_strerror (errno)));
+    return FALSE;
+  }
+  if (fstat (src->fd, &st) != 0 || !S_ISREG (st.st_mode)) {
+    GST_ELEMENT_ERROR (src, RESOURCE, OPEN_READ, (NULL), ("%s is not a regular file", src->location));
+    close (src->fd);
+    src->fd = -1;
+    return FALSE;
+  }
+
+  src->size = st.st_size;
+  src->use_read = mmap_fs_is_removable (src->fd);
+  if (src->use_read)
+    GST_INFO_OBJECT (src, "%s is on removable media, reading instead of mapping", src->location);
+  src->next_offset = 0;
+  src->sequential = 0;
+  src->random = FALSE;
+  src->advised_end = 0;
+  src->rate_start = g_get_monotonic_time ();
+  src->rate_bytes = 0;
+  src->byte_rate = 0;
+
+  return TRUE;
+}
+
+static gboolean agmp_mmap_src_stop (GstBaseSrc *basesrc)
+{
+  AgmpMmapSrc *src = AGMP_MMAP_SRC (basesrc);
+
+  if (src->window) {
+    gst_memory_unref (src->window);
+    src->window = NULL;
+    src->mapping = NULL;
+  }
+  if (src->fd >= 0) {
+    close (src->fd);
+    src->fd = -1;
+  }
+  return TRUE;
+}
+
+static gboolean agmp_mmap_src_get_size (GstBaseSrc *basesrc, guint64 *size)
+{
+  AgmpMmapSrc *src = AGMP_MMAP_SRC (basesrc);
+
+  if (src->fd < 0)
+    return FALSE;
+  agmp_mmap_src_update_size (src);
+  *size = src->size;
+  return TRUE;
+}
+
+static gboolean agmp_mmap_src_is_seekable (GstBaseSrc *basesrc)
+{
+  return TRUE;
+}
+
+static void agmp_mmap_src_class_init (AgmpMmapSrcClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSrcClass *basesrc_class = GST_BASE_SRC_CLASS (klass);
+
+  gobject_class->set_property = agmp_mmap_src_set_property;
+  gobject_class->get_property = agmp_mmap_src_get_property;
+  gobject_class->finalize = agmp_mmap_src_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "File Location",
+          "Location of the file to read", NULL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+  gst_element_class_set_static_metadata (element_class, "AGMP mmap file source",
+      "Source/File", "Read from a local file through mmap'ed pages", "Amlogic");
+
+  basesrc_class->start = GST_DEBUG_FUNCPTR (agmp_mmap_src_start);
+  basesrc_class->stop = GST_DEBUG_FUNCPTR (agmp_mmap_src_stop);
+  basesrc_class->get_size = GST_DEBUG_FUNCPTR (agmp_mmap_src_get_size);
+  basesrc_class->is_seekable = GST_DEBUG_FUNCPTR (agmp_mmap_src_is_seekable);
+  basesrc_class->create = GST_DEBUG_FUNCPTR (agmp_mmap_src_create);
+}
+
+static void agmp_mmap_src_init (AgmpMmapSrc *src)
+{
+  src->fd = -1;
+  gst_base_src_set_format (GST_BASE_SRC (src), GST_FORMAT_BYTES);
+}
+
+static GstURIType agmp_mmap_src_uri_get_type (GType type)
+{
+  return GST_URI_SRC;
+}
+
+static const gchar *const *agmp_mmap_src_uri_get_protocols (GType type)
+{
+  static const gchar *protocols[] = { "file", NULL };
+
+  return protocols;
+}
+
+static gchar *agmp_mmap_src_uri_get_uri (GstURIHandler *handler)
+{
+  AgmpMmapSrc *src = AGMP_MMAP_SRC (handler);
+  gchar *uri = NULL;
+
+  GST_OBJECT_LOCK (src);
+  if (src->location)
+    uri = gst_filename_to_uri (src->location, NULL);
+  GST_OBJECT_UNLOCK (src);
+
+  return uri;
+}
+
+static gboolean agmp_mmap_src_uri_set_uri (GstURIHandler *handler, const gchar *uri, GError **error)
+{
+  AgmpMmapSrc *src = AGMP_MMAP_SRC (handler);
+  gchar *location;
+  gboolean ret;
+
+  location = g_filename_from_uri (uri, NULL, error);
+  if (!location)
+    return FALSE;
+  ret = agmp_mmap_src_set_location (src, location, error);
+  g_free (location);
+
+  return ret;
+}
+
+static void agmp_mmap_src_uri_handler_init (gpointer g_iface, gpointer iface_data)
+{
+  GstURIHandlerInterface *iface = (GstURIHandlerInterface *) g_iface;
+
+  iface->get_type = agmp_mmap_src_uri_get_type;
+  iface->get_protocols = agmp_mmap_src_uri_get_protocols;
+  iface->get_uri = agmp_mmap_src_uri_get_uri;
+  iface->set_uri = agmp_mmap_src_uri_set_uri;
+}
+
+static gboolean agmp_mmap_src_plugin_init (GstPlugin *plugin)
+{
+  GST_DEBUG_CATEGORY_INIT (agmp_mmap_src_debug, "agmpmmapsrc", 0, "agmplayer mmap file source");
+
+  /* above filesrc, so uridecodebin picks it for file:// of the whole process */
+  return gst_element_register (plugin, "agmpmmapsrc", GST_RANK_PRIMARY + 1, AGMP_TYPE_MMAP_SRC);
+}
+
+void agmp_mmap_src_register (void)
+{
+  static gsize registered = 0;
+  const gchar *env;
+
+  if (g_once_init_enter (&registered)) {
+    env = g_getenv ("AGMP_MMAP_SRC");
+    if (env && g_str_has_prefix (env, "1"))
+      gst_plugin_register_static (GST_VERSION_MAJOR, GST_VERSION_MINOR, "agmpmmapsrc",
+          "mmap file source of agmplayer", agmp_mmap_src_plugin_init, "1.0",
+          GST_LICENSE_UNKNOWN, "libAGMPlayer", "agmplayer", "http://www.amlogic.com");
+    g_once_init_leave (&registered, 1);
+  }
+}
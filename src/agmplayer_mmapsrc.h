@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __AGMPLAYER_MMAPSRC_H__
+#define __AGMPLAYER_MMAPSRC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesrc.h>
+
+G_BEGIN_DECLS
+
+/*
+ * file:// source handing out buffers that wrap mmap'ed pages of the file,
+ * with madvise read-ahead sized to the rate data is consumed at.
+ * removable and network media are read with pread instead, a SIGBUS guard
+ * covers mappings whose file is truncated. registered above filesrc, which
+ * affects every file:// pipeline of the process, so only on request.
+ */
+#define AGMP_TYPE_MMAP_SRC (agmp_mmap_src_get_type ())
+G_DECLARE_FINAL_TYPE (AgmpMmapSrc, agmp_mmap_src, AGMP, MMAP_SRC, GstBaseSrc)
+
+/* once per process, only with AGMP_MMAP_SRC=1, filesrc stays in charge otherwise */
+void agmp_mmap_src_register (void);
+
+G_END_DECLS
+
+#endif /* __AGMPLAYER_MMAPSRC_H__ */
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include "agmplayer_probe_cache.h"
+#include "agmplayer_log.h"
+
+#define AGMP_LOG_MODULE "probecache"
+#define log_debug(...) agmp_log_write(LOG_DEBUG, AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
+#define log_warn(...)  agmp_log_write(LOG_WARN,  AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
+
+#define PROBE_CACHE_MAX_ENTRIES 64
+
+static GMutex cache_lock;
+static GKeyFile *cache = NULL;
+static gchar *cache_path = NULL;
+
+/* call with cache_lock held */
+static void probe_cache_load (void)
+{
+  const gchar *env;
+
+  if (cache)
+    return;
+
+  env = g_getenv ("AGMP_PROBE_CACHE");
+  if (env && *env)
+    cache_path = g_strdup (env);
+  else
+    cache_path = g_build_filename (g_get_user_cache_dir (), "agmplayer", "probe-cache", NULL);
+
+  cache = g_key_file_new ();
+  if (!g_key_file_load_from_file (cache, cache_path, G_KEY_FILE_NONE, NULL))
+    log_debug ("no probe cache at %s", cache_path);
+}
+
+/* call with cache_lock held */
+static void probe_cache_save (void)
+{
+  gchar *dir = g_path_get_dirname (cache_path);
+  GError *err = NULL;
+
+  g_mkdir_with_parents (dir, 0755);
+  if (!g_key_file_save_to_file (cache, cache_path, &err)) {
+    log_warn ("save %s failed: %s", cache_path, err->message);
+    g_clear_error (&err);
+  }
+  g_free (dir);
+}
+
+/* uris may hold characters a group name can't */
+static gchar *probe_cache_group (const gchar *uri)
+{
+  return g_compute_checksum_for_string (G_CHECKSUM_SHA1, uri, -1);
+}
+
+/* size:mtime of a local file, NULL for anything else */
+static gchar *probe_cache_file_stamp (const gchar *uri)
+{
+  gchar *path, *stamp = NULL;
+  GStatBuf st;
+
+  if (!g_str_has_prefix (uri, "file:"))
+    return NULL;
+
+  path = g_filename_from_uri (uri, NULL, NULL);
+  if (path && g_stat (path, &st) == 0)
+    stamp = g_strdup_printf ("%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT,
+        (gint64) st.st_size, (gint64) st.st_mtime);
+  g_free (path);
+  return stamp;
+}
+
+/* call with cache_lock held, drop least recently used entries over the limit */
+static void probe_cache_evict (void)
+{
+  gchar **groups;
+  gsize n_groups, left, i;
+
+  groups = g_key_file_get_groups (cache, &n_groups);
+  for (left = n_groups; left > PROBE_CACHE_MAX_ENTRIES; left--) {
+    gint64 oldest = G_MAXINT64;
+    gsize victim = 0;
+
+    for (i = 0; i < n_groups; i++) {
+      gint64 used;
+
+      if (!groups[i][0])
+        continue;
+      used = g_key_file_get_int64 (cache, groups[i], "used", NULL);
+      if (used < oldest) {
+        oldest = used;
+        victim = i;
+      }
+    }
+    g_key_file_remove_group (cache, groups[victim], NULL);
+    /* keep the vector NULL terminated for g_strfreev */
+    groups[victim][0] = '\0';
+  }
+  g_strfreev (groups);
+}
+
+gboolean agmp_probe_cache_lookup (const gchar *uri, AgmpProbeEntry *entry)
+{
+  gchar *group, *stored_uri, *stamp, *stored_stamp;
+  gboolean hit = FALSE;
+
+  g_return_val_if_fail (uri != NULL && entry != NULL, FALSE);
+  memset (entry, 0, sizeof (*entry));
+
+  group = probe_cache_group (uri);
+  g_mutex_lock (&cache_lock);
+  probe_cache_load ();
+
+  stored_uri = g_key_file_get_string (cache, group, "uri", NULL);
+  if (g_strcmp0 (stored_uri, uri) == 0) {
+    stamp = probe_cache_file_stamp (uri);
+    stored_stamp = g_key_file_get_string (cache, group, "stamp", NULL);
+    entry->etag = g_key_file_get_string (cache, group, "etag", NULL);
+    if (g_strcmp0 (stamp, stored_stamp) != 0) {
+      log_debug ("%s changed on disk", uri);
+      g_key_file_remove_group (cache, group, NULL);
+      probe_cache_save ();
+      agmp_probe_entry_clear (entry);
+    } else if (!stamp && !entry->etag) {
+      /* nothing to tell whether the server content changed */
+      agmp_probe_entry_clear (entry);
+    } else {
+      entry->container = g_key_file_get_string (cache, group, "container", NULL);
+      entry->factories = g_key_file_get_string_list (cache, group, "factories", NULL, NULL);
+      entry->n_video = g_key_file_get_integer (cache, group, "n-video", NULL);
+      entry->n_audio = g_key_file_get_integer (cache, group, "n-audio", NULL);
+      entry->n_text = g_key_file_get_integer (cache, group, "n-text", NULL);
+      hit = entry->container != NULL;
+      if (hit)
+        g_key_file_set_int64 (cache, group, "used", g_get_real_time () / G_USEC_PER_SEC);
+      else
+        agmp_probe_entry_clear (entry);
+    }
+    g_free (stamp);
+    g_free (stored_stamp);
+  }
+  g_mutex_unlock (&cache_lock);
+
+  g_free (stored_uri);
+  g_free (group);
+  return hit;
+}
+
+void agmp_probe_cache_store (const gchar *uri, const AgmpProbeEntry *entry)
+{
+  gchar *group, *stamp;
+
+  g_return_if_fail (uri != NULL && entry != NULL && entry->container != NULL);
+
+  group = probe_cache_group (uri);
+  stamp = probe_cache_file_stamp (uri);
+
+  g_mutex_lock (&cache_lock);
+  probe_cache_load ();
+  /* an etag seen during this prepare stays */
+  if (!stamp && !g_key_file_has_key (cache, group, "etag", NULL)) {
+    log_debug ("no validator for %s, not cached", uri);
+    g_mutex_unlock (&cache_lock);
+    g_free (group);
+    return;
+  }
+  g_key_file_set_string (cache, group, "uri", uri);
+  if (stamp)
+    g_key_file_set_string (cache, group, "stamp", stamp);
+  g_key_file_set_string (cache, group, "container", entry->container);
+  if (entry->factories)
+    g_key_file_set_string_list (cache, group, "factories",
+        (const gchar * const *) entry->factories, g_strv_length (entry->factories));
+  else
+    g_key_file_remove_key (cache, group, "factories", NULL);
+  g_key_file_set_integer (cache, group, "n-video", entry->n_video);
+  g_key_file_set_integer (cache, group, "n-audio", entry->n_audio);
+  g_key_file_set_integer (cache, group, "n-text", entry->n_text);
+  g_key_file_set_int64 (cache, group, "used", g_get_real_time () / G_USEC_PER_SEC);
+  probe_cache_evict ();
+  probe_cache_save ();
+  g_mutex_unlock (&cache_lock);
+
+  g_free (stamp);
+  g_free (group);
+}
+
+void agmp_probe_cache_set_etag (const gchar *uri, const gchar *etag)
+{
+  gchar *group, *stored;
+
+  g_return_if_fail (uri != NULL && etag != NULL);
+
+  group = probe_cache_group (uri);
+  g_mutex_lock (&cache_lock);
+  probe_cache_load ();
+  stored = g_key_file_get_string (cache, group, "etag", NULL);
+  if (g_strcmp0 (stored, etag) != 0) {
+    if (stored) {
+      log_debug ("%s changed on server", uri);
+      g_key_file_remove_group (cache, group, NULL);
+    }
+    /* kept until the entry is stored at the end of prepare */
+    g_key_file_set_string (cache, group, "uri", uri);
+    g_key_file_set_string (cache, group, "etag", etag);
+  }
+  g_mutex_unlock (&cache_lock);
+
+  g_free (stored);
+  g_free (group);
+}
+
+void agmp_probe_cache_invalidate (const gchar *uri)
+{
+  gchar *group;
+
+  g_return_if_fail (uri != NULL);
+
+  group = probe_cache_group (uri);
+  g_mutex_lock (&cache_lock);
+  probe_cache_load ();
+  if (g_key_file_remove_group (cache, group, NULL))
+    probe_cache_save ();
+  g_mutex_unlock (&cache_lock);
+  g_free (group);
+}
+
+void agmp_probe_entry_clear (AgmpProbeEntry *entry)
+{
+  g_free (entry->container);
+  g_strfreev (entry->factories);
+  g_free (entry->etag);
+  memset (entry, 0, sizeof (*entry));
+}
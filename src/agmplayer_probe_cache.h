@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __AGMPLAYER_PROBE_CACHE_H__
+#define __AGMPLAYER_PROBE_CACHE_H__
+
+#include <glib.h>
+
+/*
+ * persistent cache of what prepare found out about a uri:
+ * the container typefind reported, the stream layout and the factories
+ * autoplugged. local files are validated by size and mtime,
+ * network uris by the ETag of the server; without one nothing is stored.
+ * stored in $AGMP_PROBE_CACHE or <user cache dir>/agmplayer/probe-cache.
+ */
+typedef struct
+{
+  gchar *container;             /* caps string */
+  gchar **factories;            /* demuxer, parsers and decoders in autoplug order */
+  gint n_video;
+  gint n_audio;
+  gint n_text;
+  gchar *etag;                  /* network entries only, to compare with the response */
+} AgmpProbeEntry;
+
+gboolean agmp_probe_cache_lookup (const gchar *uri, AgmpProbeEntry *entry);
+void agmp_probe_cache_store (const gchar *uri, const AgmpProbeEntry *entry);
+/* remember etag for uri, an entry stored with a different one is dropped */
+void agmp_probe_cache_set_etag (const gchar *uri, const gchar *etag);
+void agmp_probe_cache_invalidate (const gchar *uri);
+void agmp_probe_entry_clear (AgmpProbeEntry *entry);
+
+#endif /* __AGMPLAYER_PROBE_CACHE_H__ */
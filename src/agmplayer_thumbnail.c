@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+#include "agmplayer_thumbnail.h"
+#include "agmplayer_log.h"
+
+#define AGMP_LOG_MODULE "thumbnail"
+#define log_debug(...) agmp_log_write(LOG_DEBUG, AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
+#define log_warn(...)  agmp_log_write(LOG_WARN,  AGMP_LOG_MODULE, __func__, __LINE__, __VA_ARGS__)
+
+#define THUMB_CACHE_MAX 32          /* thumbnails kept */
+#define THUMB_SPANS_MAX 256         /* position ranges known to map to a keyframe */
+#define THUMB_STATE_TIMEOUT (5 * GST_SECOND)
+
+/* from gst-plugins-base playback, not in a public header */
+typedef enum
+{
+  THUMB_AUTOPLUG_SELECT_TRY,
+  THUMB_AUTOPLUG_SELECT_EXPOSE,
+  THUMB_AUTOPLUG_SELECT_SKIP
+} ThumbAutoplugSelectResult;
+
+typedef struct
+{
+  gint64 keyframe;              /* stream time of the keyframe */
+  gint width;
+  gint height;
+  guint8 *rgba;
+} ThumbEntry;
+
+/* any position in [keyframe, last] snaps back to keyframe */
+typedef struct
+{
+  gint64 keyframe;
+  gint64 last;
+} ThumbSpan;
+
+struct _AgmpThumbnailer
+{
+  gchar *uri;
+  GMutex lock;
+
+  GstElement *pipeline;
+  GstElement *convert;
+  GstElement *capsfilter;
+  GstElement *appsink;
+  gboolean prerolled;
+
+  GQueue cache;                 /* ThumbEntry, most recent first */
+  GQueue spans;                 /* ThumbSpan, most recent first */
+};
+
+static ThumbAutoplugSelectResult
+thumb_autoplug_select (GstElement *bin, GstPad *pad, GstCaps *caps,
+    GstElementFactory *factory, gpointer user_data)
+{
+  /* h/w decoders belong to the main player */
+  if (g_str_has_prefix (GST_OBJECT_NAME (factory), "amlv4l2"))
+    return THUMB_AUTOPLUG_SELECT_SKIP;
+  return THUMB_AUTOPLUG_SELECT_TRY;
+}
+
+static void thumb_pad_added (GstElement *decodebin, GstPad *pad, gpointer user_data)
+{
+  AgmpThumbnailer *thumb = user_data;
+  GstPad *sinkpad;
+
+  sinkpad = gst_element_get_static_pad (thumb->convert, "sink");
+  if (!gst_pad_is_linked (sinkpad) && gst_pad_link (pad, sinkpad) != GST_PAD_LINK_OK)
+    log_warn ("link video pad failed");
+  gst_object_unref (sinkpad);
+}
+
+static void thumb_entry_free (gpointer data)
+{
+  ThumbEntry *entry = data;
+
+  g_free (entry->rgba);
+  g_free (entry);
+}
+
+AgmpThumbnailer *agmp_thumbnailer_new (const gchar *uri)
+{
+  AgmpThumbnailer *thumb;
+  GstElement *src, *scale;
+  GstCaps *caps;
+
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  thumb = g_new0 (AgmpThumbnailer, 1);
+  thumb->uri = g_strdup (uri);
+  g_mutex_init (&thumb->lock);
+  g_queue_init (&thumb->cache);
+  g_queue_init (&thumb->spans);
+
+  thumb->pipeline = gst_pipeline_new ("thumbnail");
+  src = gst_element_factory_make ("uridecodebin", NULL);
+  thumb->convert = gst_element_factory_make ("videoconvert", NULL);
+  scale = gst_element_factory_make ("videoscale", NULL);
+  thumb->capsfilter = gst_element_factory_make ("capsfilter", NULL);
+  thumb->appsink = gst_element_factory_make ("appsink", NULL);
+  if (!thumb->pipeline || !src || !thumb->convert || !scale || !thumb->capsfilter || !thumb->appsink) {
+    log_warn ("create thumbnail pipeline failed");
+    if (src) gst_object_unref (src);
+    if (thumb->convert) gst_object_unref (thumb->convert);
+    if (scale) gst_object_unref (scale);
+    if (thumb->capsfilter) gst_object_unref (thumb->capsfilter);
+    if (thumb->appsink) gst_object_unref (thumb->appsink);
+    thumb->convert = thumb->capsfilter = thumb->appsink = NULL;
+    agmp_thumbnailer_free (thumb);
+    return NULL;
+  }
+
+  /* only raw video is exposed, audio is never decoded */
+  caps = gst_caps_new_empty_simple ("video/x-raw");
+  g_object_set (src, "uri", uri, "caps", caps, "expose-all-streams", FALSE, NULL);
+  gst_caps_unref (caps);
+  g_signal_connect (src, "autoplug-select", G_CALLBACK (thumb_autoplug_select), thumb);
+  g_signal_connect (src, "pad-added", G_CALLBACK (thumb_pad_added), thumb);
+
+  g_object_set (thumb->appsink, "sync", FALSE, "max-buffers", 1, "drop", TRUE, NULL);
+
+  gst_bin_add_many (GST_BIN (thumb->pipeline), src, thumb->convert, scale,
+      thumb->capsfilter, thumb->appsink, NULL);
+  gst_element_link_many (thumb->convert, scale, thumb->capsfilter, thumb->appsink, NULL);
+
+  /* nobody watches this bus */
+  gst_bus_set_flushing (GST_ELEMENT_BUS (thumb->pipeline), TRUE);
+
+  return thumb;
+}
+
+void agmp_thumbnailer_free (AgmpThumbnailer *thumb)
+{
+  if (!thumb)
+    return;
+
+  if (thumb->pipeline) {
+    gst_element_set_state (thumb->pipeline, GST_STATE_NULL);
+    gst_object_unref (thumb->pipeline);
+  }
+  g_queue_foreach (&thumb->cache, (GFunc) thumb_entry_free, NULL);
+  g_queue_clear (&thumb->cache);
+  g_queue_foreach (&thumb->spans, (GFunc) g_free, NULL);
+  g_queue_clear (&thumb->spans);
+  g_mutex_clear (&thumb->lock);
+  g_free (thumb->uri);
+  g_free (thumb);
+}
+
+const gchar *agmp_thumbnailer_get_uri (AgmpThumbnailer *thumb)
+{
+  return thumb ? thumb->uri : NULL;
+}
+
+/* move a hit to the front of its queue */
+static void thumb_touch (GQueue *queue, GList *link)
+{
+  g_queue_unlink (queue, link);
+  g_queue_push_head_link (queue, link);
+}
+
+static ThumbEntry *thumb_cache_lookup (AgmpThumbnailer *thumb, gint64 position, gint width, gint height)
+{
+  GList *l, *span_link = NULL;
+  gint64 keyframe = -1;
+
+  for (l = thumb->spans.head; l; l = l->next) {
+    ThumbSpan *span = l->data;
+
+    if (position >= span->keyframe && position <= span->last) {
+      keyframe = span->keyframe;
+      span_link = l;
+      break;
+    }
+  }
+  if (keyframe < 0)
+    return NULL;
+  thumb_touch (&thumb->spans, span_link);
+
+  for (l = thumb->cache.head; l; l = l->next) {
+    ThumbEntry *entry = l->data;
+
+    if (entry->keyframe == keyframe && entry->width == width && entry->height == height) {
+      thumb_touch (&thumb->cache, l);
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+static void thumb_cache_add (AgmpThumbnailer *thumb, gint64 position, gint64 keyframe,
+    gint width, gint height, const guint8 *rgba)
+{
+  ThumbEntry *entry;
+  ThumbSpan *span = NULL;
+  GList *l;
+
+  for (l = thumb->spans.head; l; l = l->next) {
+    if (((ThumbSpan *) l->data)->keyframe == keyframe) {
+      span = l->data;
+      break;
+    }
+  }
+  if (!span) {
+    span = g_new0 (ThumbSpan, 1);
+    span->keyframe = keyframe;
+    span->last = keyframe;
+    g_queue_push_head (&thumb->spans, span);
+    if (g_queue_get_length (&thumb->spans) > THUMB_SPANS_MAX)
+      g_free (g_queue_pop_tail (&thumb->spans));
+  }
+  if (position > span->last)
+    span->last = position;
+
+  entry = g_new0 (ThumbEntry, 1);
+  entry->keyframe = keyframe;
+  entry->width = width;
+  entry->height = height;
+  entry->rgba = g_malloc ((gsize) width * height * 4);
+  memcpy (entry->rgba, rgba, (gsize) width * height * 4);
+  g_queue_push_head (&thumb->cache, entry);
+  if (g_queue_get_length (&thumb->cache) > THUMB_CACHE_MAX)
+    thumb_entry_free (g_queue_pop_tail (&thumb->cache));
+}
+
+static gboolean thumb_decode (AgmpThumbnailer *thumb, gint64 position, gint width, gint height,
+    guint8 *rgba, gint64 *keyframe)
+{
+  GstCaps *caps;
+  GstSample *sample;
+  GstBuffer *buffer;
+  GstMapInfo map;
+  GstVideoInfo info;
+  const GstSegment *segment;
+  gboolean ret = FALSE;
+  gint row;
+
+  caps = gst_caps_new_simple ("video/x-raw", "format", G_TYPE_STRING, "RGBA",
+      "width", G_TYPE_INT, width, "height", G_TYPE_INT, height,
+      "pixel-aspect-ratio", GST_TYPE_FRACTION, 1, 1, NULL);
+  g_object_set (thumb->capsfilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  if (!thumb->prerolled) {
+    gst_element_set_state (thumb->pipeline, GST_STATE_PAUSED);
+    /* ASYNC here means the timeout hit before preroll */
+    if (gst_element_get_state (thumb->pipeline, NULL, NULL, THUMB_STATE_TIMEOUT) != GST_STATE_CHANGE_SUCCESS) {
+      log_warn ("thumbnail preroll failed: %s", thumb->uri);
+      gst_element_set_state (thumb->pipeline, GST_STATE_NULL);
+      return FALSE;
+    }
+    thumb->prerolled = TRUE;
+  }
+
+  /* decodes the keyframe before position and nothing after it */
+  if (!gst_element_seek_simple (thumb->pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | GST_SEEK_FLAG_SNAP_BEFORE, position)) {
+    log_warn ("thumbnail seek to %" GST_TIME_FORMAT " failed", GST_TIME_ARGS (position));
+    return FALSE;
+  }
+  if (gst_element_get_state (thumb->pipeline, NULL, NULL, THUMB_STATE_TIMEOUT) != GST_STATE_CHANGE_SUCCESS) {
+    log_warn ("thumbnail seek didn't preroll");
+    return FALSE;
+  }
+
+  sample = gst_app_sink_pull_preroll (GST_APP_SINK (thumb->appsink));
+  if (!sample)
+    return FALSE;
+
+  buffer = gst_sample_get_buffer (sample);
+  if (buffer && gst_video_info_from_caps (&info, gst_sample_get_caps (sample))
+      && GST_VIDEO_INFO_WIDTH (&info) == width && GST_VIDEO_INFO_HEIGHT (&info) == height
+      && gst_buffer_map (buffer, &map, GST_MAP_READ)) {
+    /* strip any row padding */
+    for (row = 0; row < height; row++)
+      memcpy (rgba + row * width * 4, map.data + GST_VIDEO_INFO_PLANE_OFFSET (&info, 0)
+          + row * GST_VIDEO_INFO_PLANE_STRIDE (&info, 0), width * 4);
+    gst_buffer_unmap (buffer, &map);
+
+    segment = gst_sample_get_segment (sample);
+    *keyframe = GST_BUFFER_PTS (buffer);
+    if (segment && GST_CLOCK_TIME_IS_VALID (*keyframe))
+      *keyframe = gst_segment_to_stream_time (segment, GST_FORMAT_TIME, *keyframe);
+    if (!GST_CLOCK_TIME_IS_VALID (*keyframe) || *keyframe > position)
+      *keyframe = position;
+    ret = TRUE;
+  }
+  gst_sample_unref (sample);
+  return ret;
+}
+
+gboolean agmp_thumbnailer_get (AgmpThumbnailer *thumb, gint64 position,
+    gint width, gint height, guint8 *rgba)
+{
+  ThumbEntry *entry;
+  gint64 keyframe = -1;
+  gboolean ret = FALSE;
+
+  g_return_val_if_fail (thumb != NULL && rgba != NULL, FALSE);
+  g_return_val_if_fail (width > 0 && height > 0 && position >= 0, FALSE);
+
+  g_mutex_lock (&thumb->lock);
+  entry = thumb_cache_lookup (thumb, position, width, height);
+  if (entry) {
+    memcpy (rgba, entry->rgba, width * height * 4);
+    ret = TRUE;
+  } else if (thumb_decode (thumb, position, width, height, rgba, &keyframe)) {
+    log_debug ("thumbnail %" GST_TIME_FORMAT " from keyframe %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (position), GST_TIME_ARGS (keyframe));
+    thumb_cache_add (thumb, position, keyframe, width, height, rgba);
+    ret = TRUE;
+  }
+  g_mutex_unlock (&thumb->lock);
+
+  return ret;
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2021 Amlogic Corporation.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __AGMPLAYER_THUMBNAIL_H__
+#define __AGMPLAYER_THUMBNAIL_H__
+
+#include <gst/gst.h>
+
+/*
+ * seek-bar thumbnails of a uri, decoded by a s/w pipeline of its own.
+ * only the keyframe at or before the position is decoded.
+ */
+typedef struct _AgmpThumbnailer AgmpThumbnailer;
+
+AgmpThumbnailer *agmp_thumbnailer_new (const gchar *uri);
+void agmp_thumbnailer_free (AgmpThumbnailer *thumb);
+const gchar *agmp_thumbnailer_get_uri (AgmpThumbnailer *thumb);
+/* fill rgba (width * height * 4 bytes) with the frame of the keyframe before position (ns) */
+gboolean agmp_thumbnailer_get (AgmpThumbnailer *thumb, gint64 position,
+    gint width, gint height, guint8 *rgba);
+
+#endif /* __AGMPLAYER_THUMBNAIL_H__ */